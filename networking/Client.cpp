@@ -101,9 +101,15 @@ void evtc_rpc_client::CallDataBase::Destruct()
 
 
 evtc_rpc_client::evtc_rpc_client(std::function<std::string()>&& pEndpointCallback, std::function<std::string()>&& pRootCertificatesCallback, std::function<void(cbtevent*, uint16_t)>&& pCombatEventCallback)
+	: evtc_rpc_client{std::move(pEndpointCallback), std::move(pRootCertificatesCallback), std::move(pCombatEventCallback), nullptr}
+{
+}
+
+evtc_rpc_client::evtc_rpc_client(std::function<std::string()>&& pEndpointCallback, std::function<std::string()>&& pRootCertificatesCallback, std::function<void(cbtevent*, uint16_t)>&& pCombatEventCallback, std::function<void(cbtevent*, size_t, uint16_t)>&& pCombatEventBatchCallback)
 	: mEndpointCallback{std::move(pEndpointCallback)}
 	, mRootCertificatesCallback{std::move(pRootCertificatesCallback)}
 	, mCombatEventCallback{std::move(pCombatEventCallback)}
+	, mCombatEventBatchCallback{std::move(pCombatEventBatchCallback)}
 	, mLastConnectionAttempt{std::chrono::steady_clock::time_point(std::chrono::seconds(0))}
 {
 }
@@ -662,11 +668,43 @@ void evtc_rpc_client::HandleReadMessage(ReadMessageCallData* pCallData)
 		data += sizeof(CombatEvent);
 		dataSize -= sizeof(message);
 
-		mCombatEventCallback(&message.Event, message.SenderInstanceId);
+		DeliverCombatEvents(&message.Event, 1, message.SenderInstanceId);
 		LOG("Received CombatEvent source %hu target %hu skill %u value %i",
 			message.Event.src_instid, message.Event.dst_instid, message.Event.skillid, message.Event.value);
 		break;
 
+	case Type::CombatEventBatch:
+	{
+		if (dataSize < sizeof(CombatEventBatch))
+		{
+			LOG("(tag %p) data too short for CombatEventBatch message (%zu vs %zu)",
+				pCallData, dataSize, sizeof(CombatEventBatch));
+			ForceDisconnect(pCallData->Context, "short CombatEventBatch header");
+			return;
+		}
+
+		CombatEventBatch batch;
+		memcpy(&batch, data, sizeof(CombatEventBatch));
+		data += sizeof(CombatEventBatch);
+		dataSize -= sizeof(CombatEventBatch);
+
+		if (dataSize != batch.EventCount * sizeof(cbtevent))
+		{
+			LOG("(tag %p) incorrect length for CombatEventBatch message with %hu events (%zu vs %zu)",
+				pCallData, batch.EventCount, dataSize, batch.EventCount * sizeof(cbtevent));
+			ForceDisconnect(pCallData->Context, "incorrect CombatEventBatch length");
+			return;
+		}
+
+		// The blob has no alignment guarantees so copy the events out before handing them over
+		mReceivedEventsBuffer.resize(batch.EventCount);
+		memcpy(mReceivedEventsBuffer.data(), data, dataSize);
+
+		DeliverCombatEvents(mReceivedEventsBuffer.data(), mReceivedEventsBuffer.size(), batch.SenderInstanceId);
+		LOG("Received CombatEventBatch from %hu with %hu events", batch.SenderInstanceId, batch.EventCount);
+		break;
+	}
+
 	default:
 		LOG("(tag %p) incorrect type %u", pCallData, header.MessageType);
 		return;
@@ -675,6 +713,25 @@ void evtc_rpc_client::HandleReadMessage(ReadMessageCallData* pCallData)
 	LOG("(tag %p) <<", pCallData);
 }
 
+void evtc_rpc_client::DeliverCombatEvents(cbtevent* pEvents, size_t pEventCount, uint16_t pSenderInstanceId)
+{
+	if (pEventCount == 0)
+	{
+		return;
+	}
+
+	if (mCombatEventBatchCallback != nullptr)
+	{
+		mCombatEventBatchCallback(pEvents, pEventCount, pSenderInstanceId);
+		return;
+	}
+
+	for (size_t i = 0; i < pEventCount; i++)
+	{
+		mCombatEventCallback(&pEvents[i], pSenderInstanceId);
+	}
+}
+
 void evtc_rpc_client::SendEvent(CallDataBase* pCallData)
 {
 	using namespace evtc_rpc::messages;
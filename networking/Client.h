@@ -32,6 +32,7 @@
 #include <chrono>
 #include <queue>
 #include <memory>
+#include <vector>
 
 struct evtc_rpc_client_status
 {
@@ -188,6 +189,9 @@ class evtc_rpc_client
 
 public:
 	evtc_rpc_client(std::function<std::string()>&& pEndpointCallback, std::function<std::string()>&& pRootCertsCallback, std::function<void(cbtevent*, uint16_t)>&& pCombatEventCallback);
+	// If pCombatEventBatchCallback is set, all received combat events are delivered through it (one call per received
+	// message) and pCombatEventCallback is never called
+	evtc_rpc_client(std::function<std::string()>&& pEndpointCallback, std::function<std::string()>&& pRootCertsCallback, std::function<void(cbtevent*, uint16_t)>&& pCombatEventCallback, std::function<void(cbtevent*, size_t, uint16_t)>&& pCombatEventBatchCallback);
 
 	evtc_rpc_client_status GetStatus();
 	void SetEnabledStatus(bool pEnabledStatus);
@@ -210,11 +214,14 @@ private:
 
 	void ForceDisconnect(const std::shared_ptr<ConnectionContext>& pContext, const char* pErrorMessage);
 	void HandleReadMessage(ReadMessageCallData* pCallData);
+	void DeliverCombatEvents(cbtevent* pEvents, size_t pEventCount, uint16_t pSenderInstanceId);
 	void SendEvent(CallDataBase* pCallData);
 
 	const std::function<std::string()> mEndpointCallback;
 	const std::function<std::string()> mRootCertificatesCallback;
 	const std::function<void(cbtevent*, uint16_t)> mCombatEventCallback;
+	const std::function<void(cbtevent*, size_t, uint16_t)> mCombatEventBatchCallback;
+	std::vector<cbtevent> mReceivedEventsBuffer; // Only accessed from the Serve thread
 
 	std::mutex mQueuedEventsLock;
 	std::queue<CallDataBase*> mQueuedEvents;
@@ -43,6 +43,8 @@ constexpr const char* EvtcRpcMessageTypeToString(evtc_rpc::messages::Type pType)
 		return "RemovePeer";
 	case Type::CombatEvent:
 		return "CombatEvent";
+	case Type::CombatEventBatch:
+		return "CombatEventBatch";
 	default:
 		return "<invalid>";
 	};
@@ -14,6 +14,7 @@ enum class Type : uint32_t
 	AddPeer = 3,
 	RemovePeer = 4,
 	CombatEvent = 5,
+	CombatEventBatch = 6,
 	Max
 };
 
@@ -88,6 +89,16 @@ struct CombatEvent
 };
 static_assert(sizeof(CombatEvent) == 66, "");
 
+// Multiple events from the same sender. Not produced by the server yet - it has to know that every client in the squad
+// understands the message type before it can start coalescing CombatEvent messages into these.
+struct CombatEventBatch
+{
+	uint16_t SenderInstanceId; // 0 when sent from client
+	uint16_t EventCount;
+	// cbtevent Events[];
+};
+static_assert(sizeof(CombatEventBatch) == 4, "");
+
 };
 };
 #pragma pack(pop)
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define HEALING_STATS_EVTC_REVISION 2U
 #define LEGACY_INI_CONFIG_PATH "addons\\arcdps\\arcdps_healing_stats.ini"
 #define JSON_CONFIG_PATH "addons\\arcdps\\arcdps_healing_stats.json"
+#define ENCOUNTER_JOURNAL_PATH "addons\\arcdps\\arcdps_healing_stats_journal.bin"
 
 #define VERSION_EVENT_SIGNATURE 0x00000000U
 struct EvtcVersionHeader
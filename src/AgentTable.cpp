@@ -12,15 +12,22 @@ HealedAgent::HealedAgent(uint16_t pInstanceId, const char* pAgentName, uint16_t
 {
 }
 
-void AgentTable::AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char* pAgentName, std::optional<uint16_t> pSubgroup, std::optional<bool> pIsMinion, std::optional<bool> pIsPlayer)
+std::optional<HealedAgent> AgentTable::AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char* pAgentName, std::optional<uint16_t> pSubgroup, std::optional<bool> pIsMinion, std::optional<bool> pIsPlayer)
 {
 	assert(pAgentName != nullptr);
 	LOG("Inserting new agent %llu %hu %s %hu %s %s", pUniqueId, pInstanceId, pAgentName, pSubgroup.value_or(0), BOOL_STR(pIsMinion.value_or(false)), BOOL_STR(pIsPlayer.value_or(false)));
 
 	std::lock_guard lock(mLock);
 
+	std::optional<HealedAgent> result;
 	auto [agent, agentInserted] = mAgents.try_emplace(pUniqueId, pInstanceId, pAgentName, pSubgroup.value_or(0), pIsMinion.value_or(false), pIsPlayer.value_or(false));
-	if (agentInserted == false)
+	if (agentInserted == true)
+	{
+		mGeneration++;
+		mSnapshot = nullptr;
+		result = agent->second;
+	}
+	else
 	{
 		if ((strcmp(agent->second.Name.c_str(), pAgentName) != 0)
 			|| (agent->second.InstanceId != pInstanceId)
@@ -37,6 +44,10 @@ void AgentTable::AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char*
 				pSubgroup.value_or(agent->second.Subgroup),
 				pIsMinion.value_or(agent->second.IsMinion),
 				pIsPlayer.value_or(agent->second.IsPlayer)};
+
+			mGeneration++;
+			mSnapshot = nullptr;
+			result = agent->second;
 		}
 	}
 
@@ -47,6 +58,8 @@ void AgentTable::AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char*
 			pInstanceId, iter->second->first, iter->second->second.Name.c_str(), iter->second->second.Subgroup, BOOL_STR(iter->second->second.IsMinion), BOOL_STR(iter->second->second.IsPlayer));
 		iter->second = agent;
 	}
+
+	return result;
 }
 
 std::optional<uintptr_t> AgentTable::GetUniqueId(uint16_t pInstanceId, bool pAllowNonPlayer)
@@ -86,13 +99,21 @@ std::optional<std::string> AgentTable::GetName(uintptr_t pUniqueId)
 	return iter->second.Name;
 }
 
-std::map<uintptr_t, HealedAgent> AgentTable::GetState()
+std::shared_ptr<const AgentSnapshot> AgentTable::GetState()
 {
-	std::map<uintptr_t, HealedAgent> result;
+	std::lock_guard lock(mLock);
+
+	if (mSnapshot == nullptr)
 	{
-		std::lock_guard lock(mLock);
-		result = mAgents;
+		mSnapshot = std::make_shared<const AgentSnapshot>(mAgents);
+		DEBUGLOG("Took agent snapshot, generation %llu, %zu agents", mGeneration, mAgents.size());
 	}
 
-	return result;
+	return mSnapshot;
+}
+
+uint64_t AgentTable::GetGeneration()
+{
+	std::lock_guard lock(mLock);
+	return mGeneration;
 }
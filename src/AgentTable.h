@@ -1,5 +1,6 @@
 #pragma once
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -15,18 +16,26 @@ struct HealedAgent
 	HealedAgent(uint16_t pInstanceId, const char* pAgentName, uint16_t pSubgroup, bool pIsMinion, bool pIsPlayer);
 };
 
+using AgentSnapshot = std::map<uintptr_t, HealedAgent>; // <Unique Id, Agent>
+
 class AgentTable
 {
 public:
-	void AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char* pAgentName, std::optional<uint16_t> pSubgroup, std::optional<bool> pIsMinion, std::optional<bool> pIsPlayer);
+	// Returns the agent as it is stored now if the table changed, std::nullopt if the agent was already stored like that
+	std::optional<HealedAgent> AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char* pAgentName, std::optional<uint16_t> pSubgroup, std::optional<bool> pIsMinion, std::optional<bool> pIsPlayer);
 
 	std::optional<uintptr_t> GetUniqueId(uint16_t pInstanceId, bool pAllowNonPlayer);
 	std::optional<std::string> GetName(uintptr_t pUniqueId);
 
-	std::map<uintptr_t, HealedAgent> GetState();
+	// The same snapshot is returned until the table changes, so callers can share it instead of copying the table
+	std::shared_ptr<const AgentSnapshot> GetState();
+	uint64_t GetGeneration(); // Incremented every time the agents returned by GetState change
 
 private:
 	std::mutex mLock;
-	std::map<uintptr_t, HealedAgent> mAgents; // <Unique Id, Agent>
-	std::map<uint16_t, std::map<uintptr_t, HealedAgent>::iterator> mInstanceIds; // <Instance Id, mAgents iterator>
+	AgentSnapshot mAgents;
+	std::map<uint16_t, AgentSnapshot::iterator> mInstanceIds; // <Instance Id, mAgents iterator>
+
+	uint64_t mGeneration = 0;
+	std::shared_ptr<const AgentSnapshot> mSnapshot; // nullptr if mAgents changed since the last snapshot was taken
 };
\ No newline at end of file
@@ -8,7 +8,7 @@
 #include <Windows.h>
 
 #include <algorithm>
-#include <map>
+#include <numeric>
 
 constexpr const char* GROUP_FILTER_STRING[] = { "Group", "Squad", "All (Excluding Summons)", "All (Including Summons)" };
 static_assert((sizeof(GROUP_FILTER_STRING) / sizeof(GROUP_FILTER_STRING[0])) == static_cast<size_t>(GroupFilter::Max), "Added group filter option without updating gui?");
@@ -24,7 +24,7 @@ AggregatedStatsEntry::AggregatedStatsEntry(uint64_t pId, std::string&& pName, fl
 {
 }
 
-AggregatedStats::AggregatedStats(HealingStats&& pSourceData, const HealWindowOptions& pOptions, bool pDebugMode)
+AggregatedStats::AggregatedStats(HealingStats&& pSourceData, const HealWindowOptions& pOptions, bool pDebugMode, const TotalsBase* pBase)
 	: mySourceData(std::move(pSourceData))
 	, myOptions(pOptions)
 	, myDebugMode(pDebugMode)
@@ -32,6 +32,12 @@ AggregatedStats::AggregatedStats(HealingStats&& pSourceData, const HealWindowOpt
 	, mySkills(nullptr)
 	, myGroupFilterTotals(nullptr)
 {
+	if (pBase != nullptr)
+	{
+		myBase = *pBase;
+	}
+
+	assert(mySourceData.Agents != nullptr);
 	assert(myOptions.SortOrderChoice < SortOrder::Max);
 	assert(myOptions.DataSourceChoice < DataSource::Max);
 }
@@ -42,24 +48,32 @@ void AggregatedVector::Add(uint64_t pId, std::string&& pName, float pTimeInComba
 	HighestHealing = (std::max)(HighestHealing, newEntry.Healing);
 }
 
-const AggregatedStatsEntry& AggregatedStats::GetTotal()
+template <typename Function>
+std::array<double, RollingHealing::WINDOW_COUNT> AggregatedStats::GetRollingPerSecond(Function&& pHealing)
 {
-	if (myTotal != nullptr)
+	const RollingAggregate& rolling = GetRollingAggregate();
+
+	std::array<double, RollingHealing::WINDOW_COUNT> result;
+	for (size_t i = 0; i < result.size(); i++)
 	{
-		return *myTotal;
+		result[i] = divide_safe(pHealing(rolling[i]), rolling[i].Duration);
 	}
+	return result;
+}
 
-	uint64_t healing = 0;
-	uint64_t hits = 0;
-	uint64_t barrier = 0;
-	for (const AggregatedStatsEntry& entry : GetSkills(std::nullopt).Entries)
+const AggregatedStatsEntry& AggregatedStats::GetTotal()
+{
+	if (myTotal != nullptr)
 	{
-		healing += entry.Healing;
-		hits += entry.Hits;
-		barrier += entry.Barrier;
+		return *myTotal;
 	}
 
-	myTotal = std::make_unique<AggregatedStatsEntry>(0, "__TOTAL__", GetCombatTime(), healing, hits, std::nullopt, barrier);
+	const HealTotal& total = GetAggregate().Total;
+	myTotal = std::make_unique<AggregatedStatsEntry>(0, "__TOTAL__", GetCombatTime(), total.Healing, total.Hits, std::nullopt, total.Barrier);
+	myTotal->RollingHealingPerSecond = GetRollingPerSecond([](const RollingWindow& pWindow)
+		{
+			return pWindow.Total;
+		});
 	return *myTotal;
 }
 
@@ -90,88 +104,293 @@ const AggregatedVector& AggregatedStats::GetDetails(DataSource pDataSource, uint
 }
 
 
-const AggregatedVector& AggregatedStats::GetGroupFilterTotals()
+// Adds the events in [pFirst, pEnd) to pTable. If CheckTime is true, events with a time offset above pEndOffset are skipped
+template <bool CheckTime>
+static void AddEventsToTable(HealEventTotals::Table& pTable, const HealEventLog& pEvents, size_t pFirst, size_t pEnd, int64_t pEndOffset)
 {
-	if (myGroupFilterTotals != nullptr)
+	for (size_t index = pFirst; index < pEnd; )
 	{
-		return *myGroupFilterTotals;
+		HealEventLog::ColumnChunk chunk = pEvents.GetChunk(index / HealEventLog::CHUNK_SIZE);
+		size_t firstSlot = index % HealEventLog::CHUNK_SIZE;
+		size_t endSlot = (std::min)(chunk.Count, firstSlot + (pEnd - index));
+		for (size_t i = firstSlot; i < endSlot; i++)
+		{
+			if constexpr (CheckTime == true)
+			{
+				if (chunk.TimeOffsets[i] > pEndOffset)
+				{
+					continue;
+				}
+			}
+
+			HealTotal& total = pTable.GetOrInsert(pEvents.GetAgentId(chunk.AgentIndices[i]), chunk.SkillIds[i]);
+			total.Add(chunk.Sizes[i], (chunk.Flags[i] & HealEventLog::EventFlags_IsBarrier) != 0);
+		}
+		index += endSlot - firstSlot;
 	}
+}
 
-	myGroupFilterTotals = std::make_unique<AggregatedVector>();
-	for (uint32_t i = 0; i < static_cast<uint32_t>(GroupFilter::Max); i++)
+const HealEventTotals::Table& AggregatedStats::GetAgentSkillTotals()
+{
+	if (myAgentSkillTotals != nullptr)
+	{
+		return *myAgentSkillTotals;
+	}
+
+	const HealEventLog& events = mySourceData.Events;
+	const uint64_t combatEnd = GetCombatEnd();
+
+	if (mySourceData.Frozen != nullptr)
+	{
+		auto iter = mySourceData.Frozen->Until.find(combatEnd);
+		if (iter != mySourceData.Frozen->Until.end())
+		{
+			myAgentSkillTotals = iter->second;
+			myAgentSkillTotalsEventCount = events.size();
+			return *myAgentSkillTotals;
+		}
+
+		LogD("No frozen totals up to {}, aggregating the {} kept events", combatEnd, events.size());
+	}
+
+	// The running totals can only be used if they were kept for the same events (they are not when the state was
+	// built by hand). Otherwise every event is scanned.
+	HealEventTotals::Checkpoint checkpoint;
+	if (mySourceData.Totals.GetEventCount() == events.size())
+	{
+		checkpoint = mySourceData.Totals.GetTotalsUntil(combatEnd);
+	}
+
+	if (checkpoint.Totals != nullptr && checkpoint.EventCount == events.size())
+	{
+		myAgentSkillTotals = std::move(checkpoint.Totals);
+		myAgentSkillTotalsEventCount = events.size();
+		return *myAgentSkillTotals;
+	}
+
+	// Continue from the base instead if it includes more events. That only works if no event the base left out can be
+	// included now - either the combat end is still the same, or the events are sorted (so the base only left out
+	// events at or after its EventCount)
+	size_t first = checkpoint.EventCount;
+	std::shared_ptr<const HealEventTotals::Table> startTotals = std::move(checkpoint.Totals);
+	if (myBase.has_value() == true && myBase->EventCount > first && events.StartsWith(myBase->Events) == true &&
+		(myBase->CombatEnd == combatEnd || (myBase->CombatEnd < combatEnd && events.IsSorted() == true)))
+	{
+		first = myBase->EventCount;
+		startTotals = myBase->Totals;
+	}
+
+	// Every event after combat end is at the end of the log if the events are sorted, so the events to add are one
+	// contiguous range and don't have to be checked individually
+	const size_t end = (events.IsSorted() == true) ? events.UpperBound(first, combatEnd) : events.size();
+	myAgentSkillTotalsEventCount = end;
+
+	if (startTotals != nullptr && first == end)
+	{
+		myAgentSkillTotals = std::move(startTotals);
+		return *myAgentSkillTotals;
+	}
+
+	std::shared_ptr<HealEventTotals::Table> totals = (startTotals != nullptr)
+		? std::make_shared<HealEventTotals::Table>(*startTotals)
+		: std::make_shared<HealEventTotals::Table>();
+
+	if (events.IsSorted() == true)
+	{
+		AddEventsToTable<false>(*totals, events, first, end, 0);
+	}
+	else
+	{
+		const int64_t endOffset = static_cast<int64_t>(combatEnd) - static_cast<int64_t>(events.GetBaseTime());
+		AddEventsToTable<true>(*totals, events, first, end, endOffset);
+	}
+
+	myAgentSkillTotals = std::move(totals);
+	return *myAgentSkillTotals;
+}
+
+AggregatedStats::TotalsBase AggregatedStats::GetTotalsBase()
+{
+	GetAgentSkillTotals();
+	return TotalsBase{mySourceData.Events, GetCombatEnd(), myAgentSkillTotalsEventCount, myAgentSkillTotals};
+}
+
+const AggregatedStats::Aggregate& AggregatedStats::GetAggregate()
+{
+	if (myAggregate != nullptr)
 	{
-		myGroupFilterTotals->Add(0, GROUP_FILTER_STRING[i], GetCombatTime(), 0, 0, std::nullopt, 0);
+		return *myAggregate;
 	}
 
-	HealWindowOptions fakeOptions;
+	myAggregate = std::make_unique<Aggregate>();
 
-	uint64_t combatEnd = GetCombatEnd();
+	const HealEventTotals::Table& totals = GetAgentSkillTotals();
+	const std::vector<HealEventTotals::Key>& keys = totals.Keys.GetKeys();
 
-	for (const HealEvent& curEvent : mySourceData.Events)
+	std::vector<uint32_t> entryAgents(keys.size()); // Agent index of every entry in totals
+	std::vector<uint32_t> entrySkills(keys.size()); // Skill index of every entry in totals
+	for (size_t i = 0; i < keys.size(); i++)
 	{
-		if (curEvent.Time > combatEnd)
+		auto [agentIndex, newAgent] = myAggregate->AgentIndices.Insert(keys[i].AgentId);
+		if (newAgent == true)
 		{
-			continue;
+			AgentAggregate& agent = myAggregate->Agents.emplace_back();
+			agent.AgentId = keys[i].AgentId;
+			agent.Agent = mySourceData.Agents->find(agent.AgentId);
+			agent.IsFiltered = Filter(agent.Agent);
+			agent.GroupFilterMask = GetGroupFilterMask(agent.Agent);
+		}
+
+		auto [skillIndex, newSkill] = myAggregate->SkillIndices.Insert(keys[i].SkillId);
+		if (newSkill == true)
+		{
+			myAggregate->Skills.emplace_back().SkillId = keys[i].SkillId;
 		}
 
-		auto mapAgent = std::as_const(mySourceData.Agents).find(curEvent.AgentId);
+		entryAgents[i] = agentIndex;
+		entrySkills[i] = skillIndex;
 
-		// Loop through the array and pretend index is GroupFilter, if agent does not get filtered by that filter then add
-		// the total healing to that agent to the total for that filter
-		for (size_t i = 0; i < static_cast<uint32_t>(GroupFilter::Max); i++)
+		AgentAggregate& agent = myAggregate->Agents[agentIndex];
+		agent.Total += totals.Totals[i];
+		if (agent.IsFiltered == false)
 		{
-			switch (static_cast<GroupFilter>(i))
-			{
-			case GroupFilter::Group:
-				fakeOptions.ExcludeGroup = false;
-				fakeOptions.ExcludeOffGroup = true;
-				fakeOptions.ExcludeOffSquad = true;
-				fakeOptions.ExcludeMinions = true;
-				fakeOptions.ExcludeUnmapped = true;
-				break;
-			case GroupFilter::Squad:
-				fakeOptions.ExcludeGroup = false;
-				fakeOptions.ExcludeOffGroup = false;
-				fakeOptions.ExcludeOffSquad = true;
-				fakeOptions.ExcludeMinions = true;
-				fakeOptions.ExcludeUnmapped = true;
-				break;
-			case GroupFilter::AllExcludingMinions:
-				fakeOptions.ExcludeGroup = false;
-				fakeOptions.ExcludeOffGroup = false;
-				fakeOptions.ExcludeOffSquad = false;
-				fakeOptions.ExcludeMinions = true;
-				fakeOptions.ExcludeUnmapped = true;
-				break;
-			case GroupFilter::All:
-				fakeOptions.ExcludeGroup = false;
-				fakeOptions.ExcludeOffGroup = false;
-				fakeOptions.ExcludeOffSquad = false;
-				fakeOptions.ExcludeMinions = false;
-				fakeOptions.ExcludeUnmapped = true;
-				break;
-			default:
-				assert(false);
-			}
+			myAggregate->Skills[skillIndex].Total += totals.Totals[i];
+		}
+	}
+
+	for (const AgentAggregate& agent : myAggregate->Agents)
+	{
+		if (agent.IsFiltered == false)
+		{
+			myAggregate->Total += agent.Total;
+		}
+
+		// Masked adds instead of branches, the mask only depends on the agent
+		for (size_t i = 0; i < static_cast<size_t>(GroupFilter::Max); i++)
+		{
+			uint64_t included = (agent.GroupFilterMask >> i) & 1;
+			myAggregate->GroupFilters[i].Hits += included * agent.Total.Hits;
+			myAggregate->GroupFilters[i].Healing += included * agent.Total.Healing;
+			myAggregate->GroupFilters[i].Barrier += included * agent.Total.Barrier;
+		}
+	}
+
+	// Bucket the entries by agent and by skill (counting sort)
+	auto fillCells = [&totals](const std::vector<uint32_t>& pEntryRows, const std::vector<uint32_t>& pEntryIndices, size_t pRowCount,
+		std::vector<uint32_t>& pCellStart, std::vector<MatrixCell>& pCells)
+	{
+		pCellStart.assign(pRowCount + 1, 0);
+		for (uint32_t row : pEntryRows)
+		{
+			pCellStart[row + 1]++;
+		}
+		std::partial_sum(pCellStart.begin(), pCellStart.end(), pCellStart.begin());
+
+		std::vector<uint32_t> next(pCellStart.begin(), pCellStart.end() - 1);
+		pCells.resize(pEntryRows.size());
+		for (size_t i = 0; i < pEntryRows.size(); i++)
+		{
+			pCells[next[pEntryRows[i]]++] = MatrixCell{pEntryIndices[i], totals.Totals[i]};
+		}
+	};
+	fillCells(entryAgents, entrySkills, myAggregate->Agents.size(), myAggregate->AgentCellStart, myAggregate->AgentCells);
+	fillCells(entrySkills, entryAgents, myAggregate->Skills.size(), myAggregate->SkillCellStart, myAggregate->SkillCells);
+
+	// Views list agents and skills ordered by id (before sorting them by the chosen sort order), so equal entries
+	// always end up in the same order
+	myAggregate->AgentOrder.resize(myAggregate->Agents.size());
+	std::iota(myAggregate->AgentOrder.begin(), myAggregate->AgentOrder.end(), 0);
+	std::sort(myAggregate->AgentOrder.begin(), myAggregate->AgentOrder.end(),
+		[&agents = myAggregate->Agents](uint32_t pLeft, uint32_t pRight)
+		{
+			return agents[pLeft].AgentId < agents[pRight].AgentId;
+		});
+
+	myAggregate->SkillOrder.resize(myAggregate->Skills.size());
+	std::iota(myAggregate->SkillOrder.begin(), myAggregate->SkillOrder.end(), 0);
+	std::sort(myAggregate->SkillOrder.begin(), myAggregate->SkillOrder.end(),
+		[&skills = myAggregate->Skills](uint32_t pLeft, uint32_t pRight)
+		{
+			return skills[pLeft].SkillId < skills[pRight].SkillId;
+		});
+
+	return *myAggregate;
+}
+
+const AggregatedStats::RollingAggregate& AggregatedStats::GetRollingAggregate()
+{
+	if (myRollingAggregate != nullptr)
+	{
+		return *myRollingAggregate;
+	}
+
+	const Aggregate& aggregate = GetAggregate();
+	const uint64_t end = GetCombatEnd();
+	const double combatTime = GetCombatTime();
+
+	myRollingAggregate = std::make_unique<RollingAggregate>();
+	for (size_t i = 0; i < RollingHealing::WINDOW_COUNT; i++)
+	{
+		RollingWindow& window = (*myRollingAggregate)[i];
+		window.Duration = (std::min)(RollingHealing::WINDOWS[i] / 1000.0, combatTime);
+		window.AgentHealing.resize(aggregate.Agents.size());
+		window.SkillHealing.resize(aggregate.Skills.size());
 
-			if (FilterInternal(mapAgent, fakeOptions) == false)
+		mySourceData.Rolling.ForEachTotal(end, RollingHealing::WINDOWS[i], [&aggregate, &window](uintptr_t pAgentId, uint32_t pSkillId, const HealTotal& pTotal)
 			{
-				myGroupFilterTotals->Entries[i].Hits += 1;
-				// Healing always contains the total of both healing and barrier (if enabled)
-				myGroupFilterTotals->Entries[i].Healing += curEvent.Size;
-				// Check if current event is a barrier hit
-				if (curEvent.IsBarrier)
+				// Every event in the window is from before combat end, so its agent is part of the aggregate
+				std::optional<uint32_t> agentIndex = aggregate.AgentIndices.Find(pAgentId);
+				assert(agentIndex.has_value() == true);
+				if (agentIndex.has_value() == false)
 				{
-					// For barrier hits, track the total barrier separately as a sub-total of healing.
-					myGroupFilterTotals->Entries[i].Barrier += curEvent.Size;
+					return;
 				}
-			}
-		}
+
+				const AgentAggregate& agent = aggregate.Agents[*agentIndex];
+				window.AgentHealing[*agentIndex] += pTotal.Healing;
+				for (size_t groupFilter = 0; groupFilter < window.GroupFilters.size(); groupFilter++)
+				{
+					if ((agent.GroupFilterMask & (1 << groupFilter)) != 0)
+					{
+						window.GroupFilters[groupFilter] += pTotal.Healing;
+					}
+				}
+
+				if (agent.IsFiltered == true)
+				{
+					return;
+				}
+
+				window.Total += pTotal.Healing;
+				std::optional<uint32_t> skillIndex = aggregate.SkillIndices.Find(pSkillId);
+				if (skillIndex.has_value() == true)
+				{
+					window.SkillHealing[*skillIndex] += pTotal.Healing;
+				}
+			});
+	}
+
+	return *myRollingAggregate;
+}
+
+const AggregatedVector& AggregatedStats::GetGroupFilterTotals()
+{
+	if (myGroupFilterTotals != nullptr)
+	{
+		return *myGroupFilterTotals;
 	}
 
-	for (const AggregatedStatsEntry& entry : myGroupFilterTotals->Entries)
+	const Aggregate& aggregate = GetAggregate();
+
+	myGroupFilterTotals = std::make_unique<AggregatedVector>();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(GroupFilter::Max); i++)
 	{
-		myGroupFilterTotals->HighestHealing = (std::max)(myGroupFilterTotals->HighestHealing, entry.Healing);
+		const HealTotal& total = aggregate.GroupFilters[i];
+		myGroupFilterTotals->Add(0, GROUP_FILTER_STRING[i], GetCombatTime(), total.Healing, total.Hits, std::nullopt, total.Barrier);
+		myGroupFilterTotals->Entries.back().RollingHealingPerSecond = GetRollingPerSecond([i](const RollingWindow& pWindow)
+			{
+				return pWindow.GroupFilters[i];
+			});
 	}
 
 	return *myGroupFilterTotals;
@@ -199,6 +418,17 @@ float AggregatedStats::GetCombatTime()
 
 uint64_t AggregatedStats::GetCombatEnd()
 {
+	// Events of frozen states might have been dropped
+	uint64_t lastHealEvent = 0;
+	if (mySourceData.Events.size() != 0)
+	{
+		lastHealEvent = mySourceData.Events.back().Time;
+	}
+	else if (mySourceData.Frozen != nullptr)
+	{
+		lastHealEvent = mySourceData.Frozen->LastEventTime;
+	}
+
 	uint64_t end = 0;
 	CombatEndCondition endCondition = static_cast<CombatEndCondition>(myOptions.CombatEndConditionChoice);
 	if (endCondition == CombatEndCondition::CombatExit)
@@ -207,10 +437,7 @@ uint64_t AggregatedStats::GetCombatEnd()
 	}
 	else if (endCondition == CombatEndCondition::LastHealEvent)
 	{
-		if (mySourceData.Events.size() != 0)
-		{
-			end = mySourceData.Events.back().Time;
-		}
+		end = lastHealEvent;
 	}
 	else if (endCondition == CombatEndCondition::LastDamageEvent)
 	{
@@ -220,14 +447,7 @@ uint64_t AggregatedStats::GetCombatEnd()
 	{
 		assert(endCondition == CombatEndCondition::LastDamageOrHealEvent);
 
-		if (mySourceData.Events.size() != 0)
-		{
-			end = (std::max)(mySourceData.LastDamageEvent, mySourceData.Events.back().Time);
-		}
-		else
-		{
-			end = mySourceData.LastDamageEvent;
-		}
+		end = (std::max)(mySourceData.LastDamageEvent, lastHealEvent);
 	}
 
 	if (end == 0)
@@ -251,6 +471,57 @@ uint64_t AggregatedStats::GetCombatEnd()
 	return end;
 }
 
+// An entry of a view before its name is built
+struct EntryCandidate
+{
+	uint32_t Index = 0; // Agent or skill index, INDIRECT_HEALING_CANDIDATE for the indirect healing entry
+	uint32_t Order = 0; // Position before sorting, breaks ties
+	HealTotal Total;
+	bool IsIndirectHealing = false;
+};
+constexpr static uint32_t INDIRECT_HEALING_CANDIDATE = UINT32_MAX;
+
+// Orders pCandidates the way Sort orders the entries built from them and drops everything after the first pLimit, so
+// names only have to be built for the entries that are shown. Returns false without changing anything for the
+// alphabetical orders, since finding the first entries by name needs every name. pHighestHealing is set to the highest
+// healing of all candidates, including the dropped ones
+static bool SelectTopEntries(std::vector<EntryCandidate>& pCandidates, size_t pLimit, SortOrder pSortOrder, uint64_t& pHighestHealing)
+{
+	if (pSortOrder != SortOrder::AscendingSize && pSortOrder != SortOrder::DescendingSize)
+	{
+		return false;
+	}
+
+	pHighestHealing = 0;
+	for (size_t i = 0; i < pCandidates.size(); i++)
+	{
+		pCandidates[i].Order = static_cast<uint32_t>(i);
+		pHighestHealing = (std::max)(pHighestHealing, pCandidates[i].Total.Healing);
+	}
+
+	const bool descending = (pSortOrder == SortOrder::DescendingSize);
+	auto compare = [descending](const EntryCandidate& pLeft, const EntryCandidate& pRight)
+	{
+		if (pLeft.Total.Healing != pRight.Total.Healing)
+		{
+			return (descending == true) ? pLeft.Total.Healing > pRight.Total.Healing : pLeft.Total.Healing < pRight.Total.Healing;
+		}
+		return pLeft.Order < pRight.Order;
+	};
+
+	if (pLimit < pCandidates.size())
+	{
+		std::partial_sort(pCandidates.begin(), pCandidates.begin() + pLimit, pCandidates.end(), compare);
+		pCandidates.erase(pCandidates.begin() + pLimit, pCandidates.end());
+	}
+	else
+	{
+		std::sort(pCandidates.begin(), pCandidates.end(), compare);
+	}
+
+	return true;
+}
+
 const AggregatedVector& AggregatedStats::GetAgents(std::optional<uint32_t> pSkillId)
 {
 	AggregatedVector* entry = nullptr;
@@ -278,69 +549,60 @@ const AggregatedVector& AggregatedStats::GetAgents(std::optional<uint32_t> pSkil
 		entry = myFilteredAgents.get();
 	}
 
-	struct TempAgent
+	const Aggregate& aggregate = GetAggregate();
+
+	// Healing by the requested skill, indexed by agent index
+	std::vector<HealTotal> skillTotals;
+	if (pSkillId.has_value() == true)
 	{
-		std::map<uintptr_t, HealedAgent>::const_iterator Iterator;
-		uint64_t Ticks;
-		uint64_t Healing;
-		uint64_t Barrier;
+		skillTotals.resize(aggregate.Agents.size());
 
-		TempAgent(std::map<uintptr_t, HealedAgent>::const_iterator&& pIterator, uint64_t pTicks, uint64_t pHealing, uint64_t pBarrier)
-			: Iterator{ std::move(pIterator) }
-			, Ticks{ pTicks }
-			, Healing{ pHealing }
-			, Barrier{ pBarrier }
+		std::optional<uint32_t> skillIndex = aggregate.SkillIndices.Find(*pSkillId);
+		if (skillIndex.has_value() == true)
 		{
+			for (uint32_t i = aggregate.SkillCellStart[*skillIndex]; i < aggregate.SkillCellStart[*skillIndex + 1]; i++)
+			{
+				skillTotals[aggregate.SkillCells[i].Index] = aggregate.SkillCells[i].Total;
+			}
 		}
-	};
-	std::map<uintptr_t, TempAgent> tempMap;
-
-	uint64_t combatEnd = GetCombatEnd();
+	}
 
-	for (const HealEvent& curEvent : mySourceData.Events)
+	std::vector<EntryCandidate> candidates;
+	for (uint32_t agentIndex : aggregate.AgentOrder)
 	{
-		if (curEvent.Time > combatEnd)
+		const AgentAggregate& agent = aggregate.Agents[agentIndex];
+		if (agent.IsFiltered == true)
 		{
 			continue;
 		}
 
-		if (pSkillId.has_value() == true)
-		{
-			if (curEvent.SkillId != *pSkillId)
-			{
-				continue;
-			}
-		}
-
-		auto mapAgent = std::as_const(mySourceData.Agents).find(curEvent.AgentId);
-		if (Filter(mapAgent) == true)
+		const HealTotal& total = (pSkillId.has_value() == true) ? skillTotals[agentIndex] : agent.Total;
+		if (total.Hits == 0)
 		{
 			continue;
 		}
 
-		auto [agent, _inserted] = tempMap.try_emplace(curEvent.AgentId, std::move(mapAgent), 0, 0, 0);
-
-		agent->second.Ticks += 1;
-		// Healing always contains the total of both healing and barrier (if enabled)
-		agent->second.Healing += curEvent.Size;
-		// Check if current event is a barrier hit
-		if (curEvent.IsBarrier)
-		{
-			// For barrier hits, track the total barrier separately as a sub-total of healing.
-			agent->second.Barrier += curEvent.Size;
-		}			
+		candidates.emplace_back(EntryCandidate{agentIndex, 0, total});
 	}
 
+	const std::optional<size_t> limit = (pSkillId.has_value() == false) ? GetEntryLimit(myOptions) : std::nullopt;
+	uint64_t highestHealing = 0;
+	const bool selected = limit.has_value() == true && SelectTopEntries(candidates, *limit, myOptions.SortOrderChoice, highestHealing) == true;
+
 	// Caching the result in a display friendly way
-	for (const auto& [agentId, agent] : tempMap)
+	for (const EntryCandidate& candidate : candidates)
 	{
+		const AgentAggregate& agent = aggregate.Agents[candidate.Index];
+		const HealTotal& total = candidate.Total;
+
+		const uintptr_t agentId = agent.AgentId;
 		std::string agentName;
 
 		if (myDebugMode == false)
 		{
-			if (agent.Iterator != mySourceData.Agents.end())
+			if (agent.Agent != mySourceData.Agents->end())
 			{
-				agentName = agent.Iterator->second.Name;
+				agentName = agent.Agent->second.Name;
 			}
 			else
 			{
@@ -351,9 +613,9 @@ const AggregatedVector& AggregatedStats::GetAgents(std::optional<uint32_t> pSkil
 		else
 		{
 			char buffer[1024];
-			if (agent.Iterator != mySourceData.Agents.end())
+			if (agent.Agent != mySourceData.Agents->end())
 			{
-				snprintf(buffer, sizeof(buffer), "%llu ; %u ; %u ; %s", agentId, agent.Iterator->second.Subgroup, agent.Iterator->second.IsMinion, agent.Iterator->second.Name.c_str());
+				snprintf(buffer, sizeof(buffer), "%llu ; %u ; %u ; %s", agentId, agent.Agent->second.Subgroup, agent.Agent->second.IsMinion, agent.Agent->second.Name.c_str());
 			}
 			else
 			{
@@ -363,10 +625,17 @@ const AggregatedVector& AggregatedStats::GetAgents(std::optional<uint32_t> pSkil
 			agentName = buffer;
 		}
 
-		entry->Add(agentId, std::move(agentName), GetCombatTime(), agent.Healing, agent.Ticks, std::nullopt, agent.Barrier);
+		entry->Add(agentId, std::move(agentName), GetCombatTime(), total.Healing, total.Hits, std::nullopt, total.Barrier);
+		if (pSkillId.has_value() == false)
+		{
+			entry->Entries.back().RollingHealingPerSecond = GetRollingPerSecond([&candidate](const RollingWindow& pWindow)
+				{
+					return pWindow.AgentHealing[candidate.Index];
+				});
+		}
 	}
 
-	Sort(entry->Entries, myOptions.SortOrderChoice);
+	FinishEntries(*entry, limit, selected, highestHealing);
 
 	return *entry;
 }
@@ -398,73 +667,44 @@ const AggregatedVector& AggregatedStats::GetSkills(std::optional<uintptr_t> pAge
 		entry = mySkills.get();
 	}
 
-	struct TempSkill
-	{
-		uint64_t Ticks;
-		uint64_t Healing;
-		uint64_t Barrier;
-
-		TempSkill(uint64_t pTicks, uint64_t pHealing, uint64_t pBarrier)
-			: Ticks{ pTicks }
-			, Healing{ pHealing }
-			, Barrier{ pBarrier }
-		{
-		}
-	};
-	std::map<uint32_t, TempSkill> tempMap;
-
-	uint64_t combatEnd = GetCombatEnd();
-	uint64_t totalIndirectHealing = 0;
-	uint64_t totalIndirectTicks = 0;
-	uint64_t totalIndirectBarrier = 0;
+	const Aggregate& aggregate = GetAggregate();
 
-	for (const HealEvent& curEvent : mySourceData.Events)
+	// Healing to the requested agent (details for a single agent are not filtered), indexed by skill index
+	std::vector<HealTotal> agentTotals;
+	if (pAgentId.has_value() == true)
 	{
-		if (curEvent.Time > combatEnd)
-		{
-			continue;
-		}
+		agentTotals.resize(aggregate.Skills.size());
 
-		if (pAgentId.has_value() == true)
+		std::optional<uint32_t> agentIndex = aggregate.AgentIndices.Find(*pAgentId);
+		if (agentIndex.has_value() == true)
 		{
-			if (curEvent.AgentId != *pAgentId)
+			for (uint32_t i = aggregate.AgentCellStart[*agentIndex]; i < aggregate.AgentCellStart[*agentIndex + 1]; i++)
 			{
-				continue;
+				agentTotals[aggregate.AgentCells[i].Index] = aggregate.AgentCells[i].Total;
 			}
 		}
-		else
-		{
-			auto mapAgent = std::as_const(mySourceData.Agents).find(curEvent.AgentId);
-			if (Filter(mapAgent) == true)
-			{
-				continue;
-			}
-		}
-
-		auto [skill, _inserted] = tempMap.try_emplace(curEvent.SkillId, 0, 0, 0);
+	}
 
-		skill->second.Ticks += 1;
-		// Healing always contains the total of both healing and barrier (if enabled)
-		skill->second.Healing += curEvent.Size;
-		// Check if current event is a barrier hit
-		if (curEvent.IsBarrier)
+	std::vector<EntryCandidate> candidates;
+	HealTotal indirectHealing;
+	std::array<uint64_t, RollingHealing::WINDOW_COUNT> indirectRolling = {}; // Rolling healing of the indirect healing entry
+	for (uint32_t skillIndex : aggregate.SkillOrder)
+	{
+		const uint32_t skillId = aggregate.Skills[skillIndex].SkillId;
+		const HealTotal& skill = (pAgentId.has_value() == true) ? agentTotals[skillIndex] : aggregate.Skills[skillIndex].Total;
+		if (skill.Hits == 0)
 		{
-			// For barrier hits, track the total barrier separately as a sub-total of healing.
-			skill->second.Barrier += curEvent.Size;
+			continue;
 		}
-	}
 
-	for (const auto& [skillId, skill] : tempMap)
-	{
 		char buffer[1024];
-		char buffer2[1024];
 
 		const char* skillName = mySourceData.Skills->GetSkillName(skillId);
 		if (skillName == nullptr)
 		{
 			LOG("Couldn't map skill %u", skillId);
-			snprintf(buffer2, sizeof(buffer2), "%u", skillId);
-			skillName = buffer2;
+			snprintf(buffer, sizeof(buffer), "%u", skillId);
+			skillName = buffer;
 		}
 
 		bool isIndirectHealing = false;
@@ -472,10 +712,15 @@ const AggregatedVector& AggregatedStats::GetSkills(std::optional<uintptr_t> pAge
 		{
 			LogD("Translating skill {} {} to indirect healing", skillId, skillName);
 
-			totalIndirectHealing += skill.Healing;
-			totalIndirectTicks += skill.Ticks;
-			totalIndirectBarrier += skill.Barrier;
+			indirectHealing += skill;
 			isIndirectHealing = true;
+			if (pAgentId.has_value() == false)
+			{
+				for (size_t i = 0; i < indirectRolling.size(); i++)
+				{
+					indirectRolling[i] += GetRollingAggregate()[i].SkillHealing[skillIndex];
+				}
+			}
 
 			if (myDebugMode == false)
 			{
@@ -483,24 +728,67 @@ const AggregatedVector& AggregatedStats::GetSkills(std::optional<uintptr_t> pAge
 			}
 		}
 
-		if (myDebugMode == true)
-		{
-			snprintf(buffer, sizeof(buffer), "%s%u ; %s", isIndirectHealing ? "(INDIRECT) ; " : "", skillId, skillName);
-			skillName = buffer;
-		}
-
-		entry->Add(skillId, std::string{skillName}, GetCombatTime(), skill.Healing, skill.Ticks, std::nullopt, skill.Barrier);
+		candidates.emplace_back(EntryCandidate{skillIndex, 0, skill, isIndirectHealing});
 	}
 
 	// TODO: Can this be separated into indirect healing and barrier as separate entries? 
-	if (totalIndirectHealing != 0 || totalIndirectTicks != 0 || totalIndirectBarrier != 0)
+	if (indirectHealing.Healing != 0 || indirectHealing.Hits != 0 || indirectHealing.Barrier != 0)
+	{
+		candidates.emplace_back(EntryCandidate{INDIRECT_HEALING_CANDIDATE, 0, indirectHealing});
+	}
+
+	const std::optional<size_t> limit = (pAgentId.has_value() == false) ? GetEntryLimit(myOptions) : std::nullopt;
+	uint64_t highestHealing = 0;
+	const bool selected = limit.has_value() == true && SelectTopEntries(candidates, *limit, myOptions.SortOrderChoice, highestHealing) == true;
+
+	for (const EntryCandidate& candidate : candidates)
 	{
-		std::string skillName("From Damage Dealt");
+		const HealTotal& skill = candidate.Total;
+		if (candidate.Index == INDIRECT_HEALING_CANDIDATE)
+		{
+			std::string skillName("From Damage Dealt");
 
-		entry->Add(IndirectHealingSkillId, std::move(skillName), GetCombatTime(), totalIndirectHealing, totalIndirectTicks, std::nullopt, totalIndirectBarrier);
+			entry->Add(IndirectHealingSkillId, std::move(skillName), GetCombatTime(), skill.Healing, skill.Hits, std::nullopt, skill.Barrier);
+			if (pAgentId.has_value() == false)
+			{
+				const RollingAggregate& rolling = GetRollingAggregate();
+				for (size_t i = 0; i < rolling.size(); i++)
+				{
+					entry->Entries.back().RollingHealingPerSecond[i] = divide_safe(indirectRolling[i], rolling[i].Duration);
+				}
+			}
+			continue;
+		}
+
+		const uint32_t skillId = aggregate.Skills[candidate.Index].SkillId;
+
+		char buffer[1024];
+		char buffer2[1024];
+
+		const char* skillName = mySourceData.Skills->GetSkillName(skillId);
+		if (skillName == nullptr)
+		{
+			snprintf(buffer2, sizeof(buffer2), "%u", skillId);
+			skillName = buffer2;
+		}
+
+		if (myDebugMode == true)
+		{
+			snprintf(buffer, sizeof(buffer), "%s%u ; %s", candidate.IsIndirectHealing ? "(INDIRECT) ; " : "", skillId, skillName);
+			skillName = buffer;
+		}
+
+		entry->Add(skillId, std::string{skillName}, GetCombatTime(), skill.Healing, skill.Hits, std::nullopt, skill.Barrier);
+		if (pAgentId.has_value() == false)
+		{
+			entry->Entries.back().RollingHealingPerSecond = GetRollingPerSecond([&candidate](const RollingWindow& pWindow)
+				{
+					return pWindow.SkillHealing[candidate.Index];
+				});
+		}
 	}
 
-	Sort(entry->Entries, myOptions.SortOrderChoice);
+	FinishEntries(*entry, limit, selected, highestHealing);
 
 	return *entry;
 }
@@ -546,20 +834,105 @@ void AggregatedStats::Sort(std::vector<AggregatedStatsEntry>& pVector, SortOrder
 	}
 }
 
+std::optional<size_t> AggregatedStats::GetEntryLimit(const HealWindowOptions& pOptions)
+{
+	if (pOptions.TopEntriesOnly == false || pOptions.MaxLinesDisplayed == 0)
+	{
+		return std::nullopt;
+	}
+
+	return pOptions.MaxLinesDisplayed;
+}
+
+void AggregatedStats::FinishEntries(AggregatedVector& pVector, std::optional<size_t> pLimit, bool pSelected, uint64_t pHighestHealing) const
+{
+	if (pSelected == true)
+	{
+		// Already in order. Bars are still relative to the highest entry, even if it was cut off
+		pVector.HighestHealing = pHighestHealing;
+		return;
+	}
+
+	Sort(pVector.Entries, myOptions.SortOrderChoice);
+	if (pLimit.has_value() == true && pVector.Entries.size() > *pLimit)
+	{
+		pVector.Entries.erase(pVector.Entries.begin() + *pLimit, pVector.Entries.end());
+	}
+}
+
+uint8_t AggregatedStats::GetGroupFilterMask(AgentSnapshot::const_iterator& pAgent) const
+{
+	// Pretend index is GroupFilter and build the options that filter exactly like that group filter
+	static const std::array<HealWindowOptions, static_cast<size_t>(GroupFilter::Max)> groupFilterOptions = []()
+	{
+		std::array<HealWindowOptions, static_cast<size_t>(GroupFilter::Max)> result;
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			HealWindowOptions& fakeOptions = result[i];
+			switch (static_cast<GroupFilter>(i))
+			{
+			case GroupFilter::Group:
+				fakeOptions.ExcludeGroup = false;
+				fakeOptions.ExcludeOffGroup = true;
+				fakeOptions.ExcludeOffSquad = true;
+				fakeOptions.ExcludeMinions = true;
+				fakeOptions.ExcludeUnmapped = true;
+				break;
+			case GroupFilter::Squad:
+				fakeOptions.ExcludeGroup = false;
+				fakeOptions.ExcludeOffGroup = false;
+				fakeOptions.ExcludeOffSquad = true;
+				fakeOptions.ExcludeMinions = true;
+				fakeOptions.ExcludeUnmapped = true;
+				break;
+			case GroupFilter::AllExcludingMinions:
+				fakeOptions.ExcludeGroup = false;
+				fakeOptions.ExcludeOffGroup = false;
+				fakeOptions.ExcludeOffSquad = false;
+				fakeOptions.ExcludeMinions = true;
+				fakeOptions.ExcludeUnmapped = true;
+				break;
+			case GroupFilter::All:
+				fakeOptions.ExcludeGroup = false;
+				fakeOptions.ExcludeOffGroup = false;
+				fakeOptions.ExcludeOffSquad = false;
+				fakeOptions.ExcludeMinions = false;
+				fakeOptions.ExcludeUnmapped = true;
+				break;
+			default:
+				assert(false);
+			}
+		}
+		return result;
+	}();
+
+	static_assert(static_cast<size_t>(GroupFilter::Max) <= 8, "Group filter mask doesn't fit in uint8_t");
+
+	uint8_t result = 0;
+	for (size_t i = 0; i < groupFilterOptions.size(); i++)
+	{
+		if (FilterInternal(pAgent, groupFilterOptions[i]) == false)
+		{
+			result |= (1 << i);
+		}
+	}
+	return result;
+}
+
 bool AggregatedStats::Filter(uintptr_t pAgentId) const
 {
-	std::map<uintptr_t, HealedAgent>::const_iterator agent = mySourceData.Agents.find(pAgentId);
+	AgentSnapshot::const_iterator agent = mySourceData.Agents->find(pAgentId);
 	return FilterInternal(agent, myOptions);
 }
 
-bool AggregatedStats::Filter(std::map<uintptr_t, HealedAgent>::const_iterator& pAgent) const
+bool AggregatedStats::Filter(AgentSnapshot::const_iterator& pAgent) const
 {
 	return FilterInternal(pAgent, myOptions);
 }
 
-bool AggregatedStats::FilterInternal(std::map<uintptr_t, HealedAgent>::const_iterator& pAgent, const HealWindowOptions& pFilter) const
+bool AggregatedStats::FilterInternal(AgentSnapshot::const_iterator& pAgent, const HealWindowOptions& pFilter) const
 {
-	if (pAgent == mySourceData.Agents.end() || pAgent->second.Name.size() == 0)
+	if (pAgent == mySourceData.Agents->end() || pAgent->second.Name.size() == 0)
 	{
 		if (pFilter.ExcludeUnmapped == true)
 		{
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "DenseIndexMap.h"
 #include "State.h"
 #include "EventProcessor.h"
 
 #include <stdint.h>
 
 #include <array>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
@@ -31,11 +33,15 @@ struct AggregatedStatsEntry
 	std::optional<uint64_t> Casts;
 	uint64_t Barrier;
 
+	// Healing per second in each of RollingHealing::WINDOWS. Only set for the agent, skill, totals and peer views (not
+	// for details views)
+	std::array<double, RollingHealing::WINDOW_COUNT> RollingHealingPerSecond = {};
+
 	AggregatedStatsEntry(uint64_t pId, std::string&& pName, float pTimeInCombat, uint64_t pHealing, uint64_t pHits, std::optional<uint64_t> pCasts, uint64_t pBarrier);
 
 	auto GetTie() const
 	{
-		return std::tie(Id, Name, TimeInCombat, Healing, Hits, Casts, Barrier);
+		return std::tie(Id, Name, TimeInCombat, Healing, Hits, Casts, Barrier, RollingHealingPerSecond);
 	}
 };
 
@@ -57,7 +63,22 @@ class AggregatedStats
 {
 	friend AggregatedStatsCollection;
 public:
-	AggregatedStats(HealingStats&& pSourceData, const HealWindowOptions& pOptions, bool pDebugMode);
+	// Totals per <agent, skill> that were computed for an earlier snapshot of the same player. Aggregating a later
+	// snapshot can start from them and only fold in the events appended since then, instead of starting from the last
+	// checkpoint of the running totals
+	struct TotalsBase
+	{
+		HealEventLog Events; // Events of the earlier snapshot
+		uint64_t CombatEnd = 0;
+		size_t EventCount = 0; // Totals include the events in [0, EventCount) with time <= CombatEnd
+		std::shared_ptr<const HealEventTotals::Table> Totals;
+	};
+
+	// pBase is only used if it is still valid for pSourceData (see GetAgentSkillTotals)
+	AggregatedStats(HealingStats&& pSourceData, const HealWindowOptions& pOptions, bool pDebugMode, const TotalsBase* pBase = nullptr);
+
+	// Returns what a later snapshot of the same player can start from. Aggregates the totals if that didn't happen yet
+	TotalsBase GetTotalsBase();
 
 	const AggregatedStatsEntry& GetTotal();
 	const AggregatedVector& GetStats(DataSource pDataSource);
@@ -67,6 +88,10 @@ public:
 
 	float GetCombatTime();
 
+	// Number of entries the agent, skill and peer views (not the details views) are cut off at, std::nullopt if they
+	// show every entry
+	static std::optional<size_t> GetEntryLimit(const HealWindowOptions& pOptions);
+
 private:
 	uint64_t GetCombatEnd();
 
@@ -75,9 +100,84 @@ private:
 
 	static void Sort(std::vector<AggregatedStatsEntry>& pVector, SortOrder pSortOrder);
 
+	// Sorts pVector and cuts it off at pLimit, unless pSelected says SelectTopEntries already did both
+	void FinishEntries(AggregatedVector& pVector, std::optional<size_t> pLimit, bool pSelected, uint64_t pHighestHealing) const;
+
+	// Totals per <agent, skill> of all events until the end of combat. Built from the running totals in mySourceData
+	// when possible, only scanning events after the last usable checkpoint (or after the base, if that is later)
+	const HealEventTotals::Table& GetAgentSkillTotals();
+
+	struct AgentAggregate
+	{
+		uintptr_t AgentId = 0;
+		AgentSnapshot::const_iterator Agent;
+		bool IsFiltered = false; // Filtered out by myOptions
+		uint8_t GroupFilterMask = 0; // Bit (1 << GroupFilter) is set if the agent is included by that group filter
+		HealTotal Total;
+	};
+
+	struct SkillAggregate
+	{
+		uint32_t SkillId = 0;
+		HealTotal Total; // Healing to agents that aren't filtered out
+	};
+
+	struct MatrixCell
+	{
+		uint32_t Index = 0;
+		HealTotal Total;
+	};
+
+	// Agent and skill ids are remapped to dense indices, everything is accumulated in arrays indexed by those
+	struct Aggregate
+	{
+		DenseIndexMap<uintptr_t> AgentIndices; // Agent id => agent index
+		std::vector<AgentAggregate> Agents; // Indexed by agent index
+		std::vector<uint32_t> AgentOrder; // Agent indices ordered by agent id
+
+		DenseIndexMap<uint32_t> SkillIndices; // Skill id => skill index
+		std::vector<SkillAggregate> Skills; // Indexed by skill index
+		std::vector<uint32_t> SkillOrder; // Skill indices ordered by skill id
+
+		// Sparse agent x skill matrix of GetAgentSkillTotals(), stored both row by row and column by column. The cells
+		// of agent index i are AgentCells[AgentCellStart[i]] until AgentCells[AgentCellStart[i + 1]] (and the same for
+		// skills), so every details view is a slice of it
+		std::vector<uint32_t> AgentCellStart; // Size is Agents.size() + 1
+		std::vector<MatrixCell> AgentCells; // MatrixCell::Index is a skill index
+		std::vector<uint32_t> SkillCellStart; // Size is Skills.size() + 1
+		std::vector<MatrixCell> SkillCells; // MatrixCell::Index is an agent index
+
+		HealTotal Total; // Healing to agents that aren't filtered out
+		std::array<HealTotal, static_cast<size_t>(GroupFilter::Max)> GroupFilters;
+	};
+
+	// Fills the agent, skill and group filter accumulators in a single pass over GetAgentSkillTotals() and buckets the
+	// entries into the agent x skill matrix. Every other getter is a view over the result
+	const Aggregate& GetAggregate();
+
+	// Healing in one of the rolling windows up to the end of combat, using the indices of GetAggregate()
+	struct RollingWindow
+	{
+		double Duration = 0.0; // Seconds, shorter than the window if combat didn't last that long
+		std::vector<uint64_t> AgentHealing; // Indexed by agent index
+		std::vector<uint64_t> SkillHealing; // Indexed by skill index, healing to agents that aren't filtered out
+		uint64_t Total = 0; // Healing to agents that aren't filtered out
+		std::array<uint64_t, static_cast<size_t>(GroupFilter::Max)> GroupFilters = {};
+	};
+	using RollingAggregate = std::array<RollingWindow, RollingHealing::WINDOW_COUNT>;
+
+	// Built from the rolling healing buckets in mySourceData, so it only visits the buckets inside the windows (and the
+	// events of the two buckets at the edges of each window)
+	const RollingAggregate& GetRollingAggregate();
+
+	// Divides pHealing(window) by the duration of every rolling window
+	template <typename Function>
+	std::array<double, RollingHealing::WINDOW_COUNT> GetRollingPerSecond(Function&& pHealing);
+
+	uint8_t GetGroupFilterMask(AgentSnapshot::const_iterator& pAgent) const; // See AgentAggregate::GroupFilterMask
 	bool Filter(uintptr_t pAgentId) const; // Returns true if agent should be filtered out
-	bool Filter(std::map<uintptr_t, HealedAgent>::const_iterator& pAgent) const; // Returns true if agent should be filtered out
-	bool FilterInternal(std::map<uintptr_t, HealedAgent>::const_iterator& pAgent, const HealWindowOptions& pFilter) const; // Returns true if agent should be filtered out
+	bool Filter(AgentSnapshot::const_iterator& pAgent) const; // Returns true if agent should be filtered out
+	bool FilterInternal(AgentSnapshot::const_iterator& pAgent, const HealWindowOptions& pFilter) const; // Returns true if agent should be filtered out
 
 	HealingStats mySourceData;
 
@@ -89,6 +189,11 @@ private:
 	std::unique_ptr<AggregatedVector> myFilteredAgents;
 	std::unique_ptr<AggregatedVector> mySkills;
 	std::unique_ptr<AggregatedVector> myGroupFilterTotals;
+	std::shared_ptr<const HealEventTotals::Table> myAgentSkillTotals;
+	size_t myAgentSkillTotalsEventCount = 0; // See TotalsBase::EventCount
+	std::optional<TotalsBase> myBase;
+	std::unique_ptr<Aggregate> myAggregate;
+	std::unique_ptr<RollingAggregate> myRollingAggregate;
 
 	std::map<uintptr_t, AggregatedVector> myAgentsDetailed; // uintptr_t => agent id
 	std::map<uint32_t, AggregatedVector> mySkillsDetailed; // uint32_t => skill id
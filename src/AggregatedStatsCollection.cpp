@@ -4,20 +4,31 @@
 
 const static AggregatedVector EMPTY_STATS;
 
-AggregatedStatsCollection::Player::Player(std::string&& pName, HealingStats&& pStats, const HealWindowOptions& pOptions, bool pDebugMode)
+AggregatedStatsCollection::Player::Player(std::string&& pName, HealingStats&& pStats, const HealWindowOptions& pOptions, bool pDebugMode, const AggregatedStats::TotalsBase* pTotalsBase)
 	: Name{ std::move(pName) }
-	, Stats{ std::move(pStats), pOptions, pDebugMode }
+	, Stats{ std::move(pStats), pOptions, pDebugMode, pTotalsBase }
 {
 }
 
-AggregatedStatsCollection::AggregatedStatsCollection(std::map<uintptr_t, std::pair<std::string, HealingStats>>&& pPeerStates, uintptr_t pLocalUniqueId, const HealWindowOptions& pOptions, bool pDebugMode)
+AggregatedStatsCollection::AggregatedStatsCollection(std::map<uintptr_t, std::pair<std::string, HealingStats>>&& pPeerStates, uintptr_t pLocalUniqueId, const HealWindowOptions& pOptions, bool pDebugMode, ThreadPool* pThreadPool, const std::map<uintptr_t, AggregatedStats::TotalsBase>* pTotalsBases)
 	: mOptions{ pOptions }
 	, mDebugMode{ pDebugMode }
+	, mThreadPool{ pThreadPool }
 {
 	mLocalState = mSourceData.end();
 	for (auto& [id, state] : pPeerStates)
 	{
-		auto [iter, inserted] = mSourceData.try_emplace(id, std::move(state.first), std::move(state.second), pOptions, pDebugMode);
+		const AggregatedStats::TotalsBase* totalsBase = nullptr;
+		if (pTotalsBases != nullptr)
+		{
+			auto base = pTotalsBases->find(id);
+			if (base != pTotalsBases->end())
+			{
+				totalsBase = &base->second;
+			}
+		}
+
+		auto [iter, inserted] = mSourceData.try_emplace(id, std::move(state.first), std::move(state.second), pOptions, pDebugMode, totalsBase);
 		assert(inserted == true);
 		if (id == pLocalUniqueId)
 		{
@@ -70,13 +81,39 @@ const AggregatedVector& AggregatedStatsCollection::GetStats(DataSource pDataSour
 
 	mPeersOutgoingStats = std::make_unique<AggregatedVector>();
 
+	// The aggregation of every peer is independent of the others (each AggregatedStats is only touched by one thread),
+	// so aggregate them in parallel first. The loop below then only reads cached results
+	if (mThreadPool != nullptr && mSourceData.size() > 1)
+	{
+		std::vector<AggregatedStats*> peers;
+		peers.reserve(mSourceData.size());
+		for (auto& [id, source] : mSourceData)
+		{
+			peers.emplace_back(&source.Stats);
+		}
+
+		mThreadPool->ParallelFor(peers.size(), [&peers](size_t pIndex)
+			{
+				peers[pIndex]->GetTotal();
+			});
+	}
+
 	for (auto& [id, source] : mSourceData)
 	{
 		const AggregatedStatsEntry& entry = source.Stats.GetTotal();
 		mPeersOutgoingStats->Add(id, std::string{source.Name}, source.Stats.GetCombatTime(), entry.Healing, entry.Hits, entry.Casts, entry.Barrier);
+		mPeersOutgoingStats->Entries.back().RollingHealingPerSecond = entry.RollingHealingPerSecond;
 	}
 
 	AggregatedStats::Sort(mPeersOutgoingStats->Entries, mOptions.SortOrderChoice);
+
+	// There are few enough peers that sorting all of them is cheap
+	std::optional<size_t> limit = AggregatedStats::GetEntryLimit(mOptions);
+	if (limit.has_value() == true && mPeersOutgoingStats->Entries.size() > *limit)
+	{
+		mPeersOutgoingStats->Entries.erase(mPeersOutgoingStats->Entries.begin() + *limit, mPeersOutgoingStats->Entries.end());
+	}
+
 	return *mPeersOutgoingStats;
 }
 
@@ -105,3 +142,17 @@ float AggregatedStatsCollection::GetCombatTime()
 {
 	return mLocalState->second.Stats.GetCombatTime();
 }
+
+std::map<uintptr_t, AggregatedStats::TotalsBase> AggregatedStatsCollection::GetTotalsBases()
+{
+	std::map<uintptr_t, AggregatedStats::TotalsBase> result;
+	for (auto& [id, player] : mSourceData)
+	{
+		if (player.Stats.myAgentSkillTotals != nullptr)
+		{
+			result.emplace(id, player.Stats.GetTotalsBase());
+		}
+	}
+
+	return result;
+}
@@ -1,18 +1,22 @@
 #pragma once
 #include "AggregatedStats.h"
+#include "ThreadPool.h"
 
 class AggregatedStatsCollection
 {
 	struct Player
 	{
-		Player(std::string&& pName, HealingStats&& pStats, const HealWindowOptions& pOptions, bool pDebugMode);
+		Player(std::string&& pName, HealingStats&& pStats, const HealWindowOptions& pOptions, bool pDebugMode, const AggregatedStats::TotalsBase* pTotalsBase);
 
 		AggregatedStats Stats;
 		std::string Name;
 	};
 
 public:
-	AggregatedStatsCollection(std::map<uintptr_t, std::pair<std::string, HealingStats>>&& pPeerStates, uintptr_t pLocalUniqueId, const HealWindowOptions& pOptions, bool pDebugMode);
+	// If pThreadPool is set, the stats of different peers are aggregated on it in parallel. It has to outlive the collection.
+	// pTotalsBases are the GetTotalsBases() of a previous collection of the same players, so only the events that were
+	// added since then are aggregated
+	AggregatedStatsCollection(std::map<uintptr_t, std::pair<std::string, HealingStats>>&& pPeerStates, uintptr_t pLocalUniqueId, const HealWindowOptions& pOptions, bool pDebugMode, ThreadPool* pThreadPool = nullptr, const std::map<uintptr_t, AggregatedStats::TotalsBase>* pTotalsBases = nullptr);
 
 	const AggregatedStatsEntry& GetTotal(DataSource pDataSource);
 	const AggregatedVector& GetStats(DataSource pDataSource);
@@ -22,6 +26,9 @@ public:
 
 	float GetCombatTime();
 
+	// Totals of every player whose stats were aggregated so far, to build the next collection on
+	std::map<uintptr_t, AggregatedStats::TotalsBase> GetTotalsBases();
+
 private:
 	std::unique_ptr<AggregatedVector> mPeersOutgoingStats;
 	std::unique_ptr<AggregatedStatsEntry> mPeersOutgoingTotal;
@@ -30,4 +37,5 @@ private:
 	std::map<uintptr_t, Player> mSourceData;
 	const HealWindowOptions mOptions;
 	const bool mDebugMode;
+	ThreadPool* const mThreadPool;
 };
\ No newline at end of file
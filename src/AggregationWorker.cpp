@@ -0,0 +1,260 @@
+#include "AggregationWorker.h"
+
+#include "Log.h"
+
+#include <cassert>
+
+AggregationWorker::AggregationWorker(EventProcessor& pEventProcessor, ThreadPool* pThreadPool, std::chrono::milliseconds pRefreshInterval)
+	: mEventProcessor{pEventProcessor}
+	, mThreadPool{pThreadPool}
+	, mRefreshInterval{pRefreshInterval}
+{
+	mWorker = std::thread{&AggregationWorker::ThreadMain, this};
+}
+
+AggregationWorker::~AggregationWorker()
+{
+	Shutdown();
+}
+
+void AggregationWorker::SetWindow(uint32_t pWindowIndex, const HealWindowOptions* pOptions, bool pDebugMode, uint64_t pEncounterId)
+{
+	assert(pWindowIndex < HEAL_WINDOW_COUNT);
+
+	WindowRequest request;
+	request.Shown = (pOptions != nullptr);
+	if (pOptions != nullptr)
+	{
+		request.Options = *pOptions;
+		request.DebugMode = pDebugMode;
+		request.EncounterId = pEncounterId;
+	}
+
+	std::lock_guard lock(mLock);
+	if (IsSameAggregation(mRequests[pWindowIndex], request) == true)
+	{
+		return;
+	}
+
+	// Published stats of a hidden window are kept, so that they can be shown until the window is aggregated again
+	mRequests[pWindowIndex] = request;
+	mRequestsChanged = true;
+	mWakeup.notify_one();
+}
+
+void AggregationWorker::SetRefreshInterval(std::chrono::milliseconds pRefreshInterval)
+{
+	std::lock_guard lock(mLock);
+	if (mRefreshInterval == pRefreshInterval)
+	{
+		return;
+	}
+
+	mRefreshInterval = pRefreshInterval;
+	mRequestsChanged = true;
+	mWakeup.notify_one();
+}
+
+std::shared_ptr<AggregatedStatsCollection> AggregationWorker::GetStats(uint32_t pWindowIndex) const
+{
+	assert(pWindowIndex < HEAL_WINDOW_COUNT);
+	return mPublished[pWindowIndex].load(std::memory_order_acquire);
+}
+
+void AggregationWorker::Shutdown()
+{
+	{
+		std::lock_guard lock(mLock);
+		mShutdown = true;
+		mWakeup.notify_one();
+	}
+
+	if (mWorker.joinable() == true)
+	{
+		mWorker.join();
+	}
+}
+
+bool AggregationWorker::IsSameAggregation(const WindowRequest& pLeft, const WindowRequest& pRight)
+{
+	if (pLeft.Shown == false || pRight.Shown == false)
+	{
+		return pLeft.Shown == pRight.Shown;
+	}
+
+	// Only options that change the result of aggregating matter, the rest are display options
+	return pLeft.DebugMode == pRight.DebugMode &&
+		pLeft.EncounterId == pRight.EncounterId &&
+		pLeft.Options.DataSourceChoice == pRight.Options.DataSourceChoice &&
+		pLeft.Options.SortOrderChoice == pRight.Options.SortOrderChoice &&
+		pLeft.Options.CombatEndConditionChoice == pRight.Options.CombatEndConditionChoice &&
+		pLeft.Options.ExcludeGroup == pRight.Options.ExcludeGroup &&
+		pLeft.Options.ExcludeOffGroup == pRight.Options.ExcludeOffGroup &&
+		pLeft.Options.ExcludeOffSquad == pRight.Options.ExcludeOffSquad &&
+		pLeft.Options.ExcludeMinions == pRight.Options.ExcludeMinions &&
+		pLeft.Options.ExcludeUnmapped == pRight.Options.ExcludeUnmapped &&
+		AggregatedStats::GetEntryLimit(pLeft.Options) == AggregatedStats::GetEntryLimit(pRight.Options);
+}
+
+void AggregationWorker::PrepareViews(AggregatedStatsCollection& pStats, DataSource pDataSource)
+{
+	pStats.GetCombatTime();
+
+	if (pDataSource == DataSource::Combined)
+	{
+		for (DataSource dataSource : {DataSource::Totals, DataSource::Agents, DataSource::Skills})
+		{
+			pStats.GetTotal(dataSource);
+			pStats.GetStats(dataSource);
+		}
+	}
+	else
+	{
+		pStats.GetTotal(pDataSource);
+		pStats.GetStats(pDataSource);
+	}
+}
+
+void AggregationWorker::UpdateSnapshot()
+{
+	// Read before taking the state, so that events processed while taking it make the next call take a new one
+	uint64_t dataVersion = mEventProcessor.GetDataVersion();
+	if (mSnapshot.Id != 0 && mSnapshot.DataVersion == dataVersion && mSnapshot.InCombat == false)
+	{
+		return;
+	}
+
+	auto [localId, states] = mEventProcessor.GetState();
+
+	mSnapshot.Id++;
+	mSnapshot.DataVersion = dataVersion;
+	mSnapshot.InCombat = false;
+	for (auto& [id, state] : states)
+	{
+		if (state.second.IsOutOfCombat() == false)
+		{
+			mSnapshot.InCombat = true;
+		}
+	}
+	mSnapshot.LocalId = localId;
+	mSnapshot.States = std::move(states);
+}
+
+void AggregationWorker::AggregatePastEncounter(uint32_t pWindowIndex, const WindowRequest& pRequest)
+{
+	std::shared_ptr<const EncounterHistory::Encounter> encounter = mEventProcessor.GetEncounterHistory().GetEncounter(pRequest.EncounterId);
+	if (encounter == nullptr)
+	{
+		LogD("Encounter {} of window {} is not in the history anymore", pRequest.EncounterId, pWindowIndex);
+		return;
+	}
+
+	if (mAggregatedEncounters[pWindowIndex].lock() == encounter &&
+		IsSameAggregation(mAggregatedRequests[pWindowIndex], pRequest) == true &&
+		mPublished[pWindowIndex].load(std::memory_order_relaxed) != nullptr)
+	{
+		return;
+	}
+
+	std::map<uintptr_t, std::pair<std::string, HealingStats>> states = encounter->States;
+	std::shared_ptr<AggregatedStatsCollection> stats = std::make_shared<AggregatedStatsCollection>(std::move(states), encounter->LocalId, pRequest.Options, pRequest.DebugMode, mThreadPool);
+	PrepareViews(*stats, pRequest.Options.DataSourceChoice);
+
+	mTotalsBases[pWindowIndex].clear();
+	mAggregatedRequests[pWindowIndex] = pRequest;
+	mAggregatedSnapshotIds[pWindowIndex] = 0;
+	mAggregatedEncounters[pWindowIndex] = encounter;
+
+	Publish(pWindowIndex, pRequest, std::move(stats));
+}
+
+void AggregationWorker::Publish(uint32_t pWindowIndex, const WindowRequest& pRequest, std::shared_ptr<AggregatedStatsCollection>&& pStats)
+{
+	// The window might have been hidden or changed while aggregating, don't publish stats it didn't ask for
+	std::lock_guard lock(mLock);
+	if (IsSameAggregation(mRequests[pWindowIndex], pRequest) == true)
+	{
+		mPublished[pWindowIndex].store(std::move(pStats), std::memory_order_release);
+	}
+}
+
+void AggregationWorker::ThreadMain()
+{
+	auto nextRefresh = std::chrono::steady_clock::now();
+	while (true)
+	{
+		std::array<WindowRequest, HEAL_WINDOW_COUNT> requests;
+		std::chrono::milliseconds refreshInterval;
+		{
+			std::unique_lock lock(mLock);
+			mWakeup.wait_until(lock, nextRefresh, [this]()
+				{
+					return mShutdown == true || mRequestsChanged == true;
+				});
+
+			if (mShutdown == true)
+			{
+				return;
+			}
+
+			requests = mRequests;
+			refreshInterval = mRefreshInterval;
+			mRequestsChanged = false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		nextRefresh = start + refreshInterval;
+
+		mEventProcessor.GetEncounterHistory().FreezePending();
+		mEventProcessor.UpdatePeerMemoryUsage();
+
+		bool snapshotUpdated = false;
+		for (uint32_t i = 0; i < HEAL_WINDOW_COUNT; i++)
+		{
+			if (requests[i].Shown == false)
+			{
+				mAggregatedRequests[i] = requests[i];
+				mTotalsBases[i].clear();
+				continue;
+			}
+
+			if (requests[i].EncounterId != 0)
+			{
+				AggregatePastEncounter(i, requests[i]);
+				continue;
+			}
+
+			if (snapshotUpdated == false)
+			{
+				UpdateSnapshot();
+				snapshotUpdated = true;
+			}
+
+			// Nothing changed since the published stats were built (and the window wasn't hidden since)
+			if (mAggregatedSnapshotIds[i] == mSnapshot.Id &&
+				IsSameAggregation(mAggregatedRequests[i], requests[i]) == true &&
+				mPublished[i].load(std::memory_order_relaxed) != nullptr)
+			{
+				continue;
+			}
+
+			std::map<uintptr_t, std::pair<std::string, HealingStats>> states = mSnapshot.States; // Copying a state only copies pointers to its event log
+			const std::map<uintptr_t, AggregatedStats::TotalsBase>* totalsBases = nullptr;
+			if (IsSameAggregation(mAggregatedRequests[i], requests[i]) == true)
+			{
+				totalsBases = &mTotalsBases[i];
+			}
+
+			std::shared_ptr<AggregatedStatsCollection> stats = std::make_shared<AggregatedStatsCollection>(std::move(states), mSnapshot.LocalId, requests[i].Options, requests[i].DebugMode, mThreadPool, totalsBases);
+			PrepareViews(*stats, requests[i].Options.DataSourceChoice);
+			mTotalsBases[i] = stats->GetTotalsBases();
+
+			mAggregatedRequests[i] = requests[i];
+			mAggregatedSnapshotIds[i] = mSnapshot.Id;
+
+			Publish(i, requests[i], std::move(stats));
+		}
+
+		LogT("Aggregated stats in {}us", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+}
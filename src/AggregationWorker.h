@@ -0,0 +1,109 @@
+#pragma once
+#include "AggregatedStatsCollection.h"
+#include "EncounterHistory.h"
+#include "EventProcessor.h"
+#include "State.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Aggregates the stats of every shown heal window on a background thread, so the render thread never has to. The
+// render thread tells the worker which windows are shown and with which options (SetWindow) and picks up the latest
+// published stats of a window every frame (GetStats).
+//
+// Every refresh all windows are aggregated from the same snapshot of the player states, which is only taken again if
+// the event processor processed events since the last one (or someone is in combat, since the combat time moves on
+// anyway). A window is only aggregated again if the snapshot or its options changed, and then only the events that were
+// appended since the previous snapshot are added to the totals it was built from.
+//
+// Windows showing a past encounter are only aggregated once (and again after the encounter was frozen), since the
+// encounter doesn't change anymore.
+//
+// Stats are rebuilt every refresh interval (SetRefreshInterval), and right away when the options of a window change. The
+// peer memory usage of the event processor is updated every refresh interval as well. Once a collection is published
+// the worker never touches it again - everything the window shows is computed before publishing, so the render thread
+// only reads cached results (details windows are still computed on first use, on the render thread).
+class AggregationWorker
+{
+public:
+	constexpr static std::chrono::milliseconds DEFAULT_REFRESH_INTERVAL{1000};
+
+	AggregationWorker(EventProcessor& pEventProcessor, ThreadPool* pThreadPool, std::chrono::milliseconds pRefreshInterval = DEFAULT_REFRESH_INTERVAL);
+	~AggregationWorker();
+
+	AggregationWorker(const AggregationWorker&) = delete;
+	AggregationWorker(AggregationWorker&&) = delete;
+	AggregationWorker& operator=(const AggregationWorker&) = delete;
+	AggregationWorker& operator=(AggregationWorker&&) = delete;
+
+	// Sets the options window pWindowIndex is aggregated with. If pOptions is nullptr the window is hidden and not
+	// aggregated anymore. pEncounterId selects a past encounter from the encounter history instead of the current one
+	// (0). Called every frame, only wakes the worker if something changed
+	void SetWindow(uint32_t pWindowIndex, const HealWindowOptions* pOptions, bool pDebugMode, uint64_t pEncounterId = 0);
+
+	// Takes effect after the current refresh
+	void SetRefreshInterval(std::chrono::milliseconds pRefreshInterval);
+
+	// Latest published stats of the window, nullptr if nothing was published for it yet. Hiding a window keeps its
+	// last published stats
+	std::shared_ptr<AggregatedStatsCollection> GetStats(uint32_t pWindowIndex) const;
+
+	// Stops the worker thread. GetStats keeps returning the last published stats
+	void Shutdown();
+
+private:
+	struct WindowRequest
+	{
+		bool Shown = false;
+		HealWindowOptions Options;
+		bool DebugMode = false;
+		uint64_t EncounterId = 0; // 0 for the current encounter
+	};
+
+	struct Snapshot
+	{
+		uint64_t Id = 0; // Incremented every time a new snapshot is taken, 0 if none was taken yet
+		uint64_t DataVersion = 0; // EventProcessor::GetDataVersion() from before the snapshot was taken
+		bool InCombat = false; // Some player is still in combat
+
+		uintptr_t LocalId = 0;
+		std::map<uintptr_t, std::pair<std::string, HealingStats>> States;
+	};
+
+	static bool IsSameAggregation(const WindowRequest& pLeft, const WindowRequest& pRight);
+	static void PrepareViews(AggregatedStatsCollection& pStats, DataSource pDataSource);
+
+	void UpdateSnapshot(); // Takes a new snapshot if the current one might be outdated
+	void AggregatePastEncounter(uint32_t pWindowIndex, const WindowRequest& pRequest);
+	void Publish(uint32_t pWindowIndex, const WindowRequest& pRequest, std::shared_ptr<AggregatedStatsCollection>&& pStats);
+	void ThreadMain();
+
+	EventProcessor& mEventProcessor;
+	ThreadPool* const mThreadPool;
+
+	std::mutex mLock;
+	std::condition_variable mWakeup;
+	std::chrono::milliseconds mRefreshInterval; // Protected by mLock
+	std::array<WindowRequest, HEAL_WINDOW_COUNT> mRequests; // Protected by mLock
+	bool mRequestsChanged = false; // Protected by mLock
+	bool mShutdown = false; // Protected by mLock
+
+	std::array<std::atomic<std::shared_ptr<AggregatedStatsCollection>>, HEAL_WINDOW_COUNT> mPublished;
+
+	// Only accessed by the worker thread
+	Snapshot mSnapshot;
+	std::array<WindowRequest, HEAL_WINDOW_COUNT> mAggregatedRequests; // Request that the published stats were built for
+	std::array<uint64_t, HEAL_WINDOW_COUNT> mAggregatedSnapshotIds = {}; // Snapshot that the published stats were built from
+	std::array<std::weak_ptr<const EncounterHistory::Encounter>, HEAL_WINDOW_COUNT> mAggregatedEncounters; // Past encounter that the published stats were built from
+	std::array<std::map<uintptr_t, AggregatedStats::TotalsBase>, HEAL_WINDOW_COUNT> mTotalsBases; // Totals of the last stats built for the window
+
+	std::thread mWorker;
+};
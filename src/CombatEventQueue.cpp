@@ -0,0 +1,211 @@
+#include "CombatEventQueue.h"
+
+#include "Log.h"
+
+#include <cassert>
+
+CombatEventQueue::CombatEventQueue(size_t pCapacity)
+	: mCapacity{pCapacity}
+	, mCells{std::make_unique<Cell[]>(pCapacity)}
+{
+	assert(mCapacity > 0 && (mCapacity & (mCapacity - 1)) == 0); // Has to be a power of 2
+
+	for (size_t i = 0; i < mCapacity; i++)
+	{
+		mCells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	mWorker = std::thread{&CombatEventQueue::ThreadMain, this};
+}
+
+CombatEventQueue::~CombatEventQueue()
+{
+	Shutdown();
+}
+
+void CombatEventQueue::Push(CombatEventHandler pHandler, cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision)
+{
+	assert(mShutdown.load(std::memory_order_relaxed) == false);
+
+	Entry entry;
+	entry.handler = pHandler;
+
+	entry.ev_present = (pEvent != nullptr);
+	if (pEvent != nullptr)
+	{
+		entry.ev = *pEvent;
+	}
+
+	entry.source_ag_present = (pSourceAgent != nullptr);
+	if (pSourceAgent != nullptr)
+	{
+		entry.source_ag = *pSourceAgent;
+		if (pSourceAgent->name != nullptr)
+		{
+			entry.source_ag.name = mAgentNames.Intern(pSourceAgent->name);
+		}
+	}
+
+	entry.destination_ag_present = (pDestinationAgent != nullptr);
+	if (pDestinationAgent != nullptr)
+	{
+		entry.destination_ag = *pDestinationAgent;
+		if (pDestinationAgent->name != nullptr)
+		{
+			entry.destination_ag.name = mAgentNames.Intern(pDestinationAgent->name);
+		}
+	}
+
+	entry.skillname = pSkillname;
+	entry.id = pId;
+	entry.revision = pRevision;
+
+	if (TryPush(entry) == false)
+	{
+		mFullQueueWaitCount.fetch_add(1, std::memory_order_relaxed);
+		LogD("Queue is full, waiting for worker (id {})", pId);
+
+		do
+		{
+			std::this_thread::yield();
+		} while (TryPush(entry) == false);
+	}
+
+	// Pairs with the store in ThreadMain
+	if (mWorkerSleeping.load(std::memory_order_seq_cst) == true)
+	{
+		mWakeupCounter.fetch_add(1, std::memory_order_seq_cst);
+		mWakeupCounter.notify_one();
+	}
+}
+
+void CombatEventQueue::Flush()
+{
+	const uint64_t target = mPushPosition.load(std::memory_order_seq_cst);
+	while (mProcessedEventCount.load(std::memory_order_acquire) < target)
+	{
+		mWakeupCounter.fetch_add(1, std::memory_order_seq_cst);
+		mWakeupCounter.notify_one();
+		std::this_thread::yield();
+	}
+}
+
+void CombatEventQueue::Shutdown()
+{
+	if (mShutdown.exchange(true, std::memory_order_seq_cst) == true)
+	{
+		return;
+	}
+
+	mWakeupCounter.fetch_add(1, std::memory_order_seq_cst);
+	mWakeupCounter.notify_one();
+	mWorker.join();
+
+	LogI("Shut down after processing {} events, {} full queue waits", mProcessedEventCount.load(std::memory_order_relaxed), mFullQueueWaitCount.load(std::memory_order_relaxed));
+}
+
+CombatEventQueue::Statistics CombatEventQueue::GetStatistics() const
+{
+	Statistics result;
+	result.PushedEvents = mPushPosition.load(std::memory_order_relaxed);
+	result.ProcessedEvents = mProcessedEventCount.load(std::memory_order_relaxed);
+	result.FullQueueWaits = mFullQueueWaitCount.load(std::memory_order_relaxed);
+	return result;
+}
+
+// Bounded MPMC queue from Dmitry Vyukov (only used with a single consumer here). Each cell's sequence tells whether it's
+// free for the producer claiming position pos (sequence == pos) or holds an event for the consumer (sequence == pos + 1)
+bool CombatEventQueue::TryPush(const Entry& pEntry)
+{
+	size_t position = mPushPosition.load(std::memory_order_relaxed);
+	while (true)
+	{
+		Cell& cell = mCells[position & (mCapacity - 1)];
+		size_t sequence = cell.sequence.load(std::memory_order_acquire);
+		intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+		if (difference == 0)
+		{
+			if (mPushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed) == true)
+			{
+				cell.entry = pEntry;
+				cell.sequence.store(position + 1, std::memory_order_seq_cst);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			return false; // Full
+		}
+		else
+		{
+			position = mPushPosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool CombatEventQueue::TryPop(Entry& pEntry)
+{
+	Cell& cell = mCells[mPopPosition & (mCapacity - 1)];
+	size_t sequence = cell.sequence.load(std::memory_order_seq_cst);
+	if (sequence != (mPopPosition + 1))
+	{
+		return false;
+	}
+
+	pEntry = cell.entry;
+	cell.sequence.store(mPopPosition + mCapacity, std::memory_order_release);
+	mPopPosition++;
+	return true;
+}
+
+void CombatEventQueue::HandleEntry(Entry& pEntry)
+{
+	pEntry.handler(
+		pEntry.ev_present == true ? &pEntry.ev : nullptr,
+		pEntry.source_ag_present == true ? &pEntry.source_ag : nullptr,
+		pEntry.destination_ag_present == true ? &pEntry.destination_ag : nullptr,
+		pEntry.skillname,
+		pEntry.id,
+		pEntry.revision);
+
+	mProcessedEventCount.fetch_add(1, std::memory_order_release);
+}
+
+bool CombatEventQueue::IsEmpty() const
+{
+	return mCells[mPopPosition & (mCapacity - 1)].sequence.load(std::memory_order_seq_cst) != (mPopPosition + 1);
+}
+
+void CombatEventQueue::ThreadMain()
+{
+	LogI("Started");
+
+	Entry entry;
+	while (true)
+	{
+		if (TryPop(entry) == true)
+		{
+			HandleEntry(entry);
+			continue;
+		}
+
+		// The queue is empty. Only stop once everything pushed before the shutdown has been handled
+		if (mShutdown.load(std::memory_order_seq_cst) == true)
+		{
+			break;
+		}
+
+		// Pairs with the load in Push - either the producer sees that we're going to sleep and wakes us up, or we see
+		// the new event here
+		uint32_t wakeupCounter = mWakeupCounter.load(std::memory_order_seq_cst);
+		mWorkerSleeping.store(true, std::memory_order_seq_cst);
+		if (IsEmpty() == true && mShutdown.load(std::memory_order_seq_cst) == false)
+		{
+			mWakeupCounter.wait(wakeupCounter, std::memory_order_seq_cst);
+		}
+		mWorkerSleeping.store(false, std::memory_order_relaxed);
+	}
+
+	LogI("Stopped");
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "arcdps_structs_slim.h"
+#include "EventSequencer.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Lets combat callbacks return to arcdps right away. The callback copies the event into a bounded lock-free MPSC ring
+// and a single worker thread calls the actual handler, in the order the events were pushed. Agent names are interned
+// so pushing doesn't allocate in steady state.
+class CombatEventQueue
+{
+public:
+	constexpr static size_t DEFAULT_CAPACITY = 16 * 1024;
+
+	struct Statistics
+	{
+		uint64_t PushedEvents = 0;
+		uint64_t ProcessedEvents = 0;
+		uint64_t FullQueueWaits = 0; // Times a callback had to wait for the worker to free up space
+	};
+
+	CombatEventQueue(size_t pCapacity = DEFAULT_CAPACITY);
+	~CombatEventQueue();
+
+	CombatEventQueue(const CombatEventQueue&) = delete;
+	CombatEventQueue(CombatEventQueue&&) = delete;
+	CombatEventQueue& operator=(const CombatEventQueue&) = delete;
+	CombatEventQueue& operator=(CombatEventQueue&&) = delete;
+
+	// pHandler is called on the worker thread with the same arguments (pointing to copies owned by the queue). If the
+	// queue is full, this waits for the worker to catch up rather than reordering or dropping the event.
+	void Push(CombatEventHandler pHandler, cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
+
+	// Blocks until every event pushed before the call has been handled
+	void Flush();
+
+	// Handles all remaining events and stops the worker thread. Nothing may be pushed after calling this
+	void Shutdown();
+
+	Statistics GetStatistics() const;
+
+private:
+	struct Entry
+	{
+		CombatEventHandler handler;
+
+		cbtevent ev;
+		ag source_ag;
+		ag destination_ag;
+		bool ev_present;
+		bool source_ag_present;
+		bool destination_ag_present;
+
+		const char* skillname; // Skill names are guaranteed to be valid for the lifetime of the process so copying pointer is fine
+		uint64_t id;
+		uint64_t revision;
+	};
+
+	struct Cell
+	{
+		std::atomic_size_t sequence;
+		Entry entry;
+	};
+
+	bool TryPush(const Entry& pEntry);
+	bool TryPop(Entry& pEntry);
+	bool IsEmpty() const;
+	void HandleEntry(Entry& pEntry);
+	void ThreadMain();
+
+	const size_t mCapacity;
+	std::unique_ptr<Cell[]> mCells;
+
+	alignas(64) std::atomic_size_t mPushPosition = 0;
+	alignas(64) size_t mPopPosition = 0; // Only accessed by the worker thread
+
+	alignas(64) std::atomic_bool mWorkerSleeping = false;
+	std::atomic_uint32_t mWakeupCounter = 0;
+	std::atomic_bool mShutdown = false;
+
+	std::atomic_uint64_t mProcessedEventCount = 0;
+	std::atomic_uint64_t mFullQueueWaitCount = 0;
+
+	AgentNameTable mAgentNames;
+	std::thread mWorker;
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <assert.h>
+#include <stdint.h>
+
+#include <bit>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Fibonacci hashing of integer keys. Other key types have to provide their own hash that returns a well mixed value
+struct DenseIndexHash
+{
+	template <typename Key>
+	uint64_t operator()(Key pKey) const
+	{
+		static_assert(std::is_integral_v<Key> == true, "DenseIndexHash only supports integer keys");
+		return static_cast<uint64_t>(pKey) * 0x9E3779B97F4A7C15ULL;
+	}
+};
+
+// Maps keys to small contiguous indices (0, 1, 2, ... in the order the keys were first inserted), so that values for
+// the keys can be kept in plain arrays instead of node based maps. Lookups go through a flat open addressing table with
+// linear probing, and the keys themselves are stored contiguously in index order.
+template <typename Key, typename Hash = DenseIndexHash>
+class DenseIndexMap
+{
+public:
+	// Returns the index of pKey and true if it was inserted by this call
+	std::pair<uint32_t, bool> Insert(const Key& pKey);
+	std::optional<uint32_t> Find(const Key& pKey) const;
+
+	size_t size() const;
+	void clear();
+
+	const std::vector<Key>& GetKeys() const; // Indexed by the index of the key
+	size_t GetMemoryUsage() const; // Bytes allocated for the keys and the lookup table
+
+private:
+	constexpr static uint32_t EMPTY_SLOT = UINT32_MAX;
+	constexpr static size_t MIN_SLOT_COUNT = 16;
+
+	size_t GetFirstSlot(const Key& pKey) const;
+	void Grow();
+
+	std::vector<Key> mKeys;
+	std::vector<uint32_t> mSlots; // Power of two sized, EMPTY_SLOT or an index into mKeys. Never more than half full
+	uint32_t mShift = 64; // 64 - log2(mSlots.size())
+};
+
+template <typename Key, typename Hash>
+inline std::pair<uint32_t, bool> DenseIndexMap<Key, Hash>::Insert(const Key& pKey)
+{
+	if ((mKeys.size() + 1) * 2 > mSlots.size())
+	{
+		Grow();
+	}
+
+	const size_t mask = mSlots.size() - 1;
+	for (size_t slot = GetFirstSlot(pKey); ; slot = (slot + 1) & mask)
+	{
+		if (mSlots[slot] == EMPTY_SLOT)
+		{
+			assert(mKeys.size() < EMPTY_SLOT);
+
+			uint32_t index = static_cast<uint32_t>(mKeys.size());
+			mSlots[slot] = index;
+			mKeys.emplace_back(pKey);
+			return {index, true};
+		}
+
+		if (mKeys[mSlots[slot]] == pKey)
+		{
+			return {mSlots[slot], false};
+		}
+	}
+}
+
+template <typename Key, typename Hash>
+inline std::optional<uint32_t> DenseIndexMap<Key, Hash>::Find(const Key& pKey) const
+{
+	if (mSlots.empty() == true)
+	{
+		return std::nullopt;
+	}
+
+	const size_t mask = mSlots.size() - 1;
+	for (size_t slot = GetFirstSlot(pKey); ; slot = (slot + 1) & mask)
+	{
+		if (mSlots[slot] == EMPTY_SLOT)
+		{
+			return std::nullopt;
+		}
+
+		if (mKeys[mSlots[slot]] == pKey)
+		{
+			return mSlots[slot];
+		}
+	}
+}
+
+template <typename Key, typename Hash>
+inline size_t DenseIndexMap<Key, Hash>::size() const
+{
+	return mKeys.size();
+}
+
+template <typename Key, typename Hash>
+inline void DenseIndexMap<Key, Hash>::clear()
+{
+	mKeys.clear();
+	mSlots.clear();
+	mShift = 64;
+}
+
+template <typename Key, typename Hash>
+inline const std::vector<Key>& DenseIndexMap<Key, Hash>::GetKeys() const
+{
+	return mKeys;
+}
+
+template <typename Key, typename Hash>
+inline size_t DenseIndexMap<Key, Hash>::GetMemoryUsage() const
+{
+	return mKeys.capacity() * sizeof(Key) + mSlots.capacity() * sizeof(uint32_t);
+}
+
+template <typename Key, typename Hash>
+inline size_t DenseIndexMap<Key, Hash>::GetFirstSlot(const Key& pKey) const
+{
+	// High bits of the hash are the best mixed ones
+	return static_cast<size_t>(Hash{}(pKey) >> mShift);
+}
+
+template <typename Key, typename Hash>
+inline void DenseIndexMap<Key, Hash>::Grow()
+{
+	size_t slotCount = (mSlots.empty() == true) ? MIN_SLOT_COUNT : mSlots.size() * 2;
+	mSlots.assign(slotCount, EMPTY_SLOT);
+	mShift = 64 - static_cast<uint32_t>(std::countr_zero(slotCount));
+
+	const size_t mask = slotCount - 1;
+	for (uint32_t index = 0; index < mKeys.size(); index++)
+	{
+		size_t slot = GetFirstSlot(mKeys[index]);
+		while (mSlots[slot] != EMPTY_SLOT)
+		{
+			slot = (slot + 1) & mask;
+		}
+		mSlots[slot] = index;
+	}
+}
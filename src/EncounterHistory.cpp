@@ -0,0 +1,200 @@
+#include "EncounterHistory.h"
+
+#include "AggregatedStats.h"
+#include "Log.h"
+
+#include <assert.h>
+
+#include <set>
+
+void EncounterHistory::SetLimits(size_t pMaxEncounters, size_t pMemoryBudget, bool pKeepEvents)
+{
+	std::lock_guard lock(mLock);
+	mMaxEncounters = pMaxEncounters;
+	mMemoryBudget = pMemoryBudget;
+	mKeepEvents = pKeepEvents;
+
+	Evict();
+}
+
+void EncounterHistory::Add(uintptr_t pLocalId, std::map<uintptr_t, std::pair<std::string, HealingStats>>&& pStates)
+{
+	std::shared_ptr<Encounter> encounter = std::make_shared<Encounter>();
+	encounter->LocalId = pLocalId;
+	encounter->States = std::move(pStates);
+
+	auto localState = encounter->States.find(pLocalId);
+	if (localState != encounter->States.end())
+	{
+		encounter->EnteredCombatTime = localState->second.second.EnteredCombatTime;
+		encounter->ExitedCombatTime = localState->second.second.ExitedCombatTime;
+		encounter->EndTime = (encounter->ExitedCombatTime != 0) ? encounter->ExitedCombatTime : localState->second.second.CollectionTime;
+	}
+	encounter->MemoryUsage = GetMemoryUsage(*encounter);
+
+	std::lock_guard lock(mLock);
+	if (mMaxEncounters == 0)
+	{
+		return;
+	}
+
+	encounter->Id = mNextId++;
+	LogD("Adding encounter {} ({} states, {} bytes) to the history", encounter->Id, encounter->States.size(), encounter->MemoryUsage);
+
+	mMemoryUsage += encounter->MemoryUsage;
+	mEncounters.emplace_back(std::move(encounter));
+	Evict();
+}
+
+void EncounterHistory::FreezePending()
+{
+	while (true)
+	{
+		std::shared_ptr<const Encounter> pending;
+		bool keepEvents;
+		{
+			std::lock_guard lock(mLock);
+			for (const auto& encounter : mEncounters)
+			{
+				if (encounter->IsFrozen == false)
+				{
+					pending = encounter;
+					break;
+				}
+			}
+			keepEvents = mKeepEvents;
+		}
+
+		if (pending == nullptr)
+		{
+			return;
+		}
+
+		// Freeze outside of the lock, readers keep getting the unfrozen encounter until it is replaced
+		std::shared_ptr<Encounter> frozen = std::make_shared<Encounter>();
+		frozen->Id = pending->Id;
+		frozen->EnteredCombatTime = pending->EnteredCombatTime;
+		frozen->ExitedCombatTime = pending->ExitedCombatTime;
+		frozen->EndTime = pending->EndTime;
+		frozen->IsFrozen = true;
+		frozen->LocalId = pending->LocalId;
+		for (const auto& [id, state] : pending->States)
+		{
+			frozen->States.try_emplace(id, state.first, Freeze(state.second, keepEvents));
+		}
+		frozen->MemoryUsage = GetMemoryUsage(*frozen);
+
+		std::lock_guard lock(mLock);
+		for (auto& encounter : mEncounters)
+		{
+			if (encounter == pending)
+			{
+				LogD("Froze encounter {}, {} bytes -> {} bytes", frozen->Id, pending->MemoryUsage, frozen->MemoryUsage);
+
+				mMemoryUsage = mMemoryUsage - pending->MemoryUsage + frozen->MemoryUsage;
+				encounter = std::move(frozen);
+				break;
+			}
+		}
+		Evict();
+	}
+}
+
+std::vector<std::shared_ptr<const EncounterHistory::Encounter>> EncounterHistory::GetEncounters()
+{
+	std::lock_guard lock(mLock);
+	return {mEncounters.begin(), mEncounters.end()};
+}
+
+std::shared_ptr<const EncounterHistory::Encounter> EncounterHistory::GetEncounter(uint64_t pId)
+{
+	std::lock_guard lock(mLock);
+	for (const auto& encounter : mEncounters)
+	{
+		if (encounter->Id == pId)
+		{
+			return encounter;
+		}
+	}
+	return nullptr;
+}
+
+size_t EncounterHistory::GetMemoryUsage()
+{
+	std::lock_guard lock(mLock);
+	return mMemoryUsage;
+}
+
+HealingStats EncounterHistory::Freeze(const HealingStats& pStats, bool pKeepEvents)
+{
+	std::shared_ptr<FrozenTotals> frozenTotals = std::make_shared<FrozenTotals>();
+	if (pStats.Frozen != nullptr)
+	{
+		*frozenTotals = *pStats.Frozen;
+	}
+	if (pStats.Events.empty() == false)
+	{
+		frozenTotals->LastEventTime = pStats.Events.back().Time;
+	}
+
+	// Let AggregatedStats decide what the combat end is for every condition, so the frozen totals are guaranteed to be
+	// looked up with the same combat end later
+	for (uint32_t i = 0; i < static_cast<uint32_t>(CombatEndCondition::Max); i++)
+	{
+		HealWindowOptions options;
+		options.CombatEndConditionChoice = static_cast<CombatEndCondition>(i);
+
+		AggregatedStats stats{HealingStats{pStats}, options, false};
+		AggregatedStats::TotalsBase base = stats.GetTotalsBase();
+		frozenTotals->Until.try_emplace(base.CombatEnd, std::move(base.Totals));
+	}
+
+	HealingStats result = pStats;
+	result.Frozen = std::move(frozenTotals);
+	result.Totals.clear();
+	if (pKeepEvents == false)
+	{
+		result.Events.clear();
+	}
+
+	return result;
+}
+
+size_t EncounterHistory::GetMemoryUsage(const Encounter& pEncounter)
+{
+	size_t result = sizeof(Encounter);
+
+	// Frozen tables are shared between combat ends that are the same
+	std::set<const HealEventTotals::Table*> tables;
+	for (const auto& [id, state] : pEncounter.States)
+	{
+		const HealingStats& stats = state.second;
+		result += sizeof(state) + state.first.capacity() + stats.Events.GetMemoryUsage() + stats.Totals.GetMemoryUsage() + stats.Rolling.GetMemoryUsage();
+
+		if (stats.Frozen != nullptr)
+		{
+			result += sizeof(FrozenTotals);
+			for (const auto& [end, totals] : stats.Frozen->Until)
+			{
+				if (totals != nullptr && tables.insert(totals.get()).second == true)
+				{
+					result += totals->GetMemoryUsage();
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+void EncounterHistory::Evict()
+{
+	while (mEncounters.size() > mMaxEncounters || (mMemoryUsage > mMemoryBudget && mEncounters.size() > 1))
+	{
+		LogD("Evicting encounter {} from the history ({} encounters, {} bytes)", mEncounters.front()->Id, mEncounters.size(), mMemoryUsage);
+
+		assert(mMemoryUsage >= mEncounters.front()->MemoryUsage);
+		mMemoryUsage -= mEncounters.front()->MemoryUsage;
+		mEncounters.pop_front();
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "EventProcessor.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Ring of the last few encounters, so they can still be looked at after the next pull cleared the player states.
+//
+// Adding an encounter only stores the snapshot of the player states (cheap, it only shares their event logs), it is
+// frozen later by FreezePending (on the aggregation worker thread). Freezing aggregates the totals per <agent, skill>
+// up to every possible combat end once (see FrozenTotals), so aggregating a past encounter never has to look at its
+// events again. The raw events are dropped while freezing unless they are configured to be kept.
+//
+// The oldest encounters are evicted once there are more than the configured maximum, or the encounters use more memory
+// than the configured budget (the newest encounter is always kept, even if it alone is over the budget). Memory usage
+// is only an estimate, and storage shared with the live player states (the event logs and running totals of an
+// encounter that wasn't frozen yet) is counted as if it was owned by the encounter.
+class EncounterHistory
+{
+public:
+	constexpr static size_t DEFAULT_MAX_ENCOUNTERS = 5;
+	constexpr static size_t DEFAULT_MEMORY_BUDGET = 64 * 1024 * 1024;
+
+	struct Encounter
+	{
+		uint64_t Id = 0; // Never reused, starts at 1
+		uint64_t EnteredCombatTime = 0; // Of the local player
+		uint64_t ExitedCombatTime = 0; // Of the local player
+		// ExitedCombatTime, or the collection time of the local player if the encounter ended in combat (which happens
+		// for the last encounter recovered from a journal)
+		uint64_t EndTime = 0;
+		bool IsFrozen = false;
+		size_t MemoryUsage = 0; // Estimated bytes used by the encounter
+
+		uintptr_t LocalId = 0;
+		std::map<uintptr_t, std::pair<std::string, HealingStats>> States; // Same layout as EventProcessor::GetState
+	};
+
+	// pMaxEncounters 0 disables the history. pKeepEvents only affects encounters that are frozen after the call
+	void SetLimits(size_t pMaxEncounters, size_t pMemoryBudget, bool pKeepEvents);
+
+	// Adds a finished encounter (the result of EventProcessor::GetState) and evicts the oldest ones if needed
+	void Add(uintptr_t pLocalId, std::map<uintptr_t, std::pair<std::string, HealingStats>>&& pStates);
+
+	// Freezes every encounter that was added since the last call
+	void FreezePending();
+
+	// Encounters ordered from oldest to newest. Encounters are never modified after being returned, freezing replaces
+	// them with a new object with the same id
+	std::vector<std::shared_ptr<const Encounter>> GetEncounters();
+	// nullptr if there is no encounter with that id (anymore)
+	std::shared_ptr<const Encounter> GetEncounter(uint64_t pId);
+
+	size_t GetMemoryUsage();
+
+	// Returns a copy of pStats that aggregates the same as pStats for every combat end condition without needing Events
+	// or Totals. Events are kept if pKeepEvents is true
+	static HealingStats Freeze(const HealingStats& pStats, bool pKeepEvents);
+
+private:
+	static size_t GetMemoryUsage(const Encounter& pEncounter);
+
+	void Evict(); // Needs mLock
+
+	std::mutex mLock;
+	std::deque<std::shared_ptr<const Encounter>> mEncounters; // Oldest first
+	size_t mMemoryUsage = 0; // Sum of the MemoryUsage of every encounter in mEncounters
+
+	uint64_t mNextId = 1;
+	size_t mMaxEncounters = DEFAULT_MAX_ENCOUNTERS;
+	size_t mMemoryBudget = DEFAULT_MEMORY_BUDGET;
+	bool mKeepEvents = false;
+};
@@ -0,0 +1,482 @@
+#include "EncounterJournal.h"
+
+#include "Log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+
+namespace
+{
+// Player state while replaying a journal. The first pass only tracks the combat state, events are added in the second
+// pass and only for the encounters that are kept
+struct ReplayPlayer
+{
+	HealingStatsSlim Stats;
+	size_t FirstEvent = 0; // Heal records of the player from this record index on belong to its current state
+};
+
+struct ReplayState
+{
+	uint64_t LastTime = 0; // Highest time of any record so far, stands in for the collection time
+	uintptr_t SelfId = 0;
+	AgentSnapshot Agents;
+	std::map<uint64_t, ReplayPlayer> Players; // <journal player id, state>
+};
+
+// Player pPlayerId, a player that doesn't exist yet starts with the record at pIndex
+ReplayPlayer& GetPlayer(ReplayState& pState, uint64_t pPlayerId, size_t pIndex)
+{
+	return pState.Players.try_emplace(pPlayerId, ReplayPlayer{HealingStatsSlim{}, pIndex}).first->second;
+}
+
+// State at the end of an encounter of the local player
+struct ReplayEncounter
+{
+	ReplayState State;
+	size_t End = 0; // Index of the first record after the encounter
+};
+
+void AddEncounter(ReplayState&& pState, std::vector<EncounterJournal::Encounter>& pEncounters)
+{
+	EncounterJournal::Encounter& encounter = pEncounters.emplace_back();
+	encounter.LocalId = pState.SelfId;
+	encounter.CollectionTime = pState.LastTime;
+	encounter.Agents = std::make_shared<const AgentSnapshot>(std::move(pState.Agents));
+	for (auto& [playerId, player] : pState.Players)
+	{
+		const bool isLocal = (playerId == EncounterJournal::LOCAL_PLAYER_ID);
+		const uintptr_t uniqueId = (isLocal == true) ? pState.SelfId : playerId;
+
+		auto [entry, inserted] = encounter.States.try_emplace(uniqueId);
+		if (inserted == false)
+		{
+			continue; // The local player was also journaled as a peer
+		}
+
+		entry->second.second = std::move(player.Stats);
+
+		auto agent = encounter.Agents->find(uniqueId);
+		if (agent != encounter.Agents->end())
+		{
+			entry->second.first = agent->second.Name;
+		}
+		else
+		{
+			entry->second.first = (isLocal == true) ? "local (unmapped)" : "peer (unmapped)";
+		}
+	}
+}
+} // anonymous namespace
+
+EncounterJournal::EncounterJournal(const char* pPath, size_t pMaxSize)
+	: mMaxSize{pMaxSize}
+{
+	if (mFile.Create(pPath, GROW_SIZE) == false)
+	{
+		LogW("Failed to create encounter journal {}, nothing will be journaled", pPath);
+		return;
+	}
+
+	Header* header = reinterpret_cast<Header*>(mFile.data());
+	memcpy(header->Magic, MAGIC, sizeof(MAGIC));
+	header->Version = VERSION;
+	header->RecordSize = sizeof(JournalRecord);
+
+	LogI("Created encounter journal {}", pPath);
+}
+
+EncounterJournal::~EncounterJournal()
+{
+	std::unique_lock lock(mLock);
+	if (mFile.IsOpen() == true)
+	{
+		mFile.Resize(HEADER_SIZE + (std::min)(mRecordCount.load(), GetCapacity()) * sizeof(JournalRecord));
+	}
+}
+
+bool EncounterJournal::IsOpen()
+{
+	std::shared_lock lock(mLock);
+	return mFile.IsOpen();
+}
+
+size_t EncounterJournal::GetRecordCount()
+{
+	std::shared_lock lock(mLock);
+	return (std::min)(mRecordCount.load(), GetCapacity());
+}
+
+void EncounterJournal::Self(uintptr_t pSelfId)
+{
+	Append(1, [pSelfId](JournalRecord& pRecord, size_t /*pIndex*/)
+		{
+			pRecord.Type = JournalRecordType::Self;
+			pRecord.Id = pSelfId;
+		});
+}
+
+void EncounterJournal::Agent(uintptr_t pAgentId, const HealedAgent& pAgent)
+{
+	// The name parts have to follow the agent record directly, so everything is claimed at once
+	const size_t nameParts = (pAgent.Name.size() + JournalRecord::NAME_PART_SIZE - 1) / JournalRecord::NAME_PART_SIZE;
+	Append(1 + nameParts, [pAgentId, &pAgent](JournalRecord& pRecord, size_t pIndex)
+		{
+			pRecord.Id = pAgentId;
+			if (pIndex == 0)
+			{
+				pRecord.Type = JournalRecordType::Agent;
+				pRecord.Flags = (pAgent.IsMinion == true ? JournalRecordFlags_IsMinion : 0) | (pAgent.IsPlayer == true ? JournalRecordFlags_IsPlayer : 0);
+				pRecord.SubGroup = pAgent.Subgroup;
+				pRecord.Agent.InstanceId = pAgent.InstanceId;
+				return;
+			}
+
+			const size_t offset = (pIndex - 1) * JournalRecord::NAME_PART_SIZE;
+			pRecord.Type = JournalRecordType::AgentName;
+			memcpy(pRecord.NamePart, pAgent.Name.data() + offset, (std::min)(JournalRecord::NAME_PART_SIZE, pAgent.Name.size() - offset));
+		});
+}
+
+void EncounterJournal::EnteredCombat(uint64_t pPlayerId, uint64_t pTime, uint16_t pSubGroup)
+{
+	Append(1, [pPlayerId, pTime, pSubGroup](JournalRecord& pRecord, size_t /*pIndex*/)
+		{
+			pRecord.Type = JournalRecordType::EnteredCombat;
+			pRecord.Id = pPlayerId;
+			pRecord.SubGroup = pSubGroup;
+			pRecord.Combat.Time = pTime;
+		});
+}
+
+void EncounterJournal::ExitedCombat(uint64_t pPlayerId, uint64_t pTime, uint64_t pLastDamageEvent)
+{
+	Append(1, [pPlayerId, pTime, pLastDamageEvent](JournalRecord& pRecord, size_t /*pIndex*/)
+		{
+			pRecord.Type = JournalRecordType::ExitedCombat;
+			pRecord.Id = pPlayerId;
+			pRecord.Combat.Time = pTime;
+			pRecord.Combat.LastDamageEvent = pLastDamageEvent;
+		});
+
+	// Only matters if the operating system goes down, a finished encounter of the local player is a good point to make
+	// sure it's on disk. Peers exit combat all the time and their encounters are only kept as part of the local one.
+	// The shared lock only keeps the mapping from moving, writers carry on while the flush is started
+	if (pPlayerId == LOCAL_PLAYER_ID)
+	{
+		std::shared_lock lock(mLock);
+		mFile.Flush();
+	}
+}
+
+void EncounterJournal::Reset(uint64_t pPlayerId)
+{
+	Append(1, [pPlayerId](JournalRecord& pRecord, size_t /*pIndex*/)
+		{
+			pRecord.Type = JournalRecordType::Reset;
+			pRecord.Id = pPlayerId;
+		});
+}
+
+void EncounterJournal::Heals(uint64_t pPlayerId, HealEventLog::const_iterator pBegin, HealEventLog::const_iterator pEnd)
+{
+	HealEventLog::const_iterator event = pBegin;
+	Append(static_cast<size_t>(pEnd - pBegin), [pPlayerId, &event](JournalRecord& pRecord, size_t /*pIndex*/)
+		{
+			pRecord.Type = JournalRecordType::Heal;
+			pRecord.Flags = (event->IsBarrier == true) ? JournalRecordFlags_IsBarrier : 0;
+			pRecord.Id = pPlayerId;
+			pRecord.Heal.Time = event->Time;
+			pRecord.Heal.AgentId = event->AgentId;
+			pRecord.Heal.SkillId = event->SkillId;
+			pRecord.Heal.Size = static_cast<uint32_t>(event->Size);
+			++event;
+		});
+}
+
+template <typename Function>
+size_t EncounterJournal::ForEachRecord(FILE* pFile, size_t pFirst, size_t pEnd, Function&& pFunction)
+{
+	if (fseek(pFile, static_cast<long>(HEADER_SIZE + pFirst * sizeof(JournalRecord)), SEEK_SET) != 0)
+	{
+		return pFirst;
+	}
+
+	std::vector<JournalRecord> records(4096);
+	size_t index = pFirst;
+	while (index < pEnd)
+	{
+		const size_t readCount = fread(records.data(), sizeof(JournalRecord), (std::min)(records.size(), pEnd - index), pFile);
+		for (size_t i = 0; i < readCount; i++)
+		{
+			const JournalRecord& record = records[i];
+			if (record.Type == JournalRecordType::None || record.Checksum != GetChecksum(record))
+			{
+				return index; // End of the journal, or the record the process died in the middle of writing
+			}
+
+			pFunction(record, index);
+			index++;
+		}
+
+		if (readCount == 0)
+		{
+			break;
+		}
+	}
+
+	return index;
+}
+
+std::vector<EncounterJournal::Encounter> EncounterJournal::Read(const char* pPath, size_t pMaxEncounters)
+{
+	std::vector<Encounter> result;
+	if (pMaxEncounters == 0)
+	{
+		return result;
+	}
+
+	FILE* file = fopen(pPath, "rb");
+	if (file == nullptr)
+	{
+		LogD("No encounter journal at {}", pPath);
+		return result;
+	}
+
+	Header header;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		memcmp(header.Magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.Version != VERSION ||
+		header.RecordSize != sizeof(JournalRecord))
+	{
+		LogW("{} is not a supported encounter journal", pPath);
+		fclose(file);
+		return result;
+	}
+
+	// First pass, replays everything but the heal events and keeps the state at the end of the last pMaxEncounters
+	// encounters
+	std::deque<ReplayEncounter> encounters;
+	auto addEncounter = [&encounters, pMaxEncounters](const ReplayState& pState, size_t pEnd)
+	{
+		if (encounters.size() == pMaxEncounters)
+		{
+			encounters.pop_front();
+		}
+		encounters.emplace_back(ReplayEncounter{pState, pEnd});
+	};
+
+	ReplayState state;
+	uint64_t currentAgentId = 0; // Agent that AgentName records are appended to
+	const size_t recordCount = ForEachRecord(file, 0, SIZE_MAX, [&state, &currentAgentId, &addEncounter](const JournalRecord& pRecord, size_t pIndex)
+		{
+			switch (pRecord.Type)
+			{
+			case JournalRecordType::Self:
+				state.SelfId = pRecord.Id;
+				break;
+			case JournalRecordType::Agent:
+			{
+				HealedAgent agent{pRecord.Agent.InstanceId, "", pRecord.SubGroup, (pRecord.Flags & JournalRecordFlags_IsMinion) != 0, (pRecord.Flags & JournalRecordFlags_IsPlayer) != 0};
+				state.Agents.insert_or_assign(pRecord.Id, std::move(agent));
+				currentAgentId = pRecord.Id;
+				break;
+			}
+			case JournalRecordType::AgentName:
+			{
+				auto agent = state.Agents.find(pRecord.Id);
+				if (agent != state.Agents.end() && pRecord.Id == currentAgentId)
+				{
+					agent->second.Name.append(pRecord.NamePart, strnlen(pRecord.NamePart, JournalRecord::NAME_PART_SIZE));
+				}
+				break;
+			}
+			case JournalRecordType::EnteredCombat:
+			{
+				state.LastTime = (std::max)(state.LastTime, pRecord.Combat.Time);
+
+				ReplayPlayer& player = GetPlayer(state, pRecord.Id, pIndex);
+				if (player.Stats.IsOutOfCombat() == false)
+				{
+					break;
+				}
+
+				// Same as EventProcessor, the finished encounter is kept before entering combat clears it
+				if (pRecord.Id == LOCAL_PLAYER_ID && player.Stats.EnteredCombatTime != 0)
+				{
+					addEncounter(state, pIndex);
+				}
+
+				player.Stats.EnteredCombatTime = pRecord.Combat.Time;
+				player.Stats.ExitedCombatTime = 0;
+				player.Stats.LastDamageEvent = 0;
+				player.Stats.SubGroup = pRecord.SubGroup;
+				player.FirstEvent = pIndex + 1;
+				break;
+			}
+			case JournalRecordType::ExitedCombat:
+			{
+				state.LastTime = (std::max)(state.LastTime, pRecord.Combat.Time);
+
+				HealingStatsSlim& stats = GetPlayer(state, pRecord.Id, pIndex).Stats;
+				stats.ExitedCombatTime = pRecord.Combat.Time;
+				stats.LastDamageEvent = (std::max)(stats.LastDamageEvent, pRecord.Combat.LastDamageEvent);
+				break;
+			}
+			case JournalRecordType::Reset:
+				state.Players.erase(pRecord.Id);
+				break;
+			case JournalRecordType::Heal:
+				state.LastTime = (std::max)(state.LastTime, pRecord.Heal.Time);
+				GetPlayer(state, pRecord.Id, pIndex);
+				break;
+			default:
+				LogW("Unknown record type {} in encounter journal, ignoring it", static_cast<uint32_t>(pRecord.Type));
+				break;
+			}
+		});
+
+	auto local = state.Players.find(LOCAL_PLAYER_ID);
+	if (local != state.Players.end() && local->second.Stats.EnteredCombatTime != 0)
+	{
+		addEncounter(state, recordCount);
+	}
+
+	// Second pass, adds the heal events of the kept encounters. A heal event can be part of several encounters, peers
+	// stay in combat across encounters of the local player
+	if (encounters.empty() == false)
+	{
+		size_t first = SIZE_MAX;
+		for (const ReplayEncounter& encounter : encounters)
+		{
+			for (const auto& [playerId, player] : encounter.State.Players)
+			{
+				first = (std::min)(first, player.FirstEvent);
+			}
+		}
+
+		ForEachRecord(file, first, encounters.back().End, [&encounters](const JournalRecord& pRecord, size_t pIndex)
+			{
+				if (pRecord.Type != JournalRecordType::Heal)
+				{
+					return;
+				}
+
+				for (ReplayEncounter& encounter : encounters)
+				{
+					if (pIndex >= encounter.End)
+					{
+						continue;
+					}
+
+					auto player = encounter.State.Players.find(pRecord.Id);
+					if (player != encounter.State.Players.end() && pIndex >= player->second.FirstEvent)
+					{
+						player->second.Stats.AddEvent(pRecord.Heal.Time, pRecord.Heal.Size, pRecord.Heal.AgentId, pRecord.Heal.SkillId, (pRecord.Flags & JournalRecordFlags_IsBarrier) != 0);
+					}
+				}
+			});
+	}
+	fclose(file);
+
+	for (ReplayEncounter& encounter : encounters)
+	{
+		AddEncounter(std::move(encounter.State), result);
+	}
+
+	LogI("Read {} records and kept the last {} encounters from encounter journal {}", recordCount, result.size(), pPath);
+	return result;
+}
+
+uint32_t EncounterJournal::GetChecksum(const JournalRecord& pRecord)
+{
+	// FNV-1a over 8 byte words instead of single bytes, a record is hashed on every write
+	uint64_t words[(sizeof(JournalRecord) - sizeof(uint32_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t)] = {};
+	memcpy(words, reinterpret_cast<const uint8_t*>(&pRecord) + sizeof(uint32_t), sizeof(JournalRecord) - sizeof(uint32_t));
+
+	uint64_t hash = 14695981039346656037ULL;
+	for (uint64_t word : words)
+	{
+		hash = (hash ^ word) * 1099511628211ULL;
+	}
+
+	// 0 would match a record that was claimed but never written
+	uint32_t result = static_cast<uint32_t>(hash ^ (hash >> 32));
+	return (result != 0) ? result : 1;
+}
+
+template <typename Function>
+void EncounterJournal::Append(size_t pCount, Function&& pFunction)
+{
+	if (pCount == 0 || mIsFull.load(std::memory_order_relaxed) == true)
+	{
+		return;
+	}
+
+	const size_t first = mRecordCount.fetch_add(pCount, std::memory_order_relaxed);
+	const size_t end = first + pCount;
+
+	std::shared_lock lock(mLock);
+	while (GetCapacity() < end && mIsFull.load(std::memory_order_relaxed) == false)
+	{
+		lock.unlock();
+		{
+			std::unique_lock growLock(mLock);
+			Grow(end);
+		}
+		lock.lock();
+	}
+
+	const size_t writeEnd = (std::min)(end, GetCapacity());
+	if (writeEnd <= first)
+	{
+		return;
+	}
+
+	// The file is zero past the last record, so the records don't need to be cleared
+	JournalRecord* records = reinterpret_cast<JournalRecord*>(mFile.data() + HEADER_SIZE);
+	for (size_t i = first; i < writeEnd; i++)
+	{
+		pFunction(records[i], i - first);
+		Commit(records[i]);
+	}
+}
+
+void EncounterJournal::Grow(size_t pRecordCount)
+{
+	while (GetCapacity() < pRecordCount && mIsFull.load(std::memory_order_relaxed) == false)
+	{
+		if (mFile.IsOpen() == false)
+		{
+			mIsFull.store(true, std::memory_order_relaxed);
+			return;
+		}
+
+		const size_t newSize = mFile.size() + GROW_SIZE;
+		if (newSize > mMaxSize)
+		{
+			LogW("Encounter journal reached its maximum size ({} records), nothing more is journaled", GetCapacity());
+			mIsFull.store(true, std::memory_order_relaxed);
+			return;
+		}
+
+		if (mFile.Resize(newSize) == false)
+		{
+			LogW("Growing the encounter journal failed, nothing more is journaled");
+			mIsFull.store(true, std::memory_order_relaxed);
+			return;
+		}
+	}
+}
+
+size_t EncounterJournal::GetCapacity() const
+{
+	return (mFile.size() > HEADER_SIZE) ? (mFile.size() - HEADER_SIZE) / sizeof(JournalRecord) : 0;
+}
+
+void EncounterJournal::Commit(JournalRecord& pRecord)
+{
+	pRecord.Checksum = GetChecksum(pRecord);
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "AgentTable.h"
+#include "HealEventLog.h"
+#include "MappedFile.h"
+#include "PlayerStats.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+enum class JournalRecordType : uint8_t
+{
+	None = 0, // Never written, the file is zero past the last record
+	Self = 1,
+	Agent = 2,
+	AgentName = 3, // Follows Agent, one record per NAME_PART_SIZE bytes of the name
+	EnteredCombat = 4,
+	ExitedCombat = 5,
+	Reset = 6,
+	Heal = 7
+};
+
+enum JournalRecordFlags : uint8_t
+{
+	JournalRecordFlags_IsBarrier = 1 << 0, // Heal
+	JournalRecordFlags_IsMinion = 1 << 1, // Agent
+	JournalRecordFlags_IsPlayer = 1 << 2 // Agent
+};
+
+struct JournalHeal
+{
+	uint64_t Time;
+	uint64_t AgentId;
+	uint32_t SkillId;
+	uint32_t Size;
+};
+
+struct JournalCombat
+{
+	uint64_t Time;
+	uint64_t LastDamageEvent; // ExitedCombat
+};
+
+struct JournalAgent
+{
+	uint16_t InstanceId;
+};
+
+struct JournalRecord
+{
+	constexpr static size_t NAME_PART_SIZE = 24;
+
+	uint32_t Checksum; // Of the rest of the record. Written last, a record with the wrong checksum ends the journal
+	JournalRecordType Type;
+	uint8_t Flags; // JournalRecordFlags
+	uint16_t SubGroup; // EnteredCombat and Agent
+	// Player that the record is about (EncounterJournal::LOCAL_PLAYER_ID for the local player), the agent for Agent and
+	// AgentName records
+	uint64_t Id;
+
+	union
+	{
+		JournalHeal Heal;
+		JournalCombat Combat;
+		JournalAgent Agent;
+		char NamePart[NAME_PART_SIZE]; // Not null terminated if the part is full
+	};
+};
+static_assert(sizeof(JournalRecord) == 40);
+
+// Append-only journal of everything that changes the player states, kept in a memory mapped file so that the stats of
+// the session can be rebuilt after the game crashed or the addon was unloaded (see Read). Heal events are written
+// straight from PlayerStats into the mapping - there is no buffering in between, so there is nothing to lose when the
+// process goes down.
+//
+// Writers claim their records with an atomic counter and fill them in while holding mLock shared, so the local player
+// and the peers don't wait on each other. Only growing the file (which moves the mapping) takes mLock exclusively.
+// Records of different writers can be interleaved, but the records of one call (a batch of heal events, an agent and
+// its name) are always consecutive.
+//
+// Every record ends with its checksum being written, and the file past the last record is zero, so a record that was
+// only partially written when the process died (or anything after it) is never read back.
+//
+// Damage events are not journaled one by one, only the resulting last damage event time when combat is exited.
+class EncounterJournal
+{
+public:
+	constexpr static uint64_t LOCAL_PLAYER_ID = 0;
+	constexpr static size_t GROW_SIZE = 1024 * 1024; // bytes
+	constexpr static size_t DEFAULT_MAX_SIZE = 256 * 1024 * 1024; // bytes
+
+	// Replayed journal, one entry per encounter of the local player (ending with the one that was still going on when
+	// the journal stopped). EventProcessor::RecoverJournal turns it into the layout of EventProcessor::GetState
+	struct Encounter
+	{
+		uintptr_t LocalId = 0;
+		uint64_t CollectionTime = 0; // Highest time of any record up to the end of the encounter
+		std::shared_ptr<const AgentSnapshot> Agents;
+		std::map<uintptr_t, std::pair<std::string, HealingStatsSlim>> States; // <unique id, <name, state>>
+	};
+
+	// Creates a new journal at pPath, replacing an existing one. Nothing is written if that fails (see IsOpen). Once the
+	// file would grow past pMaxSize, nothing more is written either
+	EncounterJournal(const char* pPath, size_t pMaxSize = DEFAULT_MAX_SIZE);
+	~EncounterJournal(); // Cuts the file off after the last record
+
+	EncounterJournal(const EncounterJournal&) = delete;
+	EncounterJournal(EncounterJournal&&) = delete;
+	EncounterJournal& operator=(const EncounterJournal&) = delete;
+	EncounterJournal& operator=(EncounterJournal&&) = delete;
+
+	bool IsOpen();
+	size_t GetRecordCount();
+
+	void Self(uintptr_t pSelfId);
+	void Agent(uintptr_t pAgentId, const HealedAgent& pAgent);
+	void EnteredCombat(uint64_t pPlayerId, uint64_t pTime, uint16_t pSubGroup);
+	void ExitedCombat(uint64_t pPlayerId, uint64_t pTime, uint64_t pLastDamageEvent); // Also flushes the file for the local player
+	void Reset(uint64_t pPlayerId);
+	void Heals(uint64_t pPlayerId, HealEventLog::const_iterator pBegin, HealEventLog::const_iterator pEnd);
+
+	// Replays the journal at pPath the same way EventProcessor builds the player states, and returns the last
+	// pMaxEncounters encounters. Stops at the first record that is incomplete or corrupt.
+	//
+	// The journal is read twice: first without the heal events to find the encounters, then only the part of the file
+	// with the heal events of the encounters that are returned
+	static std::vector<Encounter> Read(const char* pPath, size_t pMaxEncounters);
+
+private:
+	struct Header
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t RecordSize;
+	};
+
+	constexpr static char MAGIC[8] = {'H', 'S', 'J', 'O', 'U', 'R', 'N', 'L'};
+	constexpr static uint32_t VERSION = 1;
+	constexpr static size_t HEADER_SIZE = 64; // Records start here
+
+	static uint32_t GetChecksum(const JournalRecord& pRecord);
+
+	// Calls pFunction(const JournalRecord& pRecord, size_t pIndex) for the records from index pFirst up to pEnd. Stops at
+	// the first record that is incomplete or corrupt, returns the index it stopped at
+	template <typename Function>
+	static size_t ForEachRecord(FILE* pFile, size_t pFirst, size_t pEnd, Function&& pFunction);
+
+	// Claims pCount consecutive records and calls pFunction(JournalRecord& pRecord, size_t pIndex) to fill in each of
+	// them (zeroed, pIndex counting from 0), then sets the checksum. Records that don't fit anymore once the journal is
+	// full are skipped. Takes mLock
+	template <typename Function>
+	void Append(size_t pCount, Function&& pFunction);
+	// Grows the file until it holds pRecordCount records, or marks the journal as full. Needs mLock exclusively
+	void Grow(size_t pRecordCount);
+	size_t GetCapacity() const; // Records that fit in the file as it is mapped now. Needs mLock
+	static void Commit(JournalRecord& pRecord);
+
+	std::shared_mutex mLock; // Exclusive while the mapping changes, shared while records are written to it
+	MappedFile mFile;
+	const size_t mMaxSize;
+	std::atomic_size_t mRecordCount = 0; // Claimed records, can run past the capacity once the journal is full
+	std::atomic_bool mIsFull = false;
+};
@@ -1,14 +1,38 @@
 #include "AddonVersion.h"
 #include "Common.h"
+#include "EncounterHistory.h"
+#include "EncounterJournal.h"
 #include "EventProcessor.h"
 #include "Exports.h"
 #include "Log.h"
 #include "Skills.h"
 #include "Utilities.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <cstddef>
 
+namespace
+{
+// Sizes of the stack buffers in PeerCombatBatch
+constexpr size_t UNIQUE_ID_CACHE_SIZE = 8;
+constexpr size_t PENDING_EVENTS_SIZE = 32;
+
+// Increments the data version when leaving the scope, so that every return path counts the event only after it was
+// applied to the state
+struct DataVersionIncrement
+{
+	std::atomic_uint64_t& Version;
+
+	~DataVersionIncrement()
+	{
+		Version.fetch_add(1, std::memory_order_release);
+	}
+};
+} // anonymous namespace
+
 [[maybe_unused]]
 static void PrintEvent(cbtevent* pEvent)
 {
@@ -70,6 +94,7 @@ static void PrintEvent(cbtevent* pEvent)
 
 EventProcessor::EventProcessor()
 	: mSkillTable(std::make_shared<SkillTable>())
+	, mEncounterHistory(std::make_shared<EncounterHistory>())
 {
 }
 
@@ -91,6 +116,7 @@ void EventProcessor::SetUseBarrier(bool pEnabled)
 
 void EventProcessor::AreaCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t /*pId*/, uint64_t /*pRevision*/)
 {
+	DataVersionIncrement versionIncrement{mDataVersion};
 	PreProcessEvent(pEvent, false);
 
 	if (pEvent == nullptr)
@@ -116,7 +142,7 @@ void EventProcessor::AreaCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestina
 			// name == nullptr here shouldn't be able to happen through arcdps, but it makes unit testing easier :)
 			if (pSourceAgent->name != nullptr)
 			{
-				mAgentTable.AddAgent(pSourceAgent->id, static_cast<uint16_t>(pDestinationAgent->id), pSourceAgent->name, pDestinationAgent->team, std::nullopt, isPlayer);
+				AddAgent(pSourceAgent->id, static_cast<uint16_t>(pDestinationAgent->id), pSourceAgent->name, pDestinationAgent->team, std::nullopt, isPlayer);
 			}
 		}
 		else
@@ -135,6 +161,9 @@ void EventProcessor::AreaCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestina
 				{
 					iter->second->ExitedCombat(timeGetTime());
 					LogI("Implicit exit combat for peer unique_id={} character_name='{}'", pSourceAgent->id, pSourceAgent->name);
+
+					// Peers that left are the ones that can be evicted, so this is a good time to check the budget
+					EvictPeers();
 				}
 			}
 		}
@@ -206,7 +235,7 @@ void EventProcessor::AreaCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestina
 		// name == nullptr here shouldn't be able to happen through arcdps, but it makes unit testing easier :)
 		if (pSourceAgent->name != nullptr)
 		{
-			mAgentTable.AddAgent(pSourceAgent->id, pEvent->src_instid, pSourceAgent->name, static_cast<uint16_t>(pEvent->dst_agent), isMinion, isPlayer);
+			AddAgent(pSourceAgent->id, pEvent->src_instid, pSourceAgent->name, static_cast<uint16_t>(pEvent->dst_agent), isMinion, isPlayer);
 		}
 
 		return;
@@ -244,6 +273,7 @@ void EventProcessor::AreaCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestina
 
 void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t /*pRevision*/, std::optional<cbtevent>* pModifiedEvent)
 {
+	DataVersionIncrement versionIncrement{mDataVersion};
 	UNREFERENCED_PARAMETER(pId);
 	PreProcessEvent(pEvent, true);
 
@@ -270,7 +300,7 @@ void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestin
 			// name == nullptr here shouldn't be able to happen through arcdps, but it makes unit testing easier :)
 			if (pSourceAgent->name != nullptr)
 			{
-				mAgentTable.AddAgent(pSourceAgent->id, static_cast<uint16_t>(pDestinationAgent->id), pSourceAgent->name, pDestinationAgent->team, std::nullopt, isPlayer);
+				AddAgent(pSourceAgent->id, static_cast<uint16_t>(pDestinationAgent->id), pSourceAgent->name, pDestinationAgent->team, std::nullopt, isPlayer);
 			}
 
 			if (pDestinationAgent->self != 0)
@@ -280,6 +310,12 @@ void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestin
 				LOG("Storing self instid=%llu uniqueid=%llu", pDestinationAgent->id, pSourceAgent->id);
 				mSelfInstanceId.store(static_cast<uint16_t>(pDestinationAgent->id), std::memory_order_relaxed);
 				mSelfUniqueId.store(pSourceAgent->id, std::memory_order_relaxed);
+
+				std::shared_ptr<EncounterJournal> journal = mJournal.load(std::memory_order_acquire);
+				if (journal != nullptr)
+				{
+					journal->Self(pSourceAgent->id);
+				}
 			}
 		}
 		else
@@ -308,6 +344,15 @@ void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestin
 
 		if (pSourceAgent->self != 0)
 		{
+			// Keep the previous encounter before entering combat clears it (peers are still in the same state as well,
+			// they are only reset below)
+			HealingStatsSlim localState = mLocalState.GetState();
+			if (localState.EnteredCombatTime != 0 && localState.ExitedCombatTime != 0)
+			{
+				auto [localId, states] = GetState();
+				mEncounterHistory->Add(localId, std::move(states));
+			}
+
 			mLocalState.EnteredCombat(pEvent->time, static_cast<uint16_t>(pEvent->dst_agent));
 		}
 
@@ -344,6 +389,7 @@ void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestin
 				iter++;
 			}
 		}
+		EvictPeers();
 
 		return;
 	}
@@ -448,7 +494,7 @@ void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestin
 	// Register agent if it's not already known
 	if (pDestinationAgent->name != nullptr)
 	{
-		mAgentTable.AddAgent(pDestinationAgent->id, pEvent->dst_instid, pDestinationAgent->name, std::nullopt, pEvent->dst_master_instid != 0, std::nullopt);
+		AddAgent(pDestinationAgent->id, pEvent->dst_instid, pDestinationAgent->name, std::nullopt, pEvent->dst_master_instid != 0, std::nullopt);
 	}
 
 	if (pEvent->is_shields != 0)
@@ -480,12 +526,21 @@ void EventProcessor::LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestin
 void EventProcessor::PeerCombat(cbtevent* pEvent, uint16_t pPeerInstanceId)
 {
 	assert(pEvent != nullptr);
-	PreProcessEvent(pEvent, true);
+	PeerCombatBatch(std::span<cbtevent>{pEvent, 1}, pPeerInstanceId);
+}
+
+void EventProcessor::PeerCombatBatch(std::span<cbtevent> pEvents, uint16_t pPeerInstanceId)
+{
+	DataVersionIncrement versionIncrement{mDataVersion};
+	if (pEvents.empty() == true)
+	{
+		return;
+	}
 
 	std::optional<uintptr_t> peerUniqueId = mAgentTable.GetUniqueId(pPeerInstanceId, false);
 	if (peerUniqueId.has_value() == false)
 	{
-		LogD("Dropping event since peer {} is unknown", pPeerInstanceId);
+		LogD("Dropping {} events since peer {} is unknown", pEvents.size(), pPeerInstanceId);
 		return;
 	}
 
@@ -493,148 +548,197 @@ void EventProcessor::PeerCombat(cbtevent* pEvent, uint16_t pPeerInstanceId)
 	{
 		std::lock_guard lock(mPeerStatesLock);
 
-		auto [iter, inserted] = mPeerStates.try_emplace(*peerUniqueId);
-		if (inserted == true)
+		auto iter = mPeerStates.find(*peerUniqueId);
+		if (iter == mPeerStates.end())
 		{
+			// Before inserting, the new state would otherwise be the first one to be evicted
+			EvictPeers();
+
+			iter = mPeerStates.try_emplace(*peerUniqueId, std::make_shared<PlayerStats>()).first;
+			iter->second->SetJournal(mJournal.load(std::memory_order_acquire), *peerUniqueId);
 			LOG("Inserted peer state for %hu %llu", pPeerInstanceId, *peerUniqueId);
-			iter->second = std::make_shared<PlayerStats>();
 		}
 
 		state = std::shared_ptr(iter->second);
 	}
 
-	if (pEvent->is_statechange == CBTS_ENTERCOMBAT)
-	{
-		LOG("EnterCombat agent %llu %hu %hu %llu",
-			pEvent->src_agent, pEvent->src_instid, pEvent->src_master_instid, pEvent->dst_agent);
+	// Eviction compares the activity of different peers, so it goes by when the batch arrived here instead of the event
+	// times (those come from the clock of each peer)
+	state->Touch(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()));
 
-		if (pEvent->src_instid == pPeerInstanceId)
+	// Both buffers below live on the stack - PeerCombat delivers every event as a batch of one, so allocating them
+	// would cost more than the lookups they save.
+
+	// Events from one peer nearly always reference the same handful of agents, so remember the latest instance id
+	// mappings for the duration of the batch instead of taking the agent table lock twice per event
+	std::array<std::pair<uint16_t, std::optional<uintptr_t>>, UNIQUE_ID_CACHE_SIZE> uniqueIdCache;
+	size_t uniqueIdCacheCount = 0;
+	auto getUniqueId = [this, &uniqueIdCache, &uniqueIdCacheCount](uint16_t pInstanceId) -> std::optional<uintptr_t>
+	{
+		for (size_t i = 0; i < (std::min)(uniqueIdCacheCount, uniqueIdCache.size()); i++)
 		{
-			state->EnteredCombat(pEvent->time, static_cast<uint16_t>(pEvent->dst_agent));
+			if (uniqueIdCache[i].first == pInstanceId)
+			{
+				return uniqueIdCache[i].second;
+			}
 		}
-		return;
-	}
-	else if (pEvent->is_statechange == CBTS_EXITCOMBAT)
-	{
-		LOG("ExitCombat agent %llu %hu %hu %llu",
-			pEvent->src_agent, pEvent->src_instid, pEvent->src_master_instid, pEvent->dst_agent);
 
-		if (pEvent->src_instid == pPeerInstanceId)
+		// Once the cache is full, the oldest mapping is replaced
+		std::optional<uintptr_t> uniqueId = mAgentTable.GetUniqueId(pInstanceId, true);
+		uniqueIdCache[uniqueIdCacheCount % uniqueIdCache.size()] = {pInstanceId, uniqueId};
+		uniqueIdCacheCount++;
+		return uniqueId;
+	};
+
+	// Healing events are buffered and handed to the peer state in one go (or one go per PENDING_EVENTS_SIZE events).
+	// Combat enter/exit changes how the buffered events are treated, so the buffer is flushed before those are applied
+	// to preserve ordering.
+	std::array<std::pair<cbtevent*, uintptr_t>, PENDING_EVENTS_SIZE> pendingEvents;
+	size_t pendingEventCount = 0;
+	auto flushPendingEvents = [&state, &pendingEvents, &pendingEventCount]()
+	{
+		if (pendingEventCount != 0)
 		{
-			// See LocalCombat handling of CBTS_EXITCOMBAT
-			uint64_t lastDamageEventTime = *reinterpret_cast<uint64_t*>(&pEvent->iff);
-			state->ExitedCombat(pEvent->time, lastDamageEventTime);
+			state->HealingEvents(std::span{pendingEvents.data(), pendingEventCount});
+			pendingEventCount = 0;
 		}
-		return;
-	}
+	};
 
-	EventType eventType = GetEventType(pEvent, true);
-	if (eventType == EventType::Damage || eventType == EventType::SemiDamaging)
+	for (cbtevent& event : pEvents)
 	{
-		LogD("PEER Damage event {} {} {} ({})->({}) iff={}",
-			pEvent->skillid, pEvent->value, pEvent->buff_dmg, pEvent->src_instid, pEvent->dst_instid, pEvent->iff);
-		//PrintEvent(pEvent);
+		cbtevent* pEvent = &event;
+		PreProcessEvent(pEvent, true);
 
-		if ((pEvent->src_instid == pPeerInstanceId || pEvent->dst_instid == pPeerInstanceId) && pEvent->iff == IFF_FOE)
+		if (pEvent->is_statechange == CBTS_ENTERCOMBAT)
 		{
-			state->DamageEvent(pEvent->time);
+			LOG("EnterCombat agent %llu %hu %hu %llu",
+				pEvent->src_agent, pEvent->src_instid, pEvent->src_master_instid, pEvent->dst_agent);
+
+			if (pEvent->src_instid == pPeerInstanceId)
+			{
+				flushPendingEvents();
+				state->EnteredCombat(pEvent->time, static_cast<uint16_t>(pEvent->dst_agent));
+			}
+			continue;
 		}
+		else if (pEvent->is_statechange == CBTS_EXITCOMBAT)
+		{
+			LOG("ExitCombat agent %llu %hu %hu %llu",
+				pEvent->src_agent, pEvent->src_instid, pEvent->src_master_instid, pEvent->dst_agent);
 
-		return;
-	}
-	else if (eventType == EventType::Other)
-	{
-		return;
-	}
+			if (pEvent->src_instid == pPeerInstanceId)
+			{
+				// See LocalCombat handling of CBTS_EXITCOMBAT
+				uint64_t lastDamageEventTime = *reinterpret_cast<uint64_t*>(&pEvent->iff);
+				flushPendingEvents();
+				state->ExitedCombat(pEvent->time, lastDamageEventTime);
+			}
+			continue;
+		}
 
-	std::optional<uintptr_t> srcUniqueId = mAgentTable.GetUniqueId(pEvent->src_instid, true);
-	std::optional<uintptr_t> dstUniqueId = mAgentTable.GetUniqueId(pEvent->dst_instid, true);
+		EventType eventType = GetEventType(pEvent, true);
+		if (eventType == EventType::Damage || eventType == EventType::SemiDamaging)
+		{
+			LogD("PEER Damage event {} {} {} ({})->({}) iff={}",
+				pEvent->skillid, pEvent->value, pEvent->buff_dmg, pEvent->src_instid, pEvent->dst_instid, pEvent->iff);
+			//PrintEvent(pEvent);
 
-	if (mEvtcLoggingEnabled.load(std::memory_order_relaxed) == true)
-	{
-		cbtevent logEvent = *pEvent;
+			if ((pEvent->src_instid == pPeerInstanceId || pEvent->dst_instid == pPeerInstanceId) && pEvent->iff == IFF_FOE)
+			{
+				state->DamageEvent(pEvent->time);
+			}
 
-		// Fix unique ids (they are invalid when coming from a peer)
-		logEvent.src_agent = srcUniqueId.value_or(0);
-		logEvent.dst_agent = dstUniqueId.value_or(0);
+			continue;
+		}
+		else if (eventType == EventType::Other)
+		{
+			continue;
+		}
 
-		// Flip event values so healed amount is negative
-		logEvent.value *= -1;
-		logEvent.buff_dmg *= -1;
-		// Arcdps currently uses the first 7 values for cbtbuffcycle so this should never remove any bits, but for some
-		// things it just says "non-zero" rather than explicitly calling out the expected value so we do this to be a
-		// bit more robust against arcdps setting random bits
-		logEvent.is_offcycle = logEvent.is_offcycle & ~(HealingEventFlags_EventCameFromSource |
-			HealingEventFlags_EventCameFromDestination |
-			HealingEventFlags_TargetIsDowned);
+		std::optional<uintptr_t> dstUniqueId = getUniqueId(pEvent->dst_instid);
 
-		if (logEvent.src_instid == pPeerInstanceId || logEvent.src_master_instid == pPeerInstanceId)
+		if (mEvtcLoggingEnabled.load(std::memory_order_relaxed) == true)
 		{
-			logEvent.is_offcycle |= HealingEventFlags_EventCameFromSource;
+			std::optional<uintptr_t> srcUniqueId = getUniqueId(pEvent->src_instid);
+			cbtevent logEvent = *pEvent;
+
+			// Fix unique ids (they are invalid when coming from a peer)
+			logEvent.src_agent = srcUniqueId.value_or(0);
+			logEvent.dst_agent = dstUniqueId.value_or(0);
+
+			// Flip event values so healed amount is negative
+			logEvent.value *= -1;
+			logEvent.buff_dmg *= -1;
+			// Arcdps currently uses the first 7 values for cbtbuffcycle so this should never remove any bits, but for some
+			// things it just says "non-zero" rather than explicitly calling out the expected value so we do this to be a
+			// bit more robust against arcdps setting random bits
+			logEvent.is_offcycle = logEvent.is_offcycle & ~(HealingEventFlags_EventCameFromSource |
+				HealingEventFlags_EventCameFromDestination |
+				HealingEventFlags_TargetIsDowned);
+
+			if (logEvent.src_instid == pPeerInstanceId || logEvent.src_master_instid == pPeerInstanceId)
+			{
+				logEvent.is_offcycle |= HealingEventFlags_EventCameFromSource;
+			}
+			if (logEvent.dst_instid == pPeerInstanceId || logEvent.dst_master_instid == pPeerInstanceId)
+			{
+				logEvent.is_offcycle |= HealingEventFlags_EventCameFromDestination;
+			}
+			if (logEvent.buff != 0 && logEvent.buff_dmg != 0 && logEvent.pad61 == 1)
+			{
+				logEvent.is_offcycle |= HealingEventFlags_TargetIsDowned;
+			}
+
+			GlobalObjects::ARC_E10(&logEvent, HEALING_STATS_ADDON_SIGNATURE);
 		}
-		if (logEvent.dst_instid == pPeerInstanceId || logEvent.dst_master_instid == pPeerInstanceId)
+
+		// No need to drop the event if src isn't known; we only use that translation for evtc logging
+		if (dstUniqueId.has_value() == false)
 		{
-			logEvent.is_offcycle |= HealingEventFlags_EventCameFromDestination;
+			LOG("Dropping event to %hu since destination agent is unknown", pEvent->dst_instid);
+			continue;
 		}
-		if (logEvent.buff != 0 && logEvent.buff_dmg != 0 && logEvent.pad61 == 1)
+
+		if (pEvent->is_shields != 0)
 		{
-			logEvent.is_offcycle |= HealingEventFlags_TargetIsDowned;
+			if (useBarrier.load(std::memory_order_relaxed) == false) {
+				// Shield application - not tracking for now
+				continue;
+			}
 		}
 
-		GlobalObjects::ARC_E10(&logEvent, HEALING_STATS_ADDON_SIGNATURE);
-	}
-
-	// No need to drop the event if src isn't known; we only use that translation for evtc logging
-	//if (srcUniqueId.has_value() == false)
-	//{
-	//	LOG("Dropping event to %hu since source agent is unknown", pEvent->src_instid);
-	//	return;
-	//}
-	if (dstUniqueId.has_value() == false)
-	{
-		LOG("Dropping event to %hu since destination agent is unknown", pEvent->dst_instid);
-		return;
-	}
-
-	if (pEvent->is_shields != 0)
-	{
-		if (useBarrier.load(std::memory_order_relaxed) == false) {
-			// Shield application - not tracking for now
-			return;
+		if (pEvent->src_instid != pPeerInstanceId &&
+			pEvent->src_master_instid != pPeerInstanceId)
+		{
+			// Source is someone else - not interesting
+			continue;
 		}
-	}
 
-	if (pEvent->src_instid != pPeerInstanceId &&
-		pEvent->src_master_instid != pPeerInstanceId)
-	{
-		// Source is someone else - not interesting
-		return;
-	}
+		pendingEvents[pendingEventCount] = {pEvent, *dstUniqueId};
+		pendingEventCount++;
+		if (pendingEventCount == pendingEvents.size())
+		{
+			flushPendingEvents();
+		}
 
-	if (pEvent->is_shields != 0)
-	{
-		state->BarrierEvent(pEvent, *dstUniqueId);
-	}
-	else
-	{
-		state->HealingEvent(pEvent, *dstUniqueId);
-	}
+		uint32_t healedAmount = pEvent->value;
+		if (healedAmount == 0)
+		{
+			healedAmount = pEvent->buff_dmg;
+			assert(healedAmount != 0);
+		}
 
-	uint32_t healedAmount = pEvent->value;
-	if (healedAmount == 0)
-	{
-		healedAmount = pEvent->buff_dmg;
-		assert(healedAmount != 0);
+		if (pEvent->is_shields != 0)
+		{
+			LOG("Registered barrier event size %i from %s:%u to %llu", healedAmount, mSkillTable->GetSkillName(pEvent->skillid), pEvent->skillid, *dstUniqueId);
+		}
+		else
+		{
+			LOG("Registered heal event size %i from %s:%u to %llu", healedAmount, mSkillTable->GetSkillName(pEvent->skillid), pEvent->skillid, *dstUniqueId);
+		}
 	}
 
-	if (pEvent->is_shields != 0)
-	{
-		LOG("Registered barrier event size %i from %s:%u to %llu", healedAmount, mSkillTable->GetSkillName(pEvent->skillid), pEvent->skillid, *dstUniqueId);
-	}
-	else
-	{
-		LOG("Registered heal event size %i from %s:%u to %llu", healedAmount, mSkillTable->GetSkillName(pEvent->skillid), pEvent->skillid, *dstUniqueId);
-	}
+	flushPendingEvents();
 }
 
 std::pair<uintptr_t, std::map<uintptr_t, std::pair<std::string, HealingStats>>> EventProcessor::GetState(uintptr_t pSelfUniqueId)
@@ -646,19 +750,22 @@ std::pair<uintptr_t, std::map<uintptr_t, std::pair<std::string, HealingStats>>>
 		pSelfUniqueId = mSelfUniqueId.load(std::memory_order_relaxed);
 	}
 
+	// Every state shares the same agent snapshot, it's only copied when the agent table changed since last time
+	std::shared_ptr<const AgentSnapshot> agents = mAgentTable.GetState();
+
 	auto [localEntry, localInserted] = result.try_emplace(pSelfUniqueId);
 	assert(localInserted == true);
 
 
 	*static_cast<HealingStatsSlim*>(&localEntry->second.second) = mLocalState.GetState();
 	localEntry->second.second.CollectionTime = collectionTime;
-	localEntry->second.second.Agents = mAgentTable.GetState();
+	localEntry->second.second.Agents = agents;
 	localEntry->second.second.Skills = std::shared_ptr(mSkillTable);
 
-	std::optional<std::string> localName = mAgentTable.GetName(pSelfUniqueId);
-	if (localName.has_value())
+	auto localAgent = agents->find(pSelfUniqueId);
+	if (localAgent != agents->end())
 	{
-		localEntry->second.first = std::move(*localName);
+		localEntry->second.first = localAgent->second.Name;
 	}
 	else
 	{
@@ -684,13 +791,13 @@ std::pair<uintptr_t, std::map<uintptr_t, std::pair<std::string, HealingStats>>>
 		*static_cast<HealingStatsSlim*>(&entry->second.second) = state->GetState();
 
 		entry->second.second.CollectionTime = collectionTime;
-		entry->second.second.Agents = mAgentTable.GetState();
+		entry->second.second.Agents = agents;
 		entry->second.second.Skills = std::shared_ptr(mSkillTable);
 
-		std::optional<std::string> name = mAgentTable.GetName(uniqueId);
-		if (name.has_value())
+		auto agent = agents->find(uniqueId);
+		if (agent != agents->end())
 		{
-			entry->second.first = std::move(*name);
+			entry->second.first = agent->second.Name;
 		}
 		else
 		{
@@ -704,6 +811,176 @@ std::pair<uintptr_t, std::map<uintptr_t, std::pair<std::string, HealingStats>>>
 	return {pSelfUniqueId, result};
 }
 
+uint64_t EventProcessor::GetDataVersion() const
+{
+	return mDataVersion.load(std::memory_order_acquire);
+}
+
+EncounterHistory& EventProcessor::GetEncounterHistory()
+{
+	return *mEncounterHistory;
+}
+
+void EventProcessor::SetPeerMemoryBudget(size_t pBudget)
+{
+	mPeerMemoryBudget.store(pBudget, std::memory_order_relaxed);
+
+	std::lock_guard lock(mPeerStatesLock);
+	EvictPeers();
+}
+
+PeerMemoryUsage EventProcessor::GetPeerMemoryUsage()
+{
+	std::lock_guard lock(mPeerMemoryUsageLock);
+	return mPeerMemoryUsage;
+}
+
+void EventProcessor::UpdatePeerMemoryUsage()
+{
+	PeerMemoryUsage result;
+	{
+		std::lock_guard lock(mPeerStatesLock);
+
+		result.PeerCount = mPeerStates.size();
+		result.EvictedPeerCount = mEvictedPeerCount;
+		for (const auto& [uniqueId, state] : mPeerStates)
+		{
+			PlayerStatsUsage usage = state->GetUsage();
+			result.EventLogBytes += usage.EventLogBytes;
+			result.TotalBytes += usage.TotalBytes;
+		}
+	}
+
+	std::lock_guard lock(mPeerMemoryUsageLock);
+	mPeerMemoryUsage = result;
+}
+
+void EventProcessor::SetJournal(std::shared_ptr<EncounterJournal> pJournal)
+{
+	std::lock_guard lock(mPeerStatesLock);
+	mJournal.store(pJournal, std::memory_order_release);
+
+	mLocalState.SetJournal(pJournal, EncounterJournal::LOCAL_PLAYER_ID);
+	for (const auto& [uniqueId, state] : mPeerStates)
+	{
+		state->SetJournal(pJournal, uniqueId);
+	}
+
+	if (pJournal == nullptr)
+	{
+		return;
+	}
+
+	// Only changes are journaled, so start with everything that is already known
+	const uintptr_t selfId = mSelfUniqueId.load(std::memory_order_relaxed);
+	if (selfId != UINT64_MAX)
+	{
+		pJournal->Self(selfId);
+	}
+	for (const auto& [uniqueId, agent] : *mAgentTable.GetState())
+	{
+		pJournal->Agent(uniqueId, agent);
+	}
+}
+
+size_t EventProcessor::RecoverJournal(const char* pPath, size_t pMaxEncounters)
+{
+	std::vector<EncounterJournal::Encounter> encounters = EncounterJournal::Read(pPath, pMaxEncounters);
+	for (EncounterJournal::Encounter& encounter : encounters)
+	{
+		std::map<uintptr_t, std::pair<std::string, HealingStats>> states;
+		for (auto& [uniqueId, state] : encounter.States)
+		{
+			auto& [name, stats] = states[uniqueId];
+			name = std::move(state.first);
+			*static_cast<HealingStatsSlim*>(&stats) = std::move(state.second);
+			stats.CollectionTime = encounter.CollectionTime;
+			stats.Agents = encounter.Agents;
+			stats.Skills = mSkillTable;
+		}
+
+		mEncounterHistory->Add(encounter.LocalId, std::move(states));
+	}
+	return encounters.size();
+}
+
+void EventProcessor::EvictPeers()
+{
+	const size_t budget = mPeerMemoryBudget.load(std::memory_order_relaxed);
+	if (budget == 0)
+	{
+		return;
+	}
+
+	struct Candidate
+	{
+		uint64_t LastActivityTime;
+		size_t Bytes;
+		uintptr_t UniqueId;
+	};
+	std::vector<Candidate> candidates;
+
+	size_t totalBytes = 0;
+	for (const auto& [uniqueId, state] : mPeerStates)
+	{
+		PlayerStatsUsage usage = state->GetUsage();
+		totalBytes += usage.TotalBytes;
+
+		// Same as when self enters combat, a state that is referenced elsewhere (by a batch that is being processed right
+		// now) is kept
+		if (usage.IsOutOfCombat == true && state.use_count() == 1)
+		{
+			candidates.emplace_back(Candidate{usage.LastActivityTime, usage.TotalBytes, uniqueId});
+		}
+	}
+
+	if (totalBytes <= budget)
+	{
+		return;
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& pLeft, const Candidate& pRight)
+		{
+			return pLeft.LastActivityTime < pRight.LastActivityTime;
+		});
+
+	std::shared_ptr<EncounterJournal> journal = mJournal.load(std::memory_order_acquire);
+	for (const Candidate& candidate : candidates)
+	{
+		if (totalBytes <= budget)
+		{
+			break;
+		}
+
+		LogD("Evicting peer {} (last active at {}, {} bytes) since peer states use {} bytes, budget is {}",
+			candidate.UniqueId, candidate.LastActivityTime, candidate.Bytes, totalBytes, budget);
+		mPeerStates.erase(candidate.UniqueId);
+		totalBytes -= candidate.Bytes;
+		mEvictedPeerCount++;
+
+		// So that a replayed journal doesn't bring the peer back
+		if (journal != nullptr)
+		{
+			journal->Reset(candidate.UniqueId);
+		}
+	}
+}
+
+void EventProcessor::AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char* pAgentName, std::optional<uint16_t> pSubgroup, std::optional<bool> pIsMinion, std::optional<bool> pIsPlayer)
+{
+	std::optional<HealedAgent> agent = mAgentTable.AddAgent(pUniqueId, pInstanceId, pAgentName, pSubgroup, pIsMinion, pIsPlayer);
+	if (agent.has_value() == false)
+	{
+		return;
+	}
+
+	std::shared_ptr<EncounterJournal> journal = mJournal.load(std::memory_order_acquire);
+	if (journal != nullptr)
+	{
+		journal->Agent(pUniqueId, *agent);
+	}
+}
+
 void EventProcessor::PreProcessEvent(cbtevent* pEvent, bool pIsLocal)
 {
 	if (pEvent == nullptr)
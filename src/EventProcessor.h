@@ -4,14 +4,31 @@
 #include "PlayerStats.h"
 #include "Skills.h"
 
+#include <memory>
 #include <optional>
+#include <span>
+
+class EncounterHistory;
+class EncounterJournal;
 
 struct HealingStats : HealingStatsSlim
 {
 	uint64_t CollectionTime = 0;
 
-	std::map<uintptr_t, HealedAgent> Agents; // <Unique Id, Agent>
+	std::shared_ptr<const AgentSnapshot> Agents; // Shared between all states returned by the same GetState call
 	std::shared_ptr<SkillTable> Skills; // <Skill Id, Skillname>
+
+	// Only set for past encounters (see EncounterHistory). Used instead of Events and Totals when aggregating, Events
+	// might be empty
+	std::shared_ptr<const FrozenTotals> Frozen;
+};
+
+struct PeerMemoryUsage
+{
+	size_t PeerCount = 0;
+	size_t EventLogBytes = 0; // Estimated bytes held by the event logs of all peers
+	size_t TotalBytes = 0; // Estimated bytes held by all peer states, including their event logs
+	size_t EvictedPeerCount = 0; // Peers that were evicted to stay within the budget so far
 };
 
 class EventProcessor
@@ -25,15 +42,41 @@ public:
 	void AreaCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
 	void LocalCombat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision, std::optional<cbtevent>* pModifiedEvent = nullptr);
 	void PeerCombat(cbtevent* pEvent, uint16_t pPeerInstanceId);
+	// Same as calling PeerCombat for every event in order, but the peer state and agent ids are only resolved once per
+	// batch and healing events are appended to the peer state under a single lock acquisition
+	void PeerCombatBatch(std::span<cbtevent> pEvents, uint16_t pPeerInstanceId);
 
 	// Returns <local unique id, map<unique id, <name, agent state>>
 	// pSelfUniqueId is only specified in testing
 	std::pair<uintptr_t, std::map<uintptr_t, std::pair<std::string, HealingStats>>> GetState(uintptr_t pSelfUniqueId = 0);
 
+	// Incremented after every processed event (once the event is reflected in GetState). If the version read before a
+	// GetState call is still the same later, no event was processed since that state was taken
+	uint64_t GetDataVersion() const;
+
+	// Encounters of the local player that finished before the current one. One is added every time self enters combat
+	EncounterHistory& GetEncounterHistory();
+
+	// Once all peer states together use more than pBudget bytes, peers that are out of combat are evicted, the ones that
+	// have been inactive the longest first. 0 disables the budget
+	void SetPeerMemoryBudget(size_t pBudget);
+	// Usage as of the last UpdatePeerMemoryUsage call, doesn't touch the peer states (called every frame by the GUI)
+	PeerMemoryUsage GetPeerMemoryUsage();
+	// Sums up the usage of all peer states, locking each of them. AggregationWorker calls it once per refresh interval
+	void UpdatePeerMemoryUsage();
+
+	// Journals every change to the player states and the agent table to pJournal from now on (nullptr to stop)
+	void SetJournal(std::shared_ptr<EncounterJournal> pJournal);
+	// Adds the last pMaxEncounters encounters in the journal at pPath (from an earlier session) to the encounter history.
+	// Returns how many encounters were added
+	size_t RecoverJournal(const char* pPath, size_t pMaxEncounters);
+
 #ifndef TEST
 private:
 #endif
 	void PreProcessEvent(cbtevent* pEvent, bool pIsLocal);
+	void EvictPeers(); // Needs mPeerStatesLock
+	void AddAgent(uintptr_t pUniqueId, uint16_t pInstanceId, const char* pAgentName, std::optional<uint16_t> pSubgroup, std::optional<bool> pIsMinion, std::optional<bool> pIsPlayer);
 
 	PlayerStats mLocalState;
 	std::atomic<uint32_t> mSelfInstanceId = UINT32_MAX;
@@ -44,6 +87,16 @@ private:
 
 	std::mutex mPeerStatesLock;
 	std::map<uintptr_t, std::shared_ptr<PlayerStats>> mPeerStates;
+	std::atomic_size_t mPeerMemoryBudget = 0;
+	size_t mEvictedPeerCount = 0; // Protected by mPeerStatesLock
+
+	std::mutex mPeerMemoryUsageLock;
+	PeerMemoryUsage mPeerMemoryUsage; // Protected by mPeerMemoryUsageLock
+
+	std::shared_ptr<EncounterHistory> mEncounterHistory; // Never nullptr
+	std::atomic<std::shared_ptr<EncounterJournal>> mJournal;
+
+	std::atomic_uint64_t mDataVersion = 0;
 
 	std::atomic_bool mEvtcLoggingEnabled = false;
 	std::atomic_bool useBarrier = false;
@@ -1,9 +1,86 @@
 #include "EventSequencer.h"
 #include "Log.h"
 
+#include <algorithm>
+#include <bit>
 #include <cassert>
+#include <string.h>
 
-EventSequencer::EventSequencer(const CombatCallbackSignature pCallback)
+#ifdef LINUX
+#include <time.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#endif
+
+namespace
+{
+// Milliseconds from an arbitrary point, wrapping around at UINT32_MAX
+uint32_t GetQueueTime()
+{
+#ifdef LINUX
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+	return static_cast<uint32_t>(time.tv_sec * 1000 + time.tv_nsec / 1000000);
+#elif defined(_WIN32)
+	return timeGetTime();
+#endif
+}
+} // anonymous namespace
+
+const char* AgentNameTable::Intern(const char* pName)
+{
+	{
+		std::shared_lock lock(mLock);
+
+		auto iter = mNamesByPointer.find(pName);
+		if (iter != mNamesByPointer.end() && strcmp(iter->second, pName) == 0)
+		{
+			return iter->second;
+		}
+
+		auto nameIter = mNames.find(std::string_view{pName});
+		if (nameIter != mNames.end())
+		{
+			return nameIter->data();
+		}
+	}
+
+	std::unique_lock lock(mLock);
+
+	const char* result;
+	auto nameIter = mNames.find(std::string_view{pName});
+	if (nameIter != mNames.end())
+	{
+		result = nameIter->data();
+	}
+	else
+	{
+		size_t length = strlen(pName);
+		std::unique_ptr<char[]>& storage = mStorage.emplace_back(std::make_unique<char[]>(length + 1));
+		memcpy(storage.get(), pName, length + 1);
+
+		mNames.emplace(storage.get(), length);
+		result = storage.get();
+
+		LogD("Interned name '{}', {} names known", result, mNames.size());
+	}
+
+	if (mNamesByPointer.size() >= MAX_CACHED_POINTERS)
+	{
+		mNamesByPointer.clear();
+	}
+	mNamesByPointer[pName] = result;
+
+	return result;
+}
+
+size_t AgentNameTable::GetNameCount()
+{
+	std::shared_lock lock(mLock);
+	return mNames.size();
+}
+
+EventSequencer::EventSequencer(const CombatEventHandler pCallback)
 	: mCallback(pCallback)
 {
 	for (uint32_t i = 0; i < MAX_QUEUED_EVENTS; i++)
@@ -32,14 +109,14 @@ uintptr_t EventSequencer::ProcessEvent(cbtevent* pEvent, ag* pSourceAgent, ag* p
 
 			LogW("Received event {} twice!", pId);
 
+			mDuplicateEventCount.fetch_add(1, std::memory_order_relaxed);
 			mCallback(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
 			return 0;
 		}
 
 		if (current == UINT64_MAX)
 		{
-			bool result = mHighestId.compare_exchange_weak(current, pId - 1, std::memory_order_acq_rel);
-			DBG_UNREFERENCED_LOCAL_VARIABLE(result);
+			[[maybe_unused]] bool result = mHighestId.compare_exchange_weak(current, pId - 1, std::memory_order_acq_rel);
 
 			LogD("Registered first event ({}) - result {}", pId, BOOL_STR(result));
 
@@ -50,6 +127,7 @@ uintptr_t EventSequencer::ProcessEvent(cbtevent* pEvent, ag* pSourceAgent, ag* p
 		{
 			LogD("Got event lower than current highest seen ({} vs {})", pId, current);
 
+			mLowerThanHighestEventCount.fetch_add(1, std::memory_order_relaxed);
 			mCallback(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
 			return 0;
 		}
@@ -75,110 +153,90 @@ uintptr_t EventSequencer::ProcessEvent(cbtevent* pEvent, ag* pSourceAgent, ag* p
 			if (current != current2)
 			{
 				LogD("Race1 current {} current2 {}", current, current2);
+				mRace1Count.fetch_add(1, std::memory_order_relaxed);
 
 				current = current2;
 				continue;
 			}
 
-			// Add first so that another racing thread is sure to read mQueuedLocalEventCount != 0 after changing
+			// Add first so that another racing thread is sure to read mQueuedEventCount != 0 after changing
 			// the value (or it is not able to change the value).
-			uint32_t index = mQueuedEventCount.fetch_add(1, std::memory_order_acq_rel);
-			if (index >= MAX_QUEUED_EVENTS)
-			{
-				LogD("More than max events queued - {} {} {} {}", index, MAX_QUEUED_EVENTS, pId, current);
-				// Subtracting here has the same issue as described below in Race2
-
-				assert(false);
-
-				mCallback(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
-				return 0;
-			}
+			const uint32_t queueDepth = mQueuedEventCount.fetch_add(1, std::memory_order_acq_rel) + 1;
 
 			current2 = mHighestId.load(std::memory_order_acquire);
 			if (current != current2)
 			{
-				// We can't decrement because of the race condition
-				// Thread2: fetch_add (0)
-				// Thread3: fetch_add (1)
-				// Thread3: read mHighestId
-				// Thread1: change mHighestId
-				// Thread2: read mHighestId
-				//
-				// If we were to decrement at that point, then index 1 would be given out twice
-				// So instead, we just add the event as completely empty.
-				mQueuedEvents[index].id = 0;
-
-				LogD("Race2 current {} current2 {} index {}", current, current2, index);
+				// Nothing has been written to the slot yet and flushing can't happen until we release the shared lock,
+				// so it's safe to just take the count back and try again
+				mQueuedEventCount.fetch_sub(1, std::memory_order_acq_rel);
+
+				LogD("Race2 current {} current2 {}", current, current2);
+				mRace2Count.fetch_add(1, std::memory_order_relaxed);
 
 				current = current2;
 				continue;
 			}
 
-			if (pEvent != nullptr)
+			if ((pId - current) > MAX_QUEUED_EVENTS)
 			{
-				*static_cast<cbtevent*>(&mQueuedEvents[index].ev) = *pEvent;
-				mQueuedEvents[index].ev.present = true;
-			}
-			else
-			{
-				mQueuedEvents[index].ev.present = false;
-			}
+				// The callback for a lower id is stalled (loading screens, big fights etc.) and the event doesn't fit in
+				// the ring. Park it in the overflow segment until the window has caught up.
+				std::unique_lock overflowLock(mOverflowLock);
+				if (mOverflowEvents.size() < MAX_OVERFLOW_EVENTS)
+				{
+					auto [iter, inserted] = mOverflowEvents.try_emplace(pId);
+					if (inserted == true)
+					{
+						StoreEvent(iter->second, pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+						size_t overflowSize = mOverflowEvents.size();
+						overflowLock.unlock();
 
-			if (pSourceAgent != nullptr)
-			{
-				mQueuedEvents[index].source_ag.id = pSourceAgent->id;
-				mQueuedEvents[index].source_ag.prof = pSourceAgent->prof;
-				mQueuedEvents[index].source_ag.elite = pSourceAgent->elite;
-				mQueuedEvents[index].source_ag.self = pSourceAgent->self;
-				mQueuedEvents[index].source_ag.team = pSourceAgent->team;
+						mOverflowedEventCount.fetch_add(1, std::memory_order_relaxed);
+						RecordQueueDepth(queueDepth);
 
-				if (pSourceAgent->name != nullptr)
-				{
-					mQueuedEvents[index].source_ag.name_storage = pSourceAgent->name;
-					mQueuedEvents[index].source_ag.name = mQueuedEvents[index].source_ag.name_storage.c_str();
+						LogD("Queued {} in overflow segment, current {}, overflow size {}", pId, current, overflowSize);
+						return 0;
+					}
+
+					LogW("Received overflowed event {} twice!", pId);
 				}
 				else
 				{
-					mQueuedEvents[index].source_ag.name = nullptr;
-				}
+					// Remember the id so that flushing can step over it once the window reaches it, the count is kept
+					// until then
+					mSkippedIds.emplace(pId);
+					overflowLock.unlock();
 
-				mQueuedEvents[index].source_ag.present = true;
-			}
-			else
-			{
-				mQueuedEvents[index].source_ag.present = false;
-			}
+					mOverflowFullEventCount.fetch_add(1, std::memory_order_relaxed);
 
-			if (pDestinationAgent != nullptr)
-			{
-				mQueuedEvents[index].destination_ag.id = pDestinationAgent->id;
-				mQueuedEvents[index].destination_ag.prof = pDestinationAgent->prof;
-				mQueuedEvents[index].destination_ag.elite = pDestinationAgent->elite;
-				mQueuedEvents[index].destination_ag.self = pDestinationAgent->self;
-				mQueuedEvents[index].destination_ag.team = pDestinationAgent->team;
+					LogW("Overflow segment is full, delivering {} out of order (current {})", pId, current);
 
-				if (pDestinationAgent->name != nullptr)
-				{
-					mQueuedEvents[index].destination_ag.name_storage = pDestinationAgent->name;
-					mQueuedEvents[index].destination_ag.name = mQueuedEvents[index].destination_ag.name_storage.c_str();
+					mCallback(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+					return 0;
 				}
-				else
-				{
-					mQueuedEvents[index].destination_ag.name = nullptr;
-				}
-
-				mQueuedEvents[index].destination_ag.present = true;
 			}
 			else
 			{
-				mQueuedEvents[index].destination_ag.present = false;
+				Event& slot = mQueuedEvents[pId % MAX_QUEUED_EVENTS];
+				if (slot.id == 0)
+				{
+					StoreEvent(slot, pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+					RecordQueueDepth(queueDepth);
+
+					LogT("Queued {} at index {}, current {}", pId, pId % MAX_QUEUED_EVENTS, current);
+					return 0;
+				}
+
+				// Only pId can map to this slot while it's inside the window, so this has to be a duplicate
+				assert(slot.id == pId);
+				LogW("Received queued event {} twice!", pId);
 			}
 
-			mQueuedEvents[index].skillname = pSkillname;
-			mQueuedEvents[index].id = pId;
-			mQueuedEvents[index].revision = pRevision;
+			// Duplicate, take the count back and deliver right away
+			mQueuedEventCount.fetch_sub(1, std::memory_order_acq_rel);
+			mDuplicateEventCount.fetch_add(1, std::memory_order_relaxed);
 
-			LogT("Queued {} at index {}, current {}", pId, index, current);
+			mCallback(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
 			return 0;
 		}
 	}
@@ -188,10 +246,125 @@ bool EventSequencer::QueueIsEmpty()
 {
 	bool isEmpty = (mQueuedEventCount.load(std::memory_order_acquire) == 0);
 
-	LogD("isEmpty={}, highestQueueSize={}", BOOL_STR(isEmpty), mHighestQueueSize.load(std::memory_order_relaxed));
+	Statistics statistics = GetStatistics();
+	LogD("isEmpty={}, highestQueueSize={}, delayedDeliveries={}, highestDwellTime={}ms, overflowedEvents={}, duplicates={}, lowerThanHighest={}, overflowFull={}, race1={}, race2={}",
+		BOOL_STR(isEmpty), statistics.HighestQueueSize, statistics.DelayedDeliveries, statistics.HighestDwellTime.count(), statistics.OverflowedEvents,
+		statistics.DuplicateEvents, statistics.LowerThanHighestEvents, statistics.OverflowFullEvents, statistics.Race1Retries, statistics.Race2Retries);
 	return isEmpty;
 }
 
+EventSequencer::Statistics EventSequencer::GetStatistics() const
+{
+	Statistics result;
+	result.HighestQueueSize = mHighestQueueSize.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < QUEUE_DEPTH_BUCKET_COUNT; i++)
+	{
+		result.QueueDepthHistogram[i] = mQueueDepthHistogram[i].load(std::memory_order_relaxed);
+	}
+
+	result.DelayedDeliveries = mDelayedDeliveryCount.load(std::memory_order_relaxed);
+	result.TotalDwellTime = std::chrono::milliseconds{mTotalDwellTime.load(std::memory_order_relaxed)};
+	result.HighestDwellTime = std::chrono::milliseconds{mHighestDwellTime.load(std::memory_order_relaxed)};
+
+	result.OverflowedEvents = mOverflowedEventCount.load(std::memory_order_relaxed);
+	result.DuplicateEvents = mDuplicateEventCount.load(std::memory_order_relaxed);
+	result.LowerThanHighestEvents = mLowerThanHighestEventCount.load(std::memory_order_relaxed);
+	result.OverflowFullEvents = mOverflowFullEventCount.load(std::memory_order_relaxed);
+	result.OutOfOrderDeliveries = result.DuplicateEvents + result.LowerThanHighestEvents + result.OverflowFullEvents;
+
+	result.Race1Retries = mRace1Count.load(std::memory_order_relaxed);
+	result.Race2Retries = mRace2Count.load(std::memory_order_relaxed);
+	return result;
+}
+
+void EventSequencer::RecordQueueDepth(uint32_t pQueueDepth)
+{
+	size_t bucket = std::min<size_t>(std::bit_width(pQueueDepth) - 1, QUEUE_DEPTH_BUCKET_COUNT - 1);
+	mQueueDepthHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void EventSequencer::StoreEvent(Event& pSlot, cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision)
+{
+	if (pEvent != nullptr)
+	{
+		*static_cast<cbtevent*>(&pSlot.ev) = *pEvent;
+		pSlot.ev.present = true;
+	}
+	else
+	{
+		pSlot.ev.present = false;
+	}
+
+	if (pSourceAgent != nullptr)
+	{
+		pSlot.source_ag.id = pSourceAgent->id;
+		pSlot.source_ag.prof = pSourceAgent->prof;
+		pSlot.source_ag.elite = pSourceAgent->elite;
+		pSlot.source_ag.self = pSourceAgent->self;
+		pSlot.source_ag.team = pSourceAgent->team;
+
+		pSlot.source_ag.name = (pSourceAgent->name != nullptr) ? mAgentNames.Intern(pSourceAgent->name) : nullptr;
+
+		pSlot.source_ag.present = true;
+	}
+	else
+	{
+		pSlot.source_ag.present = false;
+	}
+
+	if (pDestinationAgent != nullptr)
+	{
+		pSlot.destination_ag.id = pDestinationAgent->id;
+		pSlot.destination_ag.prof = pDestinationAgent->prof;
+		pSlot.destination_ag.elite = pDestinationAgent->elite;
+		pSlot.destination_ag.self = pDestinationAgent->self;
+		pSlot.destination_ag.team = pDestinationAgent->team;
+
+		pSlot.destination_ag.name = (pDestinationAgent->name != nullptr) ? mAgentNames.Intern(pDestinationAgent->name) : nullptr;
+
+		pSlot.destination_ag.present = true;
+	}
+	else
+	{
+		pSlot.destination_ag.present = false;
+	}
+
+	pSlot.skillname = pSkillname;
+	pSlot.id = pId;
+	pSlot.revision = pRevision;
+	pSlot.queuedTime = GetQueueTime();
+}
+
+void EventSequencer::DeliverEvent(Event& pSlot)
+{
+	LogT(">> Delayed {}", pSlot.id);
+
+	ag source;
+	ag destination;
+
+	ag* source_arg = nullptr;
+	ag* destination_arg = nullptr;
+	cbtevent* ev_arg = nullptr;
+	if (pSlot.source_ag.present == true)
+	{
+		source_arg = &source;
+		source = *static_cast<ag*>(&pSlot.source_ag);
+	}
+
+	if (pSlot.destination_ag.present == true)
+	{
+		destination_arg = &destination;
+		destination = *static_cast<ag*>(&pSlot.destination_ag);
+	}
+
+	if (pSlot.ev.present == true)
+	{
+		ev_arg = &pSlot.ev;
+	}
+
+	mCallback(ev_arg, source_arg, destination_arg, pSlot.skillname, pSlot.id, pSlot.revision);
+}
+
 void EventSequencer::TryFlushEvents()
 {
 	if (mQueuedEventCount.load(std::memory_order_acquire) == 0)
@@ -202,88 +375,95 @@ void EventSequencer::TryFlushEvents()
 	std::unique_lock lock(mLock);
 
 	uint32_t eventCount = mQueuedEventCount.load(std::memory_order_acquire);
-	if (eventCount > MAX_QUEUED_EVENTS)
+
+	// No need to worry about races here, this is the only place it's written to and that's done under lock
+	if (mHighestQueueSize.load(std::memory_order_relaxed) < eventCount)
 	{
-		// This is possible because of Race1 above
-		LogD("Truncating event count {} {}", eventCount, MAX_QUEUED_EVENTS);
-		eventCount = MAX_QUEUED_EVENTS;
+		mHighestQueueSize.store(eventCount, std::memory_order_relaxed);
 	}
 
-	bool removed = false;
-	size_t nonZeroEvents = 0;
-	do
+	// Walk forward from the highest delivered id until there is a gap. Every delivered event is the next one in
+	// order, so this never has to look at an event twice. Writers to the overflow segment and mSkippedIds hold mLock
+	// in shared mode so they can be accessed without mOverflowLock here.
+	uint64_t current = mHighestId.load(std::memory_order_acquire);
+	while (eventCount > 0)
 	{
-		removed = false;
-		nonZeroEvents = 0;
+		const uint64_t next = current + 1;
 
-		for (uint32_t i = 0; i < eventCount; i++)
+		// A duplicate of an overflowed or skipped id can arrive through the ring once the window has come close enough,
+		// and then gets delivered from the ring. The entry left behind would sit in front of every later id and stop
+		// them from ever matching, so it's dropped here. Overflowed copies are delivered like any other duplicate.
+		while (mOverflowEvents.empty() == false && mOverflowEvents.begin()->first < next)
 		{
-			if (mQueuedEvents[i].id == 0)
-			{
-				continue;
-			}
-
-			uint64_t current = mHighestId.load(std::memory_order_acquire);
-			if (current != (mQueuedEvents[i].id - 1))
-			{
-				nonZeroEvents++;
-				LogT("Skipping {}", mQueuedEvents[i].id);
-				continue;
-			}
-
-			LogT(">> Delayed {}", mQueuedEvents[i].id);
+			LogW("Dropping overflowed event {} since it was already delivered, delivering it as a duplicate", mOverflowEvents.begin()->first);
+			mDuplicateEventCount.fetch_add(1, std::memory_order_relaxed);
+			DeliverEvent(mOverflowEvents.begin()->second);
 
-			ag source;
-			ag destination;
+			mOverflowEvents.erase(mOverflowEvents.begin());
+			eventCount = mQueuedEventCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+		}
+		while (mSkippedIds.empty() == false && *mSkippedIds.begin() < next)
+		{
+			LogW("Dropping skipped id {} since it was delivered again", *mSkippedIds.begin());
+			mSkippedIds.erase(mSkippedIds.begin());
+			eventCount = mQueuedEventCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+		}
+		if (eventCount == 0)
+		{
+			break;
+		}
 
-			ag* source_arg = nullptr;
-			ag* destination_arg = nullptr;
-			cbtevent* ev_arg = nullptr;
-			if (mQueuedEvents[i].source_ag.present == true)
+		Event* event = &mQueuedEvents[next % MAX_QUEUED_EVENTS];
+		bool fromOverflow = false;
+		if (event->id != next)
+		{
+			if (mOverflowEvents.empty() == false && mOverflowEvents.begin()->first == next)
 			{
-				source_arg = &source;
-				source = *static_cast<ag*>(&mQueuedEvents[i].source_ag);
+				event = &mOverflowEvents.begin()->second;
+				fromOverflow = true;
 			}
-
-			if (mQueuedEvents[i].destination_ag.present == true)
+			else if (mSkippedIds.empty() == false && *mSkippedIds.begin() == next)
 			{
-				destination_arg = &destination;
-				destination = *static_cast<ag*>(&mQueuedEvents[i].destination_ag);
+				// Already delivered out of order
+				event = nullptr;
+				mSkippedIds.erase(mSkippedIds.begin());
 			}
-
-			if (mQueuedEvents[i].ev.present == true)
+			else
 			{
-				ev_arg = &mQueuedEvents[i].ev;
+				break;
 			}
+		}
 
-			mCallback(ev_arg, source_arg, destination_arg, mQueuedEvents[i].skillname, mQueuedEvents[i].id, mQueuedEvents[i].revision);
-
-			if (mHighestId.compare_exchange_strong(current, mQueuedEvents[i].id, std::memory_order_acq_rel) == false)
+		if (event != nullptr)
+		{
+			// Only the flushing thread writes the dwell time statistics (under lock), so there's no need for atomic
+			// read-modify-write
+			uint64_t dwellTime = static_cast<uint32_t>(GetQueueTime() - event->queuedTime);
+			mDelayedDeliveryCount.store(mDelayedDeliveryCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			mTotalDwellTime.store(mTotalDwellTime.load(std::memory_order_relaxed) + dwellTime, std::memory_order_relaxed);
+			if (mHighestDwellTime.load(std::memory_order_relaxed) < dwellTime)
 			{
-				assert(false);
+				mHighestDwellTime.store(dwellTime, std::memory_order_relaxed);
 			}
 
-			removed = true;
-			mQueuedEvents[i].id = 0;
+			DeliverEvent(*event);
 		}
-	} while (removed == true);
 
-	if (nonZeroEvents == 0)
-	{
-		for (uint32_t i = 0; i < MAX_QUEUED_EVENTS; i++)
+		uint64_t expected = current;
+		if (mHighestId.compare_exchange_strong(expected, next, std::memory_order_acq_rel) == false)
 		{
-			assert(mQueuedEvents[i].id == 0);
+			assert(false);
 		}
 
-		uint32_t oldSize = mQueuedEventCount.exchange(0, std::memory_order_acq_rel);
-
-		// No need to worry about races here, this is the only place it's written to and that's done under lock
-		if (mHighestQueueSize.load(std::memory_order_relaxed) < oldSize)
+		current = next;
+		if (fromOverflow == true)
 		{
-			mHighestQueueSize.store(oldSize, std::memory_order_relaxed);
+			mOverflowEvents.erase(mOverflowEvents.begin());
 		}
-
-		LogT("Clearing size {}", oldSize);
+		else if (event != nullptr)
+		{
+			event->id = 0;
+		}
+		eventCount = mQueuedEventCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
 	}
 }
-
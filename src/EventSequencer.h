@@ -1,14 +1,55 @@
 #pragma once
-#include "arcdps_structs.h"
+#include "arcdps_structs_slim.h"
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+// Same signature as the arcdps combat callbacks, declared here so that the sequencer builds without the Windows-only
+// arcdps headers
+typedef uintptr_t (*CombatEventHandler)(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
+
+// Agent names are a small set that keeps repeating. Each distinct name is copied once and the copy is never freed or
+// modified for the lifetime of the table, so the returned pointers can be stored anywhere without further copies.
+class AgentNameTable
+{
+public:
+	const char* Intern(const char* pName);
+	size_t GetNameCount();
+
+private:
+	constexpr static size_t MAX_CACHED_POINTERS = 4096;
+
+	std::shared_mutex mLock;
+	std::vector<std::unique_ptr<char[]>> mStorage;
+	std::unordered_set<std::string_view> mNames; // Views into mStorage
+
+	// Arcdps tends to pass the same pointer for the same agent, so check that first before hashing the content. The
+	// content is always compared since the memory behind a pointer can be reused for another name.
+	std::unordered_map<const char*, const char*> mNamesByPointer;
+};
+
 class EventSequencer
 {
 private:
-	const static uint32_t MAX_QUEUED_EVENTS = 256;
+	// Out-of-order events are stored in a ring indexed by id % MAX_QUEUED_EVENTS. Only ids in the range
+	// (mHighestId, mHighestId + MAX_QUEUED_EVENTS] are queued, so every queued event has a slot of its own
+	constexpr static uint32_t MAX_QUEUED_EVENTS = 256;
+
+	// Events that are too far ahead to fit in the ring are kept in the overflow segment instead. If that fills up as
+	// well, events are delivered out of order rather than growing without bounds (but ordering of the remaining
+	// events is kept).
+	constexpr static uint32_t MAX_OVERFLOW_EVENTS = 64 * 1024;
 
 	struct Event
 	{
@@ -17,36 +58,82 @@ private:
 			bool present;
 		} ev;
 
+		// Names point into mAgentNames
 		struct : ag
 		{
-			std::string name_storage;
 			bool present;
 		} source_ag;
 
 		struct : ag
 		{
-			std::string name_storage;
 			bool present;
 		} destination_ag;
 
 		const char* skillname; // Skill names are guaranteed to be valid for the lifetime of the process so copying pointer is fine
 		uint64_t id;
 		uint64_t revision;
+
+		uint32_t queuedTime; // GetQueueTime() when the event was queued
 	};
 public:
-	EventSequencer(const CombatCallbackSignature pCallback);
+	// Bucket i counts events queued while the queue held [2^i, 2^(i+1)) events (including the queued one). The last
+	// bucket also counts everything above it.
+	constexpr static size_t QUEUE_DEPTH_BUCKET_COUNT = 18;
+
+	struct Statistics
+	{
+		uint32_t HighestQueueSize = 0;
+		std::array<uint64_t, QUEUE_DEPTH_BUCKET_COUNT> QueueDepthHistogram{};
+
+		// Time between queueing an event and delivering it, for events that were delivered from the queue. Measured with
+		// a millisecond clock (timeGetTime() on Windows) since it's cheap enough to read for every queued event
+		uint64_t DelayedDeliveries = 0;
+		std::chrono::milliseconds TotalDwellTime{0};
+		std::chrono::milliseconds HighestDwellTime{0};
+
+		uint64_t OverflowedEvents = 0; // Events that were queued in the overflow segment
+		uint64_t OutOfOrderDeliveries = 0; // Events that were delivered without being sequenced (sum of the three below)
+		uint64_t DuplicateEvents = 0; // Ids that were received more than once
+		uint64_t LowerThanHighestEvents = 0; // Ids that were received after a higher id was already delivered
+		uint64_t OverflowFullEvents = 0; // Events that didn't fit in the overflow segment
+
+		uint64_t Race1Retries = 0; // Highest id changed while waiting for the queue lock
+		uint64_t Race2Retries = 0; // Highest id changed after reserving a queue slot
+	};
+
+	EventSequencer(const CombatEventHandler pCallback);
 
 	uintptr_t ProcessEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
 	bool QueueIsEmpty();
+	Statistics GetStatistics() const;
 
 private:
+	void StoreEvent(Event& pSlot, cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
+	void DeliverEvent(Event& pSlot);
+	void RecordQueueDepth(uint32_t pQueueDepth);
 	void TryFlushEvents();
 
-	const CombatCallbackSignature mCallback = nullptr;
+	const CombatEventHandler mCallback = nullptr;
 
 	std::shared_mutex mLock;
 	std::atomic_uint64_t mHighestId = UINT64_MAX;
 	std::atomic_uint32_t mQueuedEventCount = 0;
 	std::atomic_uint32_t mHighestQueueSize = 0;
+	std::array<std::atomic_uint64_t, QUEUE_DEPTH_BUCKET_COUNT> mQueueDepthHistogram{};
+	std::atomic_uint64_t mDelayedDeliveryCount = 0;
+	std::atomic_uint64_t mTotalDwellTime = 0; // Milliseconds
+	std::atomic_uint64_t mHighestDwellTime = 0; // Milliseconds
+	std::atomic_uint64_t mOverflowedEventCount = 0;
+	std::atomic_uint64_t mDuplicateEventCount = 0;
+	std::atomic_uint64_t mLowerThanHighestEventCount = 0;
+	std::atomic_uint64_t mOverflowFullEventCount = 0;
+	std::atomic_uint64_t mRace1Count = 0;
+	std::atomic_uint64_t mRace2Count = 0;
 	Event mQueuedEvents[MAX_QUEUED_EVENTS];
+
+	std::mutex mOverflowLock;
+	std::map<uint64_t, Event> mOverflowEvents;
+	std::set<uint64_t> mSkippedIds; // Ids that were delivered out of order because the overflow segment was full
+
+	AgentNameTable mAgentNames;
 };
\ No newline at end of file
@@ -1,7 +1,10 @@
 #pragma once
 #include "arcdps_structs.h"
+#include "AggregationWorker.h"
+#include "CombatEventQueue.h"
 #include "EventProcessor.h"
 #include "EventSequencer.h"
+#include "ThreadPool.h"
 #include "UpdateGUI.h"
 #include "../networking/Client.h"
 
@@ -22,10 +25,13 @@ public:
 	static inline E7Signature ARC_E7 = nullptr;
 	static inline E9Signature ARC_E9 = nullptr;
 	static inline E9Signature ARC_E10 = nullptr;
+	static inline std::unique_ptr<CombatEventQueue> COMBAT_EVENT_QUEUE = nullptr; // Only set if combat callbacks are offloaded
 	static inline std::unique_ptr<EventSequencer> EVENT_SEQUENCER = nullptr;
 	static inline std::unique_ptr<EventProcessor> EVENT_PROCESSOR = nullptr;
 	static inline std::unique_ptr<evtc_rpc_client> EVTC_RPC_CLIENT = nullptr;
 	static inline std::unique_ptr<std::thread> EVTC_RPC_CLIENT_THREAD = nullptr;
+	static inline std::unique_ptr<ThreadPool> AGGREGATION_THREAD_POOL = nullptr;
+	static inline std::unique_ptr<AggregationWorker> AGGREGATION_WORKER = nullptr;
 
 	static inline UpdateChecker::Version VERSION = {};
 	static inline char VERSION_STRING_FRIENDLY[128] = {};
@@ -1,6 +1,7 @@
 #include "GUI.h"
 
 #include "AggregatedStatsCollection.h"
+#include "EncounterHistory.h"
 #include "Exports.h"
 #include "ImGuiEx.h"
 #include "Log.h"
@@ -177,14 +178,17 @@ static void Display_Content(HealWindowContext& pContext, DataSource pDataSource,
 		const auto& entry = stats.Entries[i];
 
 		// TODO: Add barrier here?
-		std::array<std::optional<std::variant<uint64_t, double>>, 7> entryValues{
+		std::array<std::optional<std::variant<uint64_t, double>>, 10> entryValues{
 			entry.Healing,
 				entry.Hits,
 				entry.Casts,
 				divide_safe(entry.Healing, entry.TimeInCombat),
 				divide_safe(entry.Healing, entry.Hits),
 				entry.Casts.has_value() == true ? std::optional{divide_safe(entry.Healing, *entry.Casts)} : std::nullopt,
-				pContext.DataSourceChoice != DataSource::Totals ? std::optional{divide_safe(entry.Healing * 100, aggregatedTotal.Healing)} : std::nullopt };
+				pContext.DataSourceChoice != DataSource::Totals ? std::optional{divide_safe(entry.Healing * 100, aggregatedTotal.Healing)} : std::nullopt,
+				entry.RollingHealingPerSecond[0],
+				entry.RollingHealingPerSecond[1],
+				entry.RollingHealingPerSecond[2] };
 		ReplaceFormatted(buffer, sizeof(buffer), pContext.EntryFormat, entryValues);
 
 		float healingRatio = static_cast<float>(divide_safe(entry.Healing, stats.HighestHealing));
@@ -370,6 +374,35 @@ static void Display_WindowOptions(HealTableOptions& pHealingOptions, HealWindowC
 		ImGuiEx::AddTooltipToLastItem("Decides what should be used for determining combat\n"
 			"end (and consequently time in combat)");
 
+		if (ImGui::BeginMenu("encounter") == true)
+		{
+			if (ImGui::Selectable("current", pContext.SelectedEncounterId == 0, ImGuiSelectableFlags_DontClosePopups) == true)
+			{
+				pContext.SelectedEncounterId = 0;
+			}
+
+			// Newest first
+			std::vector<std::shared_ptr<const EncounterHistory::Encounter>> encounters = GlobalObjects::EVENT_PROCESSOR->GetEncounterHistory().GetEncounters();
+			for (auto iter = encounters.rbegin(); iter != encounters.rend(); iter++)
+			{
+				const EncounterHistory::Encounter& encounter = **iter;
+
+				char label[64];
+				snprintf(label, sizeof(label), "previous #%zu (%.1fs)###ENCOUNTER%llu",
+					static_cast<size_t>(std::distance(encounters.rbegin(), iter)) + 1,
+					(encounter.EndTime > encounter.EnteredCombatTime) ? (encounter.EndTime - encounter.EnteredCombatTime) / 1000.0f : 0.0f,
+					encounter.Id);
+				if (ImGui::Selectable(label, pContext.SelectedEncounterId == encounter.Id, ImGuiSelectableFlags_DontClosePopups) == true)
+				{
+					pContext.SelectedEncounterId = encounter.Id;
+				}
+			}
+			ImGui::EndMenu();
+		}
+		ImGuiEx::AddTooltipToLastItem("Shows one of the past encounters that are kept in memory instead\n"
+			"of the current one. Past encounters were already aggregated when\n"
+			"they ended, so switching between them is cheap.");
+
 		ImGuiEx::SmallUnindent();
 		ImGui::Separator();
 
@@ -398,6 +431,12 @@ static void Display_WindowOptions(HealTableOptions& pHealingOptions, HealWindowC
 			ImGuiEx::AddTooltipToLastItem(
 				"The maximum amount of lines of data to show in this window. Set to 0 for no limit");
 
+			ImGuiEx::SmallCheckBox("only top entries", &pContext.TopEntriesOnly);
+			ImGuiEx::AddTooltipToLastItem(
+				"Only show the first \"max displayed\" entries instead of letting\n"
+				"the window scroll through all of them. Skips the work for the\n"
+				"entries that are cut off, which helps with many healed players.");
+
 			ImGui::SetNextItemWidth(260.0f);
 			ImGuiEx::SmallInputText("stats format", pContext.EntryFormat, sizeof(pContext.EntryFormat));
 			if (pContext.DataSourceChoice != DataSource::Totals)
@@ -409,7 +448,10 @@ static void Display_WindowOptions(HealTableOptions& pHealingOptions, HealWindowC
 					"{4}: Healing per second\n"
 					"{5}: Healing per hit\n"
 					"{6}: Healing per cast (not implemented yet)\n"
-					"{7}: Percent of total healing");
+					"{7}: Percent of total healing\n"
+					"{8}: Healing per second in the last 5 seconds\n"
+					"{9}: Healing per second in the last 10 seconds\n"
+					"{10}: Healing per second in the last 30 seconds");
 			}
 			else
 			{
@@ -419,7 +461,10 @@ static void Display_WindowOptions(HealTableOptions& pHealingOptions, HealWindowC
 					"{3}: Casts (not implemented yet)\n"
 					"{4}: Healing per second\n"
 					"{5}: Healing per hit\n"
-					"{6}: Healing per cast (not implemented yet)");
+					"{6}: Healing per cast (not implemented yet)\n"
+					"{8}: Healing per second in the last 5 seconds\n"
+					"{9}: Healing per second in the last 10 seconds\n"
+					"{10}: Healing per second in the last 30 seconds");
 			}
 
 			ImGui::SetNextItemWidth(260.0f);
@@ -433,7 +478,10 @@ static void Display_WindowOptions(HealTableOptions& pHealingOptions, HealWindowC
 					"{4}: Healing per second\n"
 					"{5}: Healing per hit\n"
 					"{6}: Healing per cast (not implemented yet)\n"
-					"{7}: Time in combat");
+					"{7}: Time in combat\n"
+					"{8}: Healing per second in the last 5 seconds\n"
+					"{9}: Healing per second in the last 10 seconds\n"
+					"{10}: Healing per second in the last 30 seconds");
 			}
 			else
 			{
@@ -521,17 +569,32 @@ void Display_GUI(HealTableOptions& pHealingOptions)
 
 		if (curWindow.Shown == false)
 		{
+			// CurrentAggregatedStats is kept, so that the window has something to show right away when it's shown again
+			GlobalObjects::AGGREGATION_WORKER->SetWindow(i, nullptr, pHealingOptions.DebugMode);
 			continue;
 		}
 
-		time_t curTime = ::time(0);
-		if (curWindow.LastAggregatedTime < curTime)
+		if (curWindow.SelectedEncounterId != 0 &&
+			GlobalObjects::EVENT_PROCESSOR->GetEncounterHistory().GetEncounter(curWindow.SelectedEncounterId) == nullptr)
 		{
-			//LOG("Fetching new aggregated stats");
+			LogD("Encounter {} shown in window {} was evicted from the history, showing the current encounter instead", curWindow.SelectedEncounterId, i);
+			curWindow.SelectedEncounterId = 0;
+		}
 
-			auto [localId, states] = GlobalObjects::EVENT_PROCESSOR->GetState();
-			curWindow.CurrentAggregatedStats = std::make_unique<AggregatedStatsCollection>(std::move(states), localId, curWindow, pHealingOptions.DebugMode);
-			curWindow.LastAggregatedTime = curTime;
+		// Stats are aggregated by the worker thread, only pick up the latest published ones here
+		GlobalObjects::AGGREGATION_WORKER->SetWindow(i, &curWindow, pHealingOptions.DebugMode, curWindow.SelectedEncounterId);
+		std::shared_ptr<AggregatedStatsCollection> publishedStats = GlobalObjects::AGGREGATION_WORKER->GetStats(i);
+		if (publishedStats != nullptr)
+		{
+			curWindow.CurrentAggregatedStats = std::move(publishedStats);
+		}
+		else if (curWindow.CurrentAggregatedStats == nullptr)
+		{
+			// Window is shown for the first time and the worker didn't publish anything for it yet. Show it empty until
+			// it does instead of aggregating on the render thread
+			std::map<uintptr_t, std::pair<std::string, HealingStats>> states;
+			states[0].second.Agents = std::make_shared<const AgentSnapshot>();
+			curWindow.CurrentAggregatedStats = std::make_shared<AggregatedStatsCollection>(std::move(states), 0, curWindow, pHealingOptions.DebugMode);
 		}
 
 		float timeInCombat = curWindow.CurrentAggregatedStats->GetCombatTime();
@@ -540,14 +603,17 @@ void Display_GUI(HealTableOptions& pHealingOptions)
 		if (curWindow.DataSourceChoice != DataSource::Totals)
 		{
 			// TODO: Add barrier here?
-			std::array<std::optional<std::variant<uint64_t, double>>, 7> titleValues{
+			std::array<std::optional<std::variant<uint64_t, double>>, 10> titleValues{
 				aggregatedTotal.Healing,
 					aggregatedTotal.Hits,
 					aggregatedTotal.Casts,
 					divide_safe(aggregatedTotal.Healing, aggregatedTotal.TimeInCombat),
 					divide_safe(aggregatedTotal.Healing, aggregatedTotal.Hits),
 					aggregatedTotal.Casts.has_value() == true ? std::optional{divide_safe(aggregatedTotal.Healing, *aggregatedTotal.Casts)} : std::nullopt,
-					timeInCombat };
+					timeInCombat,
+					aggregatedTotal.RollingHealingPerSecond[0],
+					aggregatedTotal.RollingHealingPerSecond[1],
+					aggregatedTotal.RollingHealingPerSecond[2] };
 			size_t written = ReplaceFormatted(buffer, 128ULL, curWindow.TitleFormat, titleValues);
 			snprintf(buffer + written, sizeof(buffer) - written, "###HEALWINDOW%u", i);
 		}
@@ -695,6 +761,50 @@ static void Display_EvtcRpcStatus(const HealTableOptions& pHealingOptions)
 	}
 }
 
+static void Display_EventSequencerStatistics()
+{
+	EventSequencer::Statistics statistics = GlobalObjects::EVENT_SEQUENCER->GetStatistics();
+
+	ImGui::Text("highest queue size: %u", statistics.HighestQueueSize);
+	ImGui::Text("delayed deliveries: %llu", statistics.DelayedDeliveries);
+	if (statistics.DelayedDeliveries > 0)
+	{
+		ImGui::Text("dwell time: avg %.1fms, max %llums",
+			static_cast<double>(statistics.TotalDwellTime.count()) / statistics.DelayedDeliveries,
+			static_cast<uint64_t>(statistics.HighestDwellTime.count()));
+	}
+	ImGui::Text("overflowed: %llu, overflow full: %llu", statistics.OverflowedEvents, statistics.OverflowFullEvents);
+	ImGui::Text("duplicates: %llu, lower than highest: %llu", statistics.DuplicateEvents, statistics.LowerThanHighestEvents);
+	ImGui::Text("race1: %llu, race2: %llu", statistics.Race1Retries, statistics.Race2Retries);
+
+	ImGui::TextUnformatted("queue depth when queueing:");
+	ImGuiEx::SmallIndent();
+	for (size_t i = 0; i < statistics.QueueDepthHistogram.size(); i++)
+	{
+		if (statistics.QueueDepthHistogram[i] == 0)
+		{
+			continue;
+		}
+
+		if (i + 1 < statistics.QueueDepthHistogram.size())
+		{
+			ImGui::Text("%llu-%llu: %llu", 1ULL << i, (1ULL << (i + 1)) - 1, statistics.QueueDepthHistogram[i]);
+		}
+		else
+		{
+			ImGui::Text("%llu+: %llu", 1ULL << i, statistics.QueueDepthHistogram[i]);
+		}
+	}
+	ImGuiEx::SmallUnindent();
+
+	if (GlobalObjects::COMBAT_EVENT_QUEUE != nullptr)
+	{
+		CombatEventQueue::Statistics queueStatistics = GlobalObjects::COMBAT_EVENT_QUEUE->GetStatistics();
+		ImGui::Text("background queue: %llu pushed, %llu processed, %llu full queue waits",
+			queueStatistics.PushedEvents, queueStatistics.ProcessedEvents, queueStatistics.FullQueueWaits);
+	}
+}
+
 void Display_AddonOptions(HealTableOptions& pHealingOptions)
 {
 	ImGui::TextUnformatted("Heal Stats");
@@ -729,6 +839,15 @@ void Display_AddonOptions(HealTableOptions& pHealingOptions)
 		"Logs are saved in addons\\logs\\arcdps_healing_stats\\. Logging\n"
 		"will have a small impact on performance.");
 
+	if (pHealingOptions.DebugMode == true)
+	{
+		if (ImGui::TreeNode("event sequencer statistics") == true)
+		{
+			Display_EventSequencerStatistics();
+			ImGui::TreePop();
+		}
+	}
+
 	ImGui::Separator();
 
 
@@ -736,6 +855,65 @@ void Display_AddonOptions(HealTableOptions& pHealingOptions)
 	{
 		GlobalObjects::EVENT_PROCESSOR->SetUseBarrier(pHealingOptions.IncludeBarrier);
 	}
+	ImGuiEx::SmallCheckBox("process combat events in background", &pHealingOptions.OffloadCombatCallbacks);
+	ImGuiEx::AddTooltipToLastItem(
+		"Copies combat events into a queue and processes them on a\n"
+		"separate thread instead of inside the arcdps callback. This\n"
+		"reduces the time spent in arcdps callbacks but stats are\n"
+		"updated slightly later.\n"
+		"\n"
+		"Takes effect after restarting the game.");
+	if (ImGuiEx::SmallInputInt("stats refresh interval (ms)", &pHealingOptions.RefreshIntervalMs) == true)
+	{
+		pHealingOptions.RefreshIntervalMs = (std::max)(pHealingOptions.RefreshIntervalMs, MIN_REFRESH_INTERVAL_MS);
+		GlobalObjects::AGGREGATION_WORKER->SetRefreshInterval(std::chrono::milliseconds(pHealingOptions.RefreshIntervalMs));
+	}
+	ImGuiEx::AddTooltipToLastItem(
+		"How often the shown stats are updated. Every update only adds\n"
+		"the events that happened since the previous one, so short\n"
+		"intervals are cheap. Stats are always updated right away when\n"
+		"the options of a window change.");
+
+	bool encounterHistoryChanged = false;
+	encounterHistoryChanged |= ImGuiEx::SmallInputInt("past encounters kept", &pHealingOptions.EncounterHistoryCount);
+	ImGuiEx::AddTooltipToLastItem(
+		"Number of past encounters that are kept in memory, so they can be\n"
+		"selected in the 'encounter' menu of a window. 0 keeps none.");
+	encounterHistoryChanged |= ImGuiEx::SmallInputInt("past encounters memory budget (MB)", &pHealingOptions.EncounterHistoryBudgetMb);
+	ImGuiEx::AddTooltipToLastItem(
+		"The oldest past encounters are dropped once all of them together\n"
+		"use more memory than this.");
+	encounterHistoryChanged |= ImGuiEx::SmallCheckBox("keep events of past encounters", &pHealingOptions.EncounterHistoryKeepEvents);
+	ImGuiEx::AddTooltipToLastItem(
+		"Past encounters only need their totals to be shown. Keeping every\n"
+		"heal event as well uses a lot more memory, which means fewer\n"
+		"encounters fit in the budget.");
+	if (encounterHistoryChanged == true)
+	{
+		GlobalObjects::EVENT_PROCESSOR->GetEncounterHistory().SetLimits(pHealingOptions.EncounterHistoryCount,
+			pHealingOptions.EncounterHistoryBudgetMb * 1024 * 1024, pHealingOptions.EncounterHistoryKeepEvents);
+	}
+	ImGuiEx::SmallCheckBox("journal encounters to disk", &pHealingOptions.EncounterJournalEnabled);
+	ImGuiEx::AddTooltipToLastItem(
+		"Writes every heal event to addons\\arcdps\\arcdps_healing_stats_journal.bin\n"
+		"while it happens. If the game crashes or the addon is unloaded,\n"
+		"the encounters of that session are loaded into the past encounters\n"
+		"on the next start.\n"
+		"\n"
+		"Takes effect after restarting the game.");
+
+	if (ImGuiEx::SmallInputInt("squad members memory budget (MB)", &pHealingOptions.PeerMemoryBudgetMb) == true)
+	{
+		GlobalObjects::EVENT_PROCESSOR->SetPeerMemoryBudget(pHealingOptions.PeerMemoryBudgetMb * 1024 * 1024);
+	}
+	ImGuiEx::AddTooltipToLastItem(
+		"Stats of other squad members (shared through live stats sharing)\n"
+		"are kept until they are evicted. Once all of them together use\n"
+		"more memory than this, the ones that have been out of combat the\n"
+		"longest are dropped. 0 never drops any.");
+	PeerMemoryUsage peerMemoryUsage = GlobalObjects::EVENT_PROCESSOR->GetPeerMemoryUsage();
+	ImGui::Text("squad members: %zu, %.1f MB in event logs (%.1f MB total), %zu evicted", peerMemoryUsage.PeerCount,
+		peerMemoryUsage.EventLogBytes / (1024.0 * 1024.0), peerMemoryUsage.TotalBytes / (1024.0 * 1024.0), peerMemoryUsage.EvictedPeerCount);
 	ImGui::Separator();
 
 
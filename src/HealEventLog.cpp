@@ -0,0 +1,245 @@
+#include "HealEventLog.h"
+
+#include "Utilities.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <tuple>
+
+HealEvent::HealEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
+	: Time{ pTime }
+	, Size{ pSize }
+	, AgentId{ pAgentId }
+	, SkillId{ pSkillId }
+	, IsBarrier{ pIsBarrier }
+{
+}
+
+bool HealEvent::operator==(const HealEvent& pRight) const
+{
+	return std::tie(Time, Size, AgentId, SkillId, IsBarrier) == std::tie(pRight.Time, pRight.Size, pRight.AgentId, pRight.SkillId, pRight.IsBarrier);
+}
+
+bool HealEvent::operator!=(const HealEvent& pRight) const
+{
+	return (*this == pRight) == false;
+}
+
+void HealEventLog::emplace_back(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
+{
+	const size_t chunkIndex = mSize / CHUNK_SIZE;
+	const size_t slot = mSize % CHUNK_SIZE;
+
+	if (mSize == 0)
+	{
+		mBaseTime = pTime;
+	}
+	else if (pTime < mLastTime)
+	{
+		mIsSorted = false;
+	}
+	mLastTime = pTime;
+
+	Chunk* chunk = nullptr;
+	if (slot == 0)
+	{
+		// Every chunk is full (or there are none yet)
+		std::shared_ptr<Chunk> newChunk = std::make_shared_for_overwrite<Chunk>();
+		newChunk->Used.store(1, std::memory_order_relaxed);
+
+		if (mChunks == nullptr)
+		{
+			mChunks = std::make_shared<ChunkList>();
+		}
+		else if (shared_ptr_is_unique(mChunks) == false)
+		{
+			mChunks = std::make_shared<ChunkList>(*mChunks);
+		}
+		assert(mChunks->size() == chunkIndex);
+		mChunks->emplace_back(newChunk);
+
+		chunk = newChunk.get();
+	}
+	else
+	{
+		chunk = (*mChunks)[chunkIndex].get();
+
+		size_t expected = slot;
+		if (chunk->Used.compare_exchange_strong(expected, slot + 1, std::memory_order_acq_rel) == false)
+		{
+			// Another copy of this log already appended to the chunk, so take a private copy of the part that belongs
+			// to this log
+			std::shared_ptr<Chunk> newChunk = std::make_shared_for_overwrite<Chunk>();
+			newChunk->Used.store(slot + 1, std::memory_order_relaxed);
+			memcpy(newChunk->TimeOffsets, chunk->TimeOffsets, slot * sizeof(chunk->TimeOffsets[0]));
+			memcpy(newChunk->Sizes, chunk->Sizes, slot * sizeof(chunk->Sizes[0]));
+			memcpy(newChunk->SkillIds, chunk->SkillIds, slot * sizeof(chunk->SkillIds[0]));
+			memcpy(newChunk->AgentIndices, chunk->AgentIndices, slot * sizeof(chunk->AgentIndices[0]));
+			memcpy(newChunk->Flags, chunk->Flags, slot * sizeof(chunk->Flags[0]));
+
+			std::shared_ptr<ChunkList> chunks = std::make_shared<ChunkList>(*mChunks);
+			(*chunks)[chunkIndex] = newChunk;
+
+			chunk = newChunk.get();
+			mChunks = std::move(chunks);
+		}
+	}
+
+	int64_t timeOffset = static_cast<int64_t>(pTime - mBaseTime);
+	assert(timeOffset >= INT32_MIN && timeOffset <= INT32_MAX);
+	assert(pSize <= UINT32_MAX);
+
+	chunk->TimeOffsets[slot] = static_cast<int32_t>(std::clamp<int64_t>(timeOffset, INT32_MIN, INT32_MAX));
+	chunk->Sizes[slot] = static_cast<uint32_t>((std::min<uint64_t>)(pSize, UINT32_MAX));
+	chunk->SkillIds[slot] = pSkillId;
+	chunk->AgentIndices[slot] = GetAgentIndex(pAgentId);
+	chunk->Flags[slot] = pIsBarrier == true ? EventFlags_IsBarrier : 0;
+	mSize++;
+}
+
+void HealEventLog::clear()
+{
+	// Chunks are left as they are since other copies might still be reading them
+	mChunks = nullptr;
+	mAgents = nullptr;
+	mSize = 0;
+	mBaseTime = 0;
+	mLastTime = 0;
+	mIsSorted = true;
+}
+
+bool HealEventLog::operator==(const HealEventLog& pRight) const
+{
+	if (mSize != pRight.mSize)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < mSize; i++)
+	{
+		if ((*this)[i] != pRight[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool HealEventLog::operator!=(const HealEventLog& pRight) const
+{
+	return (*this == pRight) == false;
+}
+
+HealEventLog::ColumnChunk HealEventLog::GetChunk(size_t pChunkIndex) const
+{
+	assert(pChunkIndex < GetChunkCount());
+
+	const Chunk& chunk = *(*mChunks)[pChunkIndex];
+
+	ColumnChunk result;
+	result.TimeOffsets = chunk.TimeOffsets;
+	result.Sizes = chunk.Sizes;
+	result.SkillIds = chunk.SkillIds;
+	result.AgentIndices = chunk.AgentIndices;
+	result.Flags = chunk.Flags;
+	result.Count = (std::min)(CHUNK_SIZE, mSize - pChunkIndex * CHUNK_SIZE);
+	return result;
+}
+
+size_t HealEventLog::GetMemoryUsage() const
+{
+	size_t result = 0;
+	if (mChunks != nullptr)
+	{
+		result += sizeof(ChunkList) + mChunks->capacity() * sizeof(ChunkList::value_type) + GetChunkCount() * sizeof(Chunk);
+	}
+	if (mAgents != nullptr)
+	{
+		// Rough estimate of the hash map nodes, the exact layout depends on the standard library
+		result += sizeof(AgentTable) + mAgents->Ids.capacity() * sizeof(uintptr_t) +
+			mAgents->Indices.size() * (sizeof(std::pair<uintptr_t, uint16_t>) + 2 * sizeof(void*));
+	}
+	return result;
+}
+
+bool HealEventLog::StartsWith(const HealEventLog& pPrefix) const
+{
+	if (pPrefix.mSize == 0)
+	{
+		return true;
+	}
+
+	if (pPrefix.mSize > mSize || pPrefix.mBaseTime != mBaseTime)
+	{
+		return false;
+	}
+
+	// Appending never changes events that are already in a chunk, and agent indices are never reassigned
+	for (size_t i = 0; i < pPrefix.GetChunkCount(); i++)
+	{
+		if ((*pPrefix.mChunks)[i] != (*mChunks)[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t HealEventLog::UpperBound(size_t pFirst, uint64_t pTime) const
+{
+	assert(mIsSorted == true);
+	assert(pFirst <= mSize);
+
+	const int64_t offset = static_cast<int64_t>(pTime) - static_cast<int64_t>(mBaseTime);
+
+	size_t low = pFirst;
+	size_t high = mSize;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if ((*mChunks)[middle / CHUNK_SIZE]->TimeOffsets[middle % CHUNK_SIZE] <= offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+uint16_t HealEventLog::GetAgentIndex(uintptr_t pAgentId)
+{
+	if (mAgents != nullptr)
+	{
+		auto iter = mAgents->Indices.find(pAgentId);
+		if (iter != mAgents->Indices.end())
+		{
+			return iter->second;
+		}
+
+		if (mAgents->Ids.size() >= OVERFLOW_AGENT_INDEX)
+		{
+			return OVERFLOW_AGENT_INDEX;
+		}
+	}
+
+	if (mAgents == nullptr)
+	{
+		mAgents = std::make_shared<AgentTable>();
+	}
+	else if (shared_ptr_is_unique(mAgents) == false)
+	{
+		mAgents = std::make_shared<AgentTable>(*mAgents);
+	}
+
+	uint16_t index = static_cast<uint16_t>(mAgents->Ids.size());
+	mAgents->Ids.emplace_back(pAgentId);
+	mAgents->Indices.emplace(pAgentId, index);
+	return index;
+}
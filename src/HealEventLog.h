@@ -0,0 +1,366 @@
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <compare>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct HealEvent
+{
+	const uint64_t Time = 0;
+	const uint64_t Size = 0;
+	const uintptr_t AgentId = 0;
+	const uint32_t SkillId = 0;
+	const bool IsBarrier = false;
+
+	HealEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier);
+
+	bool operator==(const HealEvent& pRight) const;
+	bool operator!=(const HealEvent& pRight) const;
+};
+
+// Append-only log of heal events with value semantics and copy-on-write storage. Events are stored in fixed size chunks
+// that are shared between copies and never move or change once written, so copying a log only copies a pointer to
+// the chunk list and the length, and appending never has to move existing events (unlike std::vector reallocating).
+// Appending to a log never touches events visible through another copy - if the slot after the end of the log was
+// already used by another copy, the last (partially filled) chunk is copied first.
+//
+// Chunks store the events column by column in a compact form (15 bytes per event instead of 40 for HealEvent):
+// - Time as a signed 32-bit offset from the time of the first event in the log
+// - Size as 32 bits (heals and barrier are far below that)
+// - Agent id as a 16-bit index into a per-log agent table
+// - Skill id and a flags byte
+// Indexing and iterating returns HealEvent values, scans that want to use the columns directly can use GetChunk.
+//
+// The log tracks whether events were appended in time order (IsSorted). While they were, the events up to some time are
+// a prefix of the log that can be found with a binary search (UpperBound) instead of checking every event.
+//
+// A single log must not be appended to concurrently, but different copies of the same log can be read and appended
+// to from different threads.
+class HealEventLog
+{
+public:
+	constexpr static size_t CHUNK_SIZE = 4096;
+	constexpr static uint16_t OVERFLOW_AGENT_INDEX = UINT16_MAX; // Used for every agent after the first 65535 (maps to agent id 0)
+
+	enum EventFlags : uint8_t
+	{
+		EventFlags_IsBarrier = 1 << 0
+	};
+
+	struct ColumnChunk
+	{
+		const int32_t* TimeOffsets; // Relative to GetBaseTime()
+		const uint32_t* Sizes;
+		const uint32_t* SkillIds;
+		const uint16_t* AgentIndices; // See GetAgentId()
+		const uint8_t* Flags; // EventFlags
+		size_t Count;
+	};
+
+private:
+	struct Chunk;
+	using ChunkList = std::vector<std::shared_ptr<Chunk>>;
+
+public:
+	// Random access iterator over HealEvent values. Stepping through the events only touches the chunk list when
+	// crossing into the next chunk. Like std::vector iterators, they are invalidated by appending to the log they came
+	// from (but not by appending to a copy of it).
+	class const_iterator
+	{
+	public:
+		struct ArrowProxy
+		{
+			HealEvent Event;
+			const HealEvent* operator->() const;
+		};
+
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = HealEvent;
+		using difference_type = std::ptrdiff_t;
+		using pointer = ArrowProxy;
+		using reference = HealEvent;
+
+		const_iterator() = default;
+		const_iterator(const HealEventLog* pLog, size_t pIndex);
+
+		reference operator*() const;
+		pointer operator->() const;
+		reference operator[](difference_type pOffset) const;
+
+		const_iterator& operator++();
+		const_iterator operator++(int);
+		const_iterator& operator--();
+		const_iterator operator--(int);
+		const_iterator& operator+=(difference_type pOffset);
+		const_iterator& operator-=(difference_type pOffset);
+		const_iterator operator+(difference_type pOffset) const;
+		const_iterator operator-(difference_type pOffset) const;
+		difference_type operator-(const const_iterator& pRight) const;
+
+		// Only iterators from the same log can be compared
+		std::strong_ordering operator<=>(const const_iterator& pRight) const;
+		bool operator==(const const_iterator& pRight) const;
+
+	private:
+		void Seek(size_t pIndex);
+
+		const HealEventLog* mLog = nullptr;
+		size_t mIndex = 0;
+		const Chunk* mChunk = nullptr; // Chunk containing mIndex (nullptr if mIndex is past the end of the last chunk)
+	};
+
+	HealEventLog() = default;
+
+	void emplace_back(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier);
+	void clear();
+
+	size_t size() const;
+	bool empty() const;
+	HealEvent operator[](size_t pIndex) const;
+	HealEvent back() const;
+
+	const_iterator begin() const;
+	const_iterator end() const;
+
+	bool operator==(const HealEventLog& pRight) const;
+	bool operator!=(const HealEventLog& pRight) const;
+
+	// True if pPrefix is an earlier state of this log (this log is pPrefix with zero or more events appended). Only
+	// detects it if both still share the storage of those events, so it can return false for logs with equal events
+	bool StartsWith(const HealEventLog& pPrefix) const;
+
+	// True if every event has a time greater than or equal to the event before it
+	bool IsSorted() const;
+	// Index of the first event at or after pFirst with a time greater than pTime. Can only be used if IsSorted()
+	size_t UpperBound(size_t pFirst, uint64_t pTime) const;
+
+	uint64_t GetBaseTime() const;
+	size_t GetChunkCount() const;
+	ColumnChunk GetChunk(size_t pChunkIndex) const; // Count is CHUNK_SIZE for every chunk except the last one
+	size_t GetAgentCount() const; // Agent indices are in the range [0, GetAgentCount()) or OVERFLOW_AGENT_INDEX
+	uintptr_t GetAgentId(uint16_t pAgentIndex) const;
+
+	// Bytes allocated for the events and agents of the log. Storage that is shared with copies of the log is counted in
+	// full by each of them
+	size_t GetMemoryUsage() const;
+
+private:
+	struct Chunk
+	{
+		// Number of slots that have been claimed by some copy of the log. Only slots below that are ever read
+		std::atomic_size_t Used = 0;
+
+		int32_t TimeOffsets[CHUNK_SIZE];
+		uint32_t Sizes[CHUNK_SIZE];
+		uint32_t SkillIds[CHUNK_SIZE];
+		uint16_t AgentIndices[CHUNK_SIZE];
+		uint8_t Flags[CHUNK_SIZE];
+
+		HealEvent Get(const HealEventLog& pLog, size_t pSlot) const;
+	};
+
+	struct AgentTable
+	{
+		std::vector<uintptr_t> Ids; // Indexed by agent index
+		std::unordered_map<uintptr_t, uint16_t> Indices;
+	};
+
+	uint16_t GetAgentIndex(uintptr_t pAgentId);
+
+	// Only modified in place if no copy of the log references them, otherwise they are copied before being modified
+	std::shared_ptr<ChunkList> mChunks;
+	std::shared_ptr<AgentTable> mAgents;
+
+	size_t mSize = 0;
+	uint64_t mBaseTime = 0;
+	uint64_t mLastTime = 0;
+	bool mIsSorted = true;
+};
+
+inline HealEvent HealEventLog::Chunk::Get(const HealEventLog& pLog, size_t pSlot) const
+{
+	return HealEvent{
+		pLog.mBaseTime + TimeOffsets[pSlot],
+		Sizes[pSlot],
+		pLog.GetAgentId(AgentIndices[pSlot]),
+		SkillIds[pSlot],
+		(Flags[pSlot] & EventFlags_IsBarrier) != 0};
+}
+
+inline size_t HealEventLog::size() const
+{
+	return mSize;
+}
+
+inline bool HealEventLog::empty() const
+{
+	return mSize == 0;
+}
+
+inline HealEvent HealEventLog::operator[](size_t pIndex) const
+{
+	return (*mChunks)[pIndex / CHUNK_SIZE]->Get(*this, pIndex % CHUNK_SIZE);
+}
+
+inline HealEvent HealEventLog::back() const
+{
+	return (*this)[mSize - 1];
+}
+
+inline HealEventLog::const_iterator HealEventLog::begin() const
+{
+	return const_iterator{this, 0};
+}
+
+inline HealEventLog::const_iterator HealEventLog::end() const
+{
+	return const_iterator{this, mSize};
+}
+
+inline bool HealEventLog::IsSorted() const
+{
+	return mIsSorted;
+}
+
+inline uint64_t HealEventLog::GetBaseTime() const
+{
+	return mBaseTime;
+}
+
+inline size_t HealEventLog::GetChunkCount() const
+{
+	return (mSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+inline size_t HealEventLog::GetAgentCount() const
+{
+	return (mAgents != nullptr) ? mAgents->Ids.size() : 0;
+}
+
+inline uintptr_t HealEventLog::GetAgentId(uint16_t pAgentIndex) const
+{
+	if (pAgentIndex == OVERFLOW_AGENT_INDEX)
+	{
+		return 0;
+	}
+	return mAgents->Ids[pAgentIndex];
+}
+
+inline const HealEvent* HealEventLog::const_iterator::ArrowProxy::operator->() const
+{
+	return &Event;
+}
+
+inline HealEventLog::const_iterator::const_iterator(const HealEventLog* pLog, size_t pIndex)
+	: mLog{pLog}
+{
+	Seek(pIndex);
+}
+
+inline void HealEventLog::const_iterator::Seek(size_t pIndex)
+{
+	mIndex = pIndex;
+
+	size_t chunkIndex = pIndex / CHUNK_SIZE;
+	if (mLog->mChunks != nullptr && chunkIndex < mLog->mChunks->size())
+	{
+		mChunk = (*mLog->mChunks)[chunkIndex].get();
+	}
+	else
+	{
+		mChunk = nullptr;
+	}
+}
+
+inline HealEventLog::const_iterator::reference HealEventLog::const_iterator::operator*() const
+{
+	return mChunk->Get(*mLog, mIndex % CHUNK_SIZE);
+}
+
+inline HealEventLog::const_iterator::pointer HealEventLog::const_iterator::operator->() const
+{
+	return ArrowProxy{**this};
+}
+
+inline HealEventLog::const_iterator::reference HealEventLog::const_iterator::operator[](difference_type pOffset) const
+{
+	return *(*this + pOffset);
+}
+
+inline HealEventLog::const_iterator& HealEventLog::const_iterator::operator++()
+{
+	mIndex++;
+	if (mIndex % CHUNK_SIZE == 0)
+	{
+		Seek(mIndex);
+	}
+	return *this;
+}
+
+inline HealEventLog::const_iterator HealEventLog::const_iterator::operator++(int)
+{
+	const_iterator result = *this;
+	++(*this);
+	return result;
+}
+
+inline HealEventLog::const_iterator& HealEventLog::const_iterator::operator--()
+{
+	if (mIndex % CHUNK_SIZE != 0 && mChunk != nullptr)
+	{
+		mIndex--;
+	}
+	else
+	{
+		Seek(mIndex - 1);
+	}
+	return *this;
+}
+
+inline HealEventLog::const_iterator HealEventLog::const_iterator::operator--(int)
+{
+	const_iterator result = *this;
+	--(*this);
+	return result;
+}
+
+inline HealEventLog::const_iterator& HealEventLog::const_iterator::operator+=(difference_type pOffset)
+{
+	Seek(mIndex + pOffset);
+	return *this;
+}
+
+inline HealEventLog::const_iterator& HealEventLog::const_iterator::operator-=(difference_type pOffset)
+{
+	Seek(mIndex - pOffset);
+	return *this;
+}
+
+inline HealEventLog::const_iterator HealEventLog::const_iterator::operator+(difference_type pOffset) const
+{
+	return const_iterator{mLog, mIndex + pOffset};
+}
+
+inline HealEventLog::const_iterator HealEventLog::const_iterator::operator-(difference_type pOffset) const
+{
+	return const_iterator{mLog, mIndex - pOffset};
+}
+
+inline HealEventLog::const_iterator::difference_type HealEventLog::const_iterator::operator-(const const_iterator& pRight) const
+{
+	return static_cast<difference_type>(mIndex) - static_cast<difference_type>(pRight.mIndex);
+}
+
+inline std::strong_ordering HealEventLog::const_iterator::operator<=>(const const_iterator& pRight) const
+{
+	return mIndex <=> pRight.mIndex;
+}
+
+inline bool HealEventLog::const_iterator::operator==(const const_iterator& pRight) const
+{
+	return mIndex == pRight.mIndex;
+}
@@ -0,0 +1,143 @@
+#include "HealEventTotals.h"
+
+#include "Utilities.h"
+
+#include <algorithm>
+#include <bit>
+
+void HealTotal::Add(uint64_t pSize, bool pIsBarrier)
+{
+	Hits += 1;
+	// Healing always contains the total of both healing and barrier (if enabled)
+	Healing += pSize;
+	if (pIsBarrier == true)
+	{
+		// For barrier hits, track the total barrier separately as a sub-total of healing.
+		Barrier += pSize;
+	}
+}
+
+HealTotal& HealTotal::operator+=(const HealTotal& pRight)
+{
+	Hits += pRight.Hits;
+	Healing += pRight.Healing;
+	Barrier += pRight.Barrier;
+	return *this;
+}
+
+void HealEventTotals::Add(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
+{
+	if (mTotals == nullptr)
+	{
+		mTotals = std::make_shared<Table>();
+	}
+	else if (shared_ptr_is_unique(mTotals) == false)
+	{
+		mTotals = std::make_shared<Table>(*mTotals);
+	}
+
+	mTotals->GetOrInsert(pAgentId, pSkillId).Add(pSize, pIsBarrier);
+
+	mEventCount++;
+	mHighestTime = (std::max)(mHighestTime, pTime);
+
+	if (mEventCount % CHECKPOINT_INTERVAL == 0)
+	{
+		// Shares the table with the checkpoint, the next added event copies it
+		mCheckpoints.emplace_back(Checkpoint{mEventCount, mHighestTime, mTotals});
+		ThinCheckpoints();
+	}
+}
+
+void HealEventTotals::clear()
+{
+	// Tables are left as they are since other copies might still be reading them
+	mTotals = nullptr;
+	mCheckpoints.clear();
+	mEventCount = 0;
+	mHighestTime = 0;
+}
+
+size_t HealEventTotals::GetEventCount() const
+{
+	return mEventCount;
+}
+
+size_t HealEventTotals::GetMemoryUsage() const
+{
+	size_t result = mCheckpoints.capacity() * sizeof(Checkpoint);
+	if (mTotals != nullptr)
+	{
+		result += mTotals->GetMemoryUsage();
+	}
+	for (const Checkpoint& checkpoint : mCheckpoints)
+	{
+		// The latest checkpoint shares its table with the running totals until the next event is added
+		if (checkpoint.Totals != nullptr && checkpoint.Totals != mTotals)
+		{
+			result += checkpoint.Totals->GetMemoryUsage();
+		}
+	}
+	return result;
+}
+
+HealEventTotals::Checkpoint HealEventTotals::GetTotalsUntil(uint64_t pTime) const
+{
+	if (mHighestTime <= pTime)
+	{
+		return Checkpoint{mEventCount, mHighestTime, mTotals};
+	}
+
+	// HighestTime never decreases between checkpoints, so the checkpoints that qualify are a prefix of the list
+	auto iter = std::upper_bound(mCheckpoints.begin(), mCheckpoints.end(), pTime,
+		[](uint64_t pLeft, const Checkpoint& pRight)
+		{
+			return pLeft < pRight.HighestTime;
+		});
+	if (iter == mCheckpoints.begin())
+	{
+		return Checkpoint{};
+	}
+
+	return *(iter - 1);
+}
+
+void HealEventTotals::ThinCheckpoints()
+{
+	// Checkpoint i (counting in intervals) with age a (in intervals behind the latest one) is kept if i is a multiple of
+	// 2^level, where level grows by one every time the age doubles past RECENT_CHECKPOINTS * 2. The level of a checkpoint
+	// only grows with its age, so a dropped checkpoint would not have been kept later either
+	const size_t latest = mEventCount / CHECKPOINT_INTERVAL;
+	std::erase_if(mCheckpoints, [latest](const Checkpoint& pCheckpoint)
+		{
+			const size_t index = pCheckpoint.EventCount / CHECKPOINT_INTERVAL;
+			const size_t level = (std::max)(static_cast<size_t>(std::bit_width((latest - index) / RECENT_CHECKPOINTS)), size_t{1}) - 1;
+			return (index & ((size_t{1} << level) - 1)) != 0;
+		});
+}
+
+uint64_t HealEventTotals::KeyHash::operator()(const Key& pKey) const
+{
+	return (static_cast<uint64_t>(pKey.AgentId) * 0x9E3779B97F4A7C15ULL) ^ (static_cast<uint64_t>(pKey.SkillId) * 0xC2B2AE3D27D4EB4FULL);
+}
+
+HealTotal& HealEventTotals::Table::GetOrInsert(uintptr_t pAgentId, uint32_t pSkillId)
+{
+	auto [index, inserted] = Keys.Insert(Key{pAgentId, pSkillId});
+	if (inserted == true)
+	{
+		Totals.emplace_back();
+	}
+
+	return Totals[index];
+}
+
+size_t HealEventTotals::Table::size() const
+{
+	return Totals.size();
+}
+
+size_t HealEventTotals::Table::GetMemoryUsage() const
+{
+	return sizeof(Table) + Keys.GetMemoryUsage() + Totals.capacity() * sizeof(HealTotal);
+}
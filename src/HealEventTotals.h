@@ -0,0 +1,100 @@
+#pragma once
+#include "DenseIndexMap.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+struct HealTotal
+{
+	uint64_t Hits = 0;
+	uint64_t Healing = 0; // Contains the total of both healing and barrier
+	uint64_t Barrier = 0;
+
+	void Add(uint64_t pSize, bool pIsBarrier);
+	HealTotal& operator+=(const HealTotal& pRight);
+
+	bool operator==(const HealTotal& pRight) const = default;
+};
+
+// Running totals of heal events per <agent, skill>, kept up to date as events are added to a HealEventLog so that
+// aggregating a snapshot costs O(distinct <agent, skill> pairs) instead of O(events).
+//
+// The running totals include every event added so far. Aggregation usually wants totals up to the end of combat, which
+// can be earlier than the latest event (events after leaving combat, or after the last damage event). For that case a
+// checkpoint of the totals is taken every CHECKPOINT_INTERVAL events - starting from the latest checkpoint where all
+// included events happened before the cutoff, only the events added after that checkpoint have to be scanned.
+//
+// The combat end is almost always close to the latest event, so older checkpoints are thinned out: the last
+// RECENT_CHECKPOINTS * 2 are all kept, and going further back the gap between kept checkpoints doubles every time
+// their age doubles. That keeps O(RECENT_CHECKPOINTS * log(events)) tables, and the events to scan for a cutoff
+// further back are still at most about 1 / RECENT_CHECKPOINTS of the events since that cutoff.
+//
+// Copies share the tables copy-on-write (same rules as HealEventLog), so taking a snapshot is cheap.
+class HealEventTotals
+{
+public:
+	constexpr static size_t CHECKPOINT_INTERVAL = 4096;
+	constexpr static size_t RECENT_CHECKPOINTS = 4;
+
+	struct Key
+	{
+		uintptr_t AgentId;
+		uint32_t SkillId;
+
+		bool operator==(const Key& pRight) const = default;
+	};
+
+	struct KeyHash
+	{
+		uint64_t operator()(const Key& pKey) const;
+	};
+
+	struct Table
+	{
+		DenseIndexMap<Key, KeyHash> Keys; // Keys in the order they were first added
+		std::vector<HealTotal> Totals; // Indexed like Keys
+
+		HealTotal& GetOrInsert(uintptr_t pAgentId, uint32_t pSkillId);
+		size_t size() const;
+		size_t GetMemoryUsage() const; // Bytes allocated for the table
+	};
+
+	struct Checkpoint
+	{
+		size_t EventCount = 0; // Totals include the first EventCount events
+		uint64_t HighestTime = 0; // Highest time of those events
+		std::shared_ptr<const Table> Totals; // nullptr if EventCount is 0
+	};
+
+	void Add(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier);
+	void clear();
+
+	size_t GetEventCount() const;
+	size_t GetMemoryUsage() const; // Bytes allocated for the running totals and the checkpoints
+
+	// Returns the latest state (running totals or a checkpoint) where every included event has time <= pTime. Events
+	// after Checkpoint::EventCount have to be scanned to get the complete totals up to pTime.
+	Checkpoint GetTotalsUntil(uint64_t pTime) const;
+
+private:
+	void ThinCheckpoints(); // Drops the checkpoints that are too close to the next older one for their age
+
+	// Only modified in place if no copy references it, otherwise it is copied before being modified
+	std::shared_ptr<Table> mTotals;
+	std::vector<Checkpoint> mCheckpoints;
+
+	size_t mEventCount = 0;
+	uint64_t mHighestTime = 0;
+};
+
+// Totals of a finished encounter whose events might not be kept anymore (see EncounterHistory). Aggregating only needs
+// the totals up to the combat end, and once the encounter is over there is only one possible combat end per
+// CombatEndCondition, so the totals up to each of those are kept instead of the events.
+struct FrozenTotals
+{
+	uint64_t LastEventTime = 0; // Time of the last event, 0 if there were none
+	std::map<uint64_t, std::shared_ptr<const HealEventTotals::Table>> Until; // <combat end, totals of the events up to it>
+};
@@ -0,0 +1,182 @@
+#include "MappedFile.h"
+
+#include "Log.h"
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Create(const char* pPath, size_t pSize)
+{
+	Close();
+
+#ifdef LINUX
+	mFile = open(pPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (mFile == -1)
+	{
+		LogW("Creating {} failed - errno {}", pPath, errno);
+		return false;
+	}
+#elif defined(_WIN32)
+	mFile = CreateFileA(pPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		LogW("Creating {} failed - error {}", pPath, GetLastError());
+		return false;
+	}
+#endif
+
+	return Resize(pSize);
+}
+
+bool MappedFile::Resize(size_t pSize)
+{
+	Unmap();
+	mSize = pSize;
+
+#ifdef LINUX
+	if (ftruncate(mFile, static_cast<off_t>(mSize)) != 0)
+	{
+		LogW("Resizing file to {} bytes failed - errno {}", mSize, errno);
+		Close();
+		return false;
+	}
+#elif defined(_WIN32)
+	// Mapping the file grows it, but only shrinking through the file handle works
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(mSize);
+	if (SetFilePointerEx(mFile, size, nullptr, FILE_BEGIN) == FALSE || SetEndOfFile(mFile) == FALSE)
+	{
+		LogW("Resizing file to {} bytes failed - error {}", mSize, GetLastError());
+		Close();
+		return false;
+	}
+#endif
+
+	if (Map() == false)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Flush()
+{
+	if (mData == nullptr)
+	{
+		return;
+	}
+
+#ifdef LINUX
+	msync(mData, mSize, MS_ASYNC);
+#elif defined(_WIN32)
+	FlushViewOfFile(mData, 0);
+#endif
+}
+
+void MappedFile::Close()
+{
+	Unmap();
+	mSize = 0;
+
+#ifdef LINUX
+	if (mFile != -1)
+	{
+		close(mFile);
+		mFile = -1;
+	}
+#elif defined(_WIN32)
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#endif
+}
+
+bool MappedFile::IsOpen() const
+{
+#ifdef LINUX
+	return mFile != -1;
+#elif defined(_WIN32)
+	return mFile != INVALID_HANDLE_VALUE;
+#endif
+}
+
+uint8_t* MappedFile::data() const
+{
+	return mData;
+}
+
+size_t MappedFile::size() const
+{
+	return mSize;
+}
+
+bool MappedFile::Map()
+{
+	if (mSize == 0)
+	{
+		return true; // Empty files can't be mapped, there is nothing to write to anyway
+	}
+
+#ifdef LINUX
+	void* data = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+	if (data == MAP_FAILED)
+	{
+		LogW("Mapping {} bytes failed - errno {}", mSize, errno);
+		return false;
+	}
+	mData = static_cast<uint8_t*>(data);
+#elif defined(_WIN32)
+	const uint64_t size = mSize;
+	mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), nullptr);
+	if (mMapping == nullptr)
+	{
+		LogW("Creating mapping of {} bytes failed - error {}", mSize, GetLastError());
+		return false;
+	}
+
+	mData = static_cast<uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, mSize));
+	if (mData == nullptr)
+	{
+		LogW("Mapping {} bytes failed - error {}", mSize, GetLastError());
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+void MappedFile::Unmap()
+{
+#ifdef LINUX
+	if (mData != nullptr)
+	{
+		munmap(mData, mSize);
+	}
+#elif defined(_WIN32)
+	if (mData != nullptr)
+	{
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+#endif
+
+	mData = nullptr;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Writable file that is mapped into memory in full. Writes to the mapping end up in the file even if the process
+// crashes right after (the operating system owns the mapped pages), Flush is only needed to survive the operating
+// system going down as well.
+//
+// Growing or shrinking the file maps it again, which invalidates every pointer returned by data().
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile& operator=(MappedFile&&) = delete;
+
+	// Creates the file (replacing an existing one) with pSize zero bytes and maps it. Returns false if that failed
+	bool Create(const char* pPath, size_t pSize);
+	// Resizes the file to pSize bytes, added bytes are zero. Returns false (and closes the file) if that failed
+	bool Resize(size_t pSize);
+	// Starts writing the changed pages to disk, doesn't wait for it to finish
+	void Flush();
+	void Close();
+
+	bool IsOpen() const;
+	uint8_t* data() const;
+	size_t size() const;
+
+private:
+	bool Map(); // Maps mSize bytes of the file
+	void Unmap();
+
+#ifdef LINUX
+	int mFile = -1;
+#elif defined(_WIN32)
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#endif
+
+	uint8_t* mData = nullptr;
+	size_t mSize = 0;
+};
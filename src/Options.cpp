@@ -322,6 +322,13 @@ void HealTableOptions::FromJson(const nlohmann::json& pJsonObject)
 	GetJsonValue(pJsonObject, "EvtcRpcBudgetMode", EvtcRpcBudgetMode);
 	GetJsonValue(pJsonObject, "EvtcRpcEnabledHotkey", EvtcRpcEnabledHotkey);
 	GetJsonValue(pJsonObject, "IncludeBarrier", IncludeBarrier);
+	GetJsonValue(pJsonObject, "OffloadCombatCallbacks", OffloadCombatCallbacks);
+	GetJsonValue(pJsonObject, "RefreshIntervalMs", RefreshIntervalMs);
+	GetJsonValue(pJsonObject, "EncounterHistoryCount", EncounterHistoryCount);
+	GetJsonValue(pJsonObject, "EncounterHistoryBudgetMb", EncounterHistoryBudgetMb);
+	GetJsonValue(pJsonObject, "EncounterHistoryKeepEvents", EncounterHistoryKeepEvents);
+	GetJsonValue(pJsonObject, "EncounterJournalEnabled", EncounterJournalEnabled);
+	GetJsonValue(pJsonObject, "PeerMemoryBudgetMb", PeerMemoryBudgetMb);
 
 	const auto iter = pJsonObject.find("Windows");
 	if (iter != pJsonObject.end())
@@ -381,6 +388,13 @@ do {\
 	SET_JSON_VAL(EvtcRpcBudgetMode);
 	SET_JSON_VAL(EvtcRpcEnabledHotkey);
 	SET_JSON_VAL(IncludeBarrier);
+	SET_JSON_VAL(OffloadCombatCallbacks);
+	SET_JSON_VAL(RefreshIntervalMs);
+	SET_JSON_VAL(EncounterHistoryCount);
+	SET_JSON_VAL(EncounterHistoryBudgetMb);
+	SET_JSON_VAL(EncounterHistoryKeepEvents);
+	SET_JSON_VAL(EncounterJournalEnabled);
+	SET_JSON_VAL(PeerMemoryBudgetMb);
 
 	nlohmann::json windows;
 	for (size_t i = 0; i < Windows.size(); i++)
@@ -445,6 +459,7 @@ void HealWindowOptions::FromJson(const nlohmann::json& pJsonObject)
 	GetJsonValue(pJsonObject, "MaxNameLength", MaxNameLength);
 	GetJsonValue(pJsonObject, "MinLinesDisplayed", MinLinesDisplayed);
 	GetJsonValue(pJsonObject, "MaxLinesDisplayed", MaxLinesDisplayed);
+	GetJsonValue(pJsonObject, "TopEntriesOnly", TopEntriesOnly);
 	GetJsonValue(pJsonObject, "FixedWindowWidth", FixedWindowWidth);
 }
 
@@ -498,6 +513,7 @@ do {\
 	SET_JSON_VAL(MaxNameLength);
 	SET_JSON_VAL(MinLinesDisplayed);
 	SET_JSON_VAL(MaxLinesDisplayed);
+	SET_JSON_VAL(TopEntriesOnly);
 	SET_JSON_VAL(FixedWindowWidth);
 #undef SET_JSON_VAL
 #undef SET_JSON_VAL_CSTR_ARRAY
@@ -37,8 +37,7 @@ struct DetailsWindowState : AggregatedStatsEntry
 
 struct HealWindowContext : HealWindowOptions
 {
-	std::unique_ptr<AggregatedStatsCollection> CurrentAggregatedStats; // In-Memory only
-	time_t LastAggregatedTime = 0; // In-Memory only
+	std::shared_ptr<AggregatedStatsCollection> CurrentAggregatedStats; // In-Memory only, published by AggregationWorker
 
 	std::vector<DetailsWindowState> OpenSkillWindows; // In-Memory only
 	std::vector<DetailsWindowState> OpenAgentWindows; // In-Memory only
@@ -48,8 +47,12 @@ struct HealWindowContext : HealWindowOptions
 
 	float LastFrameMinWidth = 0.0f; // In-Memory only
 	size_t CurrentFrameLineCount = 0; // In-Memory only
+
+	uint64_t SelectedEncounterId = 0; // In-Memory only, past encounter (EncounterHistory) shown in the window, 0 for the current one
 };
 
+constexpr static size_t MIN_REFRESH_INTERVAL_MS = 50;
+
 struct HealTableOptions
 {
 	AutoUpdateSettingEnum AutoUpdateSetting = AutoUpdateSettingEnum::On;
@@ -58,6 +61,13 @@ struct HealTableOptions
 	spdlog::level::level_enum LogLevel = spdlog::level::off;
 
 	bool EvtcLoggingEnabled = true;
+	bool OffloadCombatCallbacks = false; // Only read on startup
+	size_t RefreshIntervalMs = 1000;
+	size_t EncounterHistoryCount = 5; // Number of past encounters that are kept, 0 to keep none
+	size_t EncounterHistoryBudgetMb = 64;
+	bool EncounterHistoryKeepEvents = false;
+	bool EncounterJournalEnabled = true; // Only read on startup
+	size_t PeerMemoryBudgetMb = 256; // 0 for no limit
 
 	char EvtcRpcEndpoint[128] = "evtc-rpc.kappa322.com:443";
 	bool EvtcRpcEnabled = false;
@@ -1,33 +1,41 @@
 #include "PlayerStats.h"
 
+#include "EncounterJournal.h"
 #include "Log.h"
-#include "Utilities.h"
 
 #include <assert.h>
-#include <Windows.h>
 
-HealEvent::HealEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
-	: Time{ pTime }
-	, Size{ pSize }
-	, AgentId{ pAgentId }
-	, SkillId{ pSkillId }
-	, IsBarrier{ pIsBarrier }
+#include <algorithm>
+
+bool HealingStatsSlim::IsOutOfCombat()
 {
+	return EnteredCombatTime == 0 || ExitedCombatTime != 0;
 }
 
-bool HealEvent::operator==(const HealEvent& pRight) const
+void HealingStatsSlim::AddEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
 {
-	return std::tie(Time, Size, AgentId, SkillId, IsBarrier) == std::tie(pRight.Time, pRight.Size, pRight.AgentId, pRight.SkillId, pRight.IsBarrier);
+	bool wasSorted = Events.IsSorted();
+	Events.emplace_back(pTime, pSize, pAgentId, pSkillId, pIsBarrier);
+	if (wasSorted == true && Events.IsSorted() == false)
+	{
+		LogD("Heal event arrived out of order (time {}, latest time {}), aggregation falls back to checking every event", pTime, Events[Events.size() - 2].Time);
+	}
+	Totals.Add(pTime, pSize, pAgentId, pSkillId, pIsBarrier);
+	Rolling.Add(pTime, pSize, pAgentId, pSkillId, pIsBarrier);
 }
 
-bool HealEvent::operator!=(const HealEvent& pRight) const
+void HealingStatsSlim::ClearEvents()
 {
-	return (*this == pRight) == false;
+	Events.clear();
+	Totals.clear();
+	Rolling.clear();
 }
 
-bool HealingStatsSlim::IsOutOfCombat()
+void PlayerStats::SetJournal(std::shared_ptr<EncounterJournal> pJournal, uint64_t pPlayerId)
 {
-	return EnteredCombatTime == 0 || ExitedCombatTime != 0;
+	std::lock_guard<std::mutex> lock(myLock);
+	myJournal = std::move(pJournal);
+	myJournalPlayerId = pPlayerId;
 }
 
 void PlayerStats::EnteredCombat(uint64_t pTime, uint16_t pSubGroup)
@@ -40,9 +48,14 @@ void PlayerStats::EnteredCombat(uint64_t pTime, uint16_t pSubGroup)
 		myStats.ExitedCombatTime = 0;
 		myStats.LastDamageEvent = 0;
 
-		myStats.Events.clear();
+		myStats.ClearEvents();
 		myStats.SubGroup = pSubGroup;
 
+		if (myJournal != nullptr)
+		{
+			myJournal->EnteredCombat(myJournalPlayerId, pTime, pSubGroup);
+		}
+
 		LOG("Entered combat, time is %llu, subgroup is %hu", pTime, pSubGroup);
 	}
 	else
@@ -70,6 +83,11 @@ uint64_t PlayerStats::ExitedCombat(uint64_t pTime, uint64_t pLastDamageEventTime
 	myStats.ExitedCombatTime = pTime;
 	myStats.LastDamageEvent = std::max(myStats.LastDamageEvent, pLastDamageEventTime);
 
+	if (myJournal != nullptr)
+	{
+		myJournal->ExitedCombat(myJournalPlayerId, pTime, myStats.LastDamageEvent);
+	}
+
 	LogI("EnteredCombatTime={} ExitedCombatTime={} LastDamageEvent={} EventCount={} pLastDamageEventTime={}",
 		myStats.EnteredCombatTime, myStats.ExitedCombatTime, myStats.LastDamageEvent, myStats.Events.size(), pLastDamageEventTime);
 
@@ -86,7 +104,12 @@ bool PlayerStats::ResetIfNotInCombat()
 		myStats.EnteredCombatTime = 0;
 		myStats.ExitedCombatTime = 0;
 		myStats.LastDamageEvent = 0;
-		myStats.Events.clear();
+		myStats.ClearEvents();
+
+		if (myJournal != nullptr)
+		{
+			myJournal->Reset(myJournalPlayerId);
+		}
 
 		return true;
 	}
@@ -126,7 +149,8 @@ void PlayerStats::HealingEvent(cbtevent* pEvent, uintptr_t pDestinationAgentId)
 			return;
 		}
 
-		myStats.Events.emplace_back(pEvent->time, healedAmount, pDestinationAgentId, pEvent->skillid, false);
+		AddEvent(pEvent->time, healedAmount, pDestinationAgentId, pEvent->skillid, false);
+		JournalEvents(myStats.Events.size() - 1);
 	}
 }
 
@@ -148,10 +172,61 @@ void PlayerStats::BarrierEvent(cbtevent* pEvent, uintptr_t pDestinationAgentId)
 			return;
 		}
 
-		myStats.Events.emplace_back(pEvent->time, barrierAmount, pDestinationAgentId, pEvent->skillid, true);
+		AddEvent(pEvent->time, barrierAmount, pDestinationAgentId, pEvent->skillid, true);
+		JournalEvents(myStats.Events.size() - 1);
 	}
 }
 
+void PlayerStats::HealingEvents(std::span<const std::pair<cbtevent*, uintptr_t>> pEvents)
+{
+	if (pEvents.empty() == true)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(myLock);
+
+	if (myStats.IsOutOfCombat() == true)
+	{
+		LOG("%zu events before combat enter, first %llu", pEvents.size(), pEvents.front().first->time);
+		return;
+	}
+
+	const size_t first = myStats.Events.size();
+	for (const auto& [event, destinationAgentId] : pEvents)
+	{
+		uint32_t amount = event->value;
+		if (amount == 0)
+		{
+			amount = event->buff_dmg;
+			assert(amount != 0);
+		}
+
+		AddEvent(event->time, amount, destinationAgentId, event->skillid, event->is_shields != 0);
+	}
+
+	// The whole batch goes into the journal at once
+	JournalEvents(first);
+}
+
+void PlayerStats::Touch(uint64_t pReceiveTime)
+{
+	std::lock_guard<std::mutex> lock(myLock);
+	myLastActivityTime = std::max(myLastActivityTime, pReceiveTime);
+}
+
+PlayerStatsUsage PlayerStats::GetUsage()
+{
+	std::lock_guard<std::mutex> lock(myLock);
+
+	PlayerStatsUsage result;
+	result.EventLogBytes = myStats.Events.GetMemoryUsage();
+	result.TotalBytes = sizeof(PlayerStats) + result.EventLogBytes + myStats.Totals.GetMemoryUsage() + myStats.Rolling.GetMemoryUsage();
+	result.LastActivityTime = myLastActivityTime;
+	result.IsOutOfCombat = myStats.IsOutOfCombat();
+	return result;
+}
+
 HealingStatsSlim PlayerStats::GetState()
 {
 	std::lock_guard<std::mutex> lock(myLock);
@@ -159,3 +234,16 @@ HealingStatsSlim PlayerStats::GetState()
 	HealingStatsSlim result{ myStats };
 	return result;
 }
+
+void PlayerStats::AddEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
+{
+	myStats.AddEvent(pTime, pSize, pAgentId, pSkillId, pIsBarrier);
+}
+
+void PlayerStats::JournalEvents(size_t pFirst)
+{
+	if (myJournal != nullptr)
+	{
+		myJournal->Heals(myJournalPlayerId, myStats.Events.begin() + static_cast<ptrdiff_t>(pFirst), myStats.Events.end());
+	}
+}
@@ -1,26 +1,19 @@
 #pragma once
-#include "arcdps_structs.h"
+#include "arcdps_structs_slim.h"
+#include "HealEventLog.h"
+#include "HealEventTotals.h"
+#include "RollingHealing.h"
 
 #include <stdint.h>
 
 #include <map>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <string>
 #include <vector>
 
-struct HealEvent
-{
-	const uint64_t Time = 0;
-	const uint64_t Size = 0;
-	const uintptr_t AgentId = 0;
-	const uint32_t SkillId = 0;
-	const bool IsBarrier = false;
-
-	HealEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier);
-
-	bool operator==(const HealEvent& pRight) const;
-	bool operator!=(const HealEvent& pRight) const;
-};
+class EncounterJournal;
 
 struct HealingStatsSlim
 {
@@ -29,9 +22,21 @@ struct HealingStatsSlim
 	uint64_t LastDamageEvent = 0;
 	uint16_t SubGroup = 0;
 
-	std::vector<HealEvent> Events; // Really this should be some segmented vector, will probably write one if it becomes a pain point
+	HealEventLog Events; // Copying only copies a reference to the events, so taking a snapshot of the state is cheap
+	HealEventTotals Totals; // Running totals of Events
+	RollingHealing Rolling; // Totals of the last seconds of Events
 
 	bool IsOutOfCombat();
+	void AddEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier); // Adds to Events, Totals and Rolling
+	void ClearEvents();
+};
+
+struct PlayerStatsUsage
+{
+	size_t EventLogBytes = 0; // Estimated bytes held by the event log
+	size_t TotalBytes = 0; // Estimated bytes held by the event log, the totals and the rolling totals together
+	uint64_t LastActivityTime = 0; // Latest time passed to PlayerStats::Touch, 0 if there was none
+	bool IsOutOfCombat = true;
 };
 
 class PlayerStats
@@ -39,6 +44,10 @@ class PlayerStats
 public:
 	PlayerStats() = default;
 
+	// Every change to the stats from now on is also written to pJournal (nullptr to stop journaling), as the player
+	// pPlayerId
+	void SetJournal(std::shared_ptr<EncounterJournal> pJournal, uint64_t pPlayerId);
+
 	void EnteredCombat(uint64_t pTime, uint16_t pSubGroup);
 
 	// Returns last damage event time (or 0 if combat wasn't really exited)
@@ -48,11 +57,25 @@ public:
 	void DamageEvent(uint64_t pTime);
 	void HealingEvent(cbtevent* pEvent, uintptr_t pDestinationAgentId);
 	void BarrierEvent(cbtevent* pEvent, uintptr_t pDestinationAgentId);
+	// Equivalent to calling HealingEvent or BarrierEvent (depending on is_shields) for every <event, destination agent
+	// id> pair, but only takes the lock once
+	void HealingEvents(std::span<const std::pair<cbtevent*, uintptr_t>> pEvents);
 
-	HealingStatsSlim GetState();
+	// Marks the player as active at pReceiveTime. That is a local time of when its events were received - event times
+	// of peers come from their own clocks, so they can't be compared between peers
+	void Touch(uint64_t pReceiveTime);
+
+	HealingStatsSlim GetState(); // Only copies a reference to the events, not the events themselves
+	PlayerStatsUsage GetUsage();
 
 private:
+	void AddEvent(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier); // Needs myLock, doesn't journal
+	void JournalEvents(size_t pFirst); // Writes the events from index pFirst on to the journal. Needs myLock
+
 	std::mutex myLock;
 
 	HealingStatsSlim myStats;
+	uint64_t myLastActivityTime = 0; // Not cleared by resets, it's used to find peers that weren't seen in a while
+	std::shared_ptr<EncounterJournal> myJournal; // Protected by myLock
+	uint64_t myJournalPlayerId = 0; // Protected by myLock
 };
\ No newline at end of file
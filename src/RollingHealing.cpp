@@ -0,0 +1,56 @@
+#include "RollingHealing.h"
+
+#include "Utilities.h"
+
+void RollingHealing::Add(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier)
+{
+	const uint64_t index = pTime / BUCKET_WIDTH;
+	Bucket& bucket = mBuckets[index % BUCKET_COUNT];
+
+	if (bucket.Data == nullptr || bucket.Index < index)
+	{
+		// Bucket is empty or holds events from an earlier round of the ring, those are outside every window now
+		bucket.Index = index;
+		bucket.Data = std::make_shared<BucketData>();
+	}
+	else if (bucket.Index > index)
+	{
+		return; // Event is older than the ring
+	}
+	else if (shared_ptr_is_unique(bucket.Data) == false)
+	{
+		bucket.Data = std::make_shared<BucketData>(*bucket.Data);
+	}
+
+	HealEventTotals::Table& totals = bucket.Data->Totals;
+	auto [keyIndex, inserted] = totals.Keys.Insert(HealEventTotals::Key{pAgentId, pSkillId});
+	if (inserted == true)
+	{
+		totals.Totals.emplace_back();
+	}
+	totals.Totals[keyIndex].Add(pSize, pIsBarrier);
+
+	bucket.Data->Events.emplace_back(BucketEvent{pSize, keyIndex, static_cast<uint16_t>(pTime - index * BUCKET_WIDTH), pIsBarrier});
+}
+
+void RollingHealing::clear()
+{
+	// Tables are left as they are since other copies might still be reading them
+	for (Bucket& bucket : mBuckets)
+	{
+		bucket = Bucket{};
+	}
+}
+
+size_t RollingHealing::GetMemoryUsage() const
+{
+	size_t result = 0;
+	for (const Bucket& bucket : mBuckets)
+	{
+		if (bucket.Data != nullptr)
+		{
+			result += bucket.Data->Totals.GetMemoryUsage() + sizeof(bucket.Data->Events) + bucket.Data->Events.capacity() * sizeof(BucketEvent);
+		}
+	}
+	return result;
+}
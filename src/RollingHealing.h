@@ -0,0 +1,109 @@
+#pragma once
+#include "HealEventTotals.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// Totals per <agent, skill> of the last few seconds of heal events, for rolling window stats ("healing per second in
+// the last 5 seconds"). Events are added to time buckets of BUCKET_WIDTH ms in a ring of BUCKET_COUNT buckets, so a
+// rolling window sum only has to visit the buckets inside the window instead of the events - independent of how many
+// events there are or how long the fight is.
+//
+// Buckets also keep their events, so that the buckets at the edges of a window (which are only partially inside it) can
+// be clipped to the window exactly. Events that are older than the ring when they arrive are dropped.
+//
+// Copies share the buckets copy-on-write (same rules as HealEventTotals), so taking a snapshot is cheap.
+class RollingHealing
+{
+public:
+	constexpr static uint64_t BUCKET_WIDTH = 500; // ms
+	constexpr static size_t BUCKET_COUNT = 64; // Covers 32 seconds, enough for the longest window
+
+	constexpr static size_t WINDOW_COUNT = 3;
+	constexpr static std::array<uint64_t, WINDOW_COUNT> WINDOWS = {5000, 10000, 30000}; // ms
+
+	void Add(uint64_t pTime, uint64_t pSize, uintptr_t pAgentId, uint32_t pSkillId, bool pIsBarrier);
+	void clear();
+
+	size_t GetMemoryUsage() const; // Bytes allocated for the buckets, including ones that are outside every window by now
+
+	// Calls pFunction(uintptr_t pAgentId, uint32_t pSkillId, const HealTotal& pTotal) for the events in the pWindow ms
+	// up to and including pEnd (times in (pEnd - pWindow, pEnd]). Buckets that are completely inside the window are
+	// visited as totals, in the buckets at its edges every event inside the window is visited on its own. The same
+	// <agent, skill> pair can be visited many times
+	template <typename Function>
+	void ForEachTotal(uint64_t pEnd, uint64_t pWindow, Function&& pFunction) const;
+
+private:
+	struct BucketEvent
+	{
+		uint64_t Size;
+		uint32_t KeyIndex; // Index into Totals.Keys
+		uint16_t Offset; // Time since the start of the bucket
+		bool IsBarrier;
+	};
+
+	struct BucketData
+	{
+		HealEventTotals::Table Totals;
+		std::vector<BucketEvent> Events;
+	};
+
+	struct Bucket
+	{
+		uint64_t Index = 0; // Time / BUCKET_WIDTH of the events in the bucket
+		// Only modified in place if no copy references it, otherwise it is copied before being modified
+		std::shared_ptr<BucketData> Data;
+	};
+
+	std::array<Bucket, BUCKET_COUNT> mBuckets; // Bucket with index i is stored at mBuckets[i % BUCKET_COUNT]
+};
+
+template <typename Function>
+void RollingHealing::ForEachTotal(uint64_t pEnd, uint64_t pWindow, Function&& pFunction) const
+{
+	const uint64_t start = (pEnd >= pWindow) ? pEnd - pWindow + 1 : 0; // First time inside the window
+	const uint64_t endIndex = pEnd / BUCKET_WIDTH;
+	uint64_t startIndex = start / BUCKET_WIDTH;
+	if (endIndex - startIndex >= BUCKET_COUNT)
+	{
+		startIndex = endIndex + 1 - BUCKET_COUNT;
+	}
+
+	for (uint64_t index = startIndex; index <= endIndex; index++)
+	{
+		const Bucket& bucket = mBuckets[index % BUCKET_COUNT];
+		if (bucket.Data == nullptr || bucket.Index != index)
+		{
+			continue; // No events in that bucket (or only events that were overwritten since)
+		}
+
+		const std::vector<HealEventTotals::Key>& keys = bucket.Data->Totals.Keys.GetKeys();
+		const uint64_t bucketStart = index * BUCKET_WIDTH;
+		if (bucketStart >= start && bucketStart + BUCKET_WIDTH - 1 <= pEnd)
+		{
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				pFunction(keys[i].AgentId, keys[i].SkillId, bucket.Data->Totals.Totals[i]);
+			}
+			continue;
+		}
+
+		for (const BucketEvent& event : bucket.Data->Events)
+		{
+			const uint64_t time = bucketStart + event.Offset;
+			if (time < start || time > pEnd)
+			{
+				continue;
+			}
+
+			HealTotal total;
+			total.Add(event.Size, event.IsBarrier);
+			pFunction(keys[event.KeyIndex].AgentId, keys[event.KeyIndex].SkillId, total);
+		}
+	}
+}
@@ -77,6 +77,7 @@ struct HealWindowOptions
 	size_t MaxNameLength = 0;
 	size_t MinLinesDisplayed = 0;
 	size_t MaxLinesDisplayed = 10;
+	bool TopEntriesOnly = false; // Only aggregate the first MaxLinesDisplayed entries
 	size_t FixedWindowWidth = 400;
 
 	void FromJson(const nlohmann::json& pJsonObject);
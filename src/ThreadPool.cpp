@@ -0,0 +1,182 @@
+#include "ThreadPool.h"
+
+#include "Log.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+size_t ThreadPool::GetDefaultWorkerCount()
+{
+	size_t coreCount = std::thread::hardware_concurrency();
+	if (coreCount <= 1)
+	{
+		return 0;
+	}
+
+	return (std::min)(coreCount - 1, MAX_WORKER_COUNT);
+}
+
+ThreadPool::ThreadPool(size_t pWorkerCount)
+	: mShares{std::make_unique<Share[]>(pWorkerCount + 1)}
+	, mShareCount{pWorkerCount + 1}
+{
+	for (size_t i = 0; i < pWorkerCount; i++)
+	{
+		mWorkers.emplace_back(&ThreadPool::ThreadMain, this, i + 1);
+	}
+
+	LogD("Started thread pool with {} workers", pWorkerCount);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(mParallelForLock);
+		mShutdown.store(true, std::memory_order_relaxed);
+		mGeneration.fetch_add(1, std::memory_order_release);
+		mGeneration.notify_all();
+	}
+
+	for (std::thread& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t pCount, const std::function<void(size_t)>& pFunction)
+{
+	if (pCount == 0)
+	{
+		return;
+	}
+
+	if (mWorkers.empty() == true || pCount == 1)
+	{
+		for (size_t i = 0; i < pCount; i++)
+		{
+			pFunction(i);
+		}
+		return;
+	}
+
+	assert(pCount <= UINT32_MAX);
+
+	std::lock_guard lock(mParallelForLock);
+	assert(mBusyWorkers.load(std::memory_order_relaxed) == 0);
+
+	// Split the indices as evenly as possible, the first (pCount % mShareCount) shares get one extra index
+	size_t begin = 0;
+	for (size_t i = 0; i < mShareCount; i++)
+	{
+		size_t end = begin + pCount / mShareCount + ((i < pCount % mShareCount) ? 1 : 0);
+		mShares[i].Bounds.store((static_cast<uint64_t>(begin) << 32) | end, std::memory_order_relaxed);
+		begin = end;
+	}
+	assert(begin == pCount);
+
+	mFunction = &pFunction;
+	mBusyWorkers.store(static_cast<uint32_t>(mWorkers.size()), std::memory_order_relaxed);
+	mGeneration.fetch_add(1, std::memory_order_release);
+	mGeneration.notify_all();
+
+	RunShares(0);
+
+	// Every index was claimed by the time RunShares returns, but workers can still be running the ones they claimed
+	for (uint32_t busy = mBusyWorkers.load(std::memory_order_acquire); busy != 0; busy = mBusyWorkers.load(std::memory_order_acquire))
+	{
+		mBusyWorkers.wait(busy, std::memory_order_acquire);
+	}
+
+	mFunction = nullptr;
+}
+
+size_t ThreadPool::GetWorkerCount() const
+{
+	return mWorkers.size();
+}
+
+bool ThreadPool::TryTakeFront(size_t pShareIndex, size_t& pIndex)
+{
+	std::atomic_uint64_t& bounds = mShares[pShareIndex].Bounds;
+
+	uint64_t current = bounds.load(std::memory_order_relaxed);
+	while (true)
+	{
+		uint64_t begin = current >> 32;
+		uint64_t end = current & UINT32_MAX;
+		if (begin >= end)
+		{
+			return false;
+		}
+
+		if (bounds.compare_exchange_weak(current, ((begin + 1) << 32) | end, std::memory_order_relaxed) == true)
+		{
+			pIndex = static_cast<size_t>(begin);
+			return true;
+		}
+	}
+}
+
+bool ThreadPool::TryTakeBack(size_t pShareIndex, size_t& pIndex)
+{
+	std::atomic_uint64_t& bounds = mShares[pShareIndex].Bounds;
+
+	uint64_t current = bounds.load(std::memory_order_relaxed);
+	while (true)
+	{
+		uint64_t begin = current >> 32;
+		uint64_t end = current & UINT32_MAX;
+		if (begin >= end)
+		{
+			return false;
+		}
+
+		if (bounds.compare_exchange_weak(current, (begin << 32) | (end - 1), std::memory_order_relaxed) == true)
+		{
+			pIndex = static_cast<size_t>(end - 1);
+			return true;
+		}
+	}
+}
+
+void ThreadPool::RunShares(size_t pShareIndex)
+{
+	size_t index;
+	while (TryTakeFront(pShareIndex, index) == true)
+	{
+		(*mFunction)(index);
+	}
+
+	// Own share is done, help the others. Shares never grow, so one round over them is enough
+	for (size_t i = 1; i < mShareCount; i++)
+	{
+		size_t victim = (pShareIndex + i) % mShareCount;
+		while (TryTakeBack(victim, index) == true)
+		{
+			(*mFunction)(index);
+		}
+	}
+}
+
+void ThreadPool::ThreadMain(size_t pShareIndex)
+{
+	uint32_t seenGeneration = 0;
+	while (true)
+	{
+		mGeneration.wait(seenGeneration, std::memory_order_acquire);
+		seenGeneration = mGeneration.load(std::memory_order_acquire);
+
+		if (mShutdown.load(std::memory_order_relaxed) == true)
+		{
+			return;
+		}
+
+		RunShares(pShareIndex);
+
+		if (mBusyWorkers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			mBusyWorkers.notify_all();
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small pool of worker threads for splitting independent pieces of work across cores. ParallelFor gives every
+// participant (the workers plus the calling thread) a contiguous share of the indices. Each participant takes indices
+// from the front of its own share, and once that is empty it steals from the back of the other shares, so uneven
+// pieces of work still keep every thread busy until the end.
+//
+// Only one ParallelFor runs at a time, concurrent calls wait for each other. pFunction must not call ParallelFor.
+class ThreadPool
+{
+public:
+	constexpr static size_t MAX_WORKER_COUNT = 7;
+
+	// Worker count that leaves one core for the calling thread, at most MAX_WORKER_COUNT
+	static size_t GetDefaultWorkerCount();
+
+	ThreadPool(size_t pWorkerCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool& operator=(ThreadPool&&) = delete;
+
+	// Calls pFunction(i) exactly once for every i in [0, pCount) and returns once all calls have returned. The calling
+	// thread runs part of the work itself
+	void ParallelFor(size_t pCount, const std::function<void(size_t)>& pFunction);
+
+	size_t GetWorkerCount() const;
+
+private:
+	// Remaining indices of one participant's share, packed as (begin << 32) | end so that the owner taking from the
+	// front and thieves taking from the back can both claim an index with a single compare-exchange
+	struct alignas(64) Share
+	{
+		std::atomic_uint64_t Bounds = 0;
+	};
+
+	bool TryTakeFront(size_t pShareIndex, size_t& pIndex);
+	bool TryTakeBack(size_t pShareIndex, size_t& pIndex);
+	void RunShares(size_t pShareIndex);
+	void ThreadMain(size_t pShareIndex);
+
+	std::mutex mParallelForLock;
+	const std::function<void(size_t)>* mFunction = nullptr; // Only set while a ParallelFor is running
+
+	std::unique_ptr<Share[]> mShares; // Index 0 is the calling thread, index i is worker i - 1
+	size_t mShareCount;
+
+	std::atomic_uint32_t mGeneration = 0; // Incremented to start a ParallelFor on the workers
+	std::atomic_uint32_t mBusyWorkers = 0; // Workers that haven't finished the current ParallelFor yet
+	std::atomic_bool mShutdown = false;
+
+	std::vector<std::thread> mWorkers;
+};
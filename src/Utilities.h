@@ -4,11 +4,16 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 #include <algorithm>
 #include <array>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <optional>
 #include <variant>
@@ -54,6 +59,21 @@ double constexpr divide_safe(T pDividend, U pDivisor)
 	return static_cast<double>(pDividend) / static_cast<double>(pDivisor);
 }
 
+// For copy-on-write data where new references can only be created by the owner of pPointer: if nothing else references
+// the data right now, no other thread can start referencing it either and it can be modified in place. use_count() is a
+// relaxed load, the fence makes sure that whichever thread released the last other reference is done reading before
+// the data is modified.
+template <typename T>
+bool shared_ptr_is_unique(const std::shared_ptr<T>& pPointer)
+{
+	if (pPointer.use_count() == 1)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+	return false;
+}
+
 size_t constexpr constexpr_strlen(const char* pString)
 {
 	size_t result = 0;
@@ -78,6 +98,7 @@ struct LongestStringInArray<Array, 0>
 	constexpr const static uint64_t value = constexpr_strlen(Array[0]);
 };
 
+#ifdef _WIN32
 // Returns number of characters (as opposed to number of bytes) in a utf8 string
 static inline size_t utf8_strlen(std::string_view pString)
 {
@@ -132,6 +153,7 @@ static inline std::string VirtualKeyToString(int pVirtualKey)
 
 	return std::string{buffer};
 }
+#endif
 
 // Prints pNumber to pResultBuffer with magnitude suffix if necessary
 // Returns output with the same rules as snprintf
@@ -161,7 +183,8 @@ static inline int snprint_magnitude(char* pResultBuffer, size_t pResultBufferLen
 	return snprintf(pResultBuffer, pResultBufferLength, "%.1f%c", pNumber / pow(1000, magnitude), bases[magnitude - 1]);
 }
 
-// Replaces "{1}", "{2}", etc. with pArgs[0], pArgs[1], etc. If that argument is nullopt, the entry is not replaced.
+// Replaces "{1}", "{2}", ..., "{10}", etc. with pArgs[0], pArgs[1], etc. (keys are up to two digits). If that argument
+// is nullopt, the entry is not replaced.
 // Returns the amount of bytes written
 template<size_t ArgCount>
 static inline size_t ReplaceFormatted(char* pResultBuffer, size_t pResultBufferLength, const char* pFormatString, std::array<std::optional<std::variant<uint64_t, double>>, ArgCount> pArgs)
@@ -174,10 +197,17 @@ static inline size_t ReplaceFormatted(char* pResultBuffer, size_t pResultBufferL
 		if (*curChar == '{')
 		{
 			const char* key = curChar + 1;
-			const char* closeBrace = curChar + 2;
+			const char* closeBrace = key;
+			uint32_t num = 0;
+			while (closeBrace - key < 2 && *closeBrace >= '0' && *closeBrace <= '9')
+			{
+				num = num * 10 + (*closeBrace - '0');
+				closeBrace++;
+			}
+
 			if (*key >= '1' && *key <= '9' && *closeBrace == '}')
 			{
-				uint32_t num = *key - '1';
+				num -= 1;
 
 				if (pArgs.size() > num && pArgs[num].has_value() == true)
 				{
@@ -200,7 +230,7 @@ static inline size_t ReplaceFormatted(char* pResultBuffer, size_t pResultBufferL
 						break;
 					}
 
-					curChar += 2; // We've processed the braces as well
+					curChar = closeBrace; // We've processed the braces as well
 					pResultBuffer += count;
 					pResultBufferLength -= count;
 					continue;
@@ -1,5 +1,7 @@
 #include "AddonVersion.h"
 #include "arcdps_structs.h"
+#include "EncounterHistory.h"
+#include "EncounterJournal.h"
 #include "Exports.h"
 #include "GUI.h"
 #include "Log.h"
@@ -31,8 +33,11 @@ uintptr_t mod_combat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent,
 uintptr_t mod_combat_local(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
 uintptr_t mod_wnd(HWND pWindowHandle, UINT pMessage, WPARAM pAdditionalW, LPARAM pAdditionalL);
 
+uintptr_t ProcessAreaEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
+uintptr_t SequenceLocalEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
 uintptr_t ProcessLocalEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision);
 void ProcessPeerEvent(cbtevent* pEvent, uint16_t pPeerInstanceId);
+void ProcessPeerEventBatch(cbtevent* pEvents, size_t pEventCount, uint16_t pPeerInstanceId);
 
 void Hook_PostNewFrame(ImGuiContext* pImguiContext, ImGuiContextHook*);
 void Hook_PreEndFrame(ImGuiContext* pImguiContext, ImGuiContextHook*);
@@ -243,8 +248,12 @@ arcdps_exports* mod_init()
 
 	GlobalObjects::EVENT_SEQUENCER = std::make_unique<EventSequencer>(ProcessLocalEvent);
 	GlobalObjects::EVENT_PROCESSOR = std::make_unique<EventProcessor>();
-	GlobalObjects::EVTC_RPC_CLIENT = std::make_unique<evtc_rpc_client>(std::move(getEndpoint), std::move(getCertificates), std::function{ProcessPeerEvent});
+	GlobalObjects::AGGREGATION_THREAD_POOL = std::make_unique<ThreadPool>(ThreadPool::GetDefaultWorkerCount());
+	GlobalObjects::AGGREGATION_WORKER = std::make_unique<AggregationWorker>(*GlobalObjects::EVENT_PROCESSOR, GlobalObjects::AGGREGATION_THREAD_POOL.get());
+	GlobalObjects::EVTC_RPC_CLIENT = std::make_unique<evtc_rpc_client>(std::move(getEndpoint), std::move(getCertificates), std::function{ProcessPeerEvent}, std::function{ProcessPeerEventBatch});
 
+	bool encounterJournalEnabled = false;
+	size_t encounterHistoryCount = 0;
 	{
 		std::lock_guard lock(HEAL_TABLE_OPTIONS_MUTEX);
 		HEAL_TABLE_OPTIONS.Load(JSON_CONFIG_PATH);
@@ -253,6 +262,18 @@ arcdps_exports* mod_init()
 		GlobalObjects::EVENT_PROCESSOR->SetEvtcLoggingEnabled(HEAL_TABLE_OPTIONS.EvtcLoggingEnabled);
 		GlobalObjects::EVENT_PROCESSOR->SetUseBarrier(HEAL_TABLE_OPTIONS.IncludeBarrier);
 		GlobalObjects::EVTC_RPC_CLIENT->SetEnabledStatus(HEAL_TABLE_OPTIONS.EvtcRpcEnabled);
+		GlobalObjects::AGGREGATION_WORKER->SetRefreshInterval(std::chrono::milliseconds((std::max)(HEAL_TABLE_OPTIONS.RefreshIntervalMs, MIN_REFRESH_INTERVAL_MS)));
+		GlobalObjects::EVENT_PROCESSOR->GetEncounterHistory().SetLimits(HEAL_TABLE_OPTIONS.EncounterHistoryCount,
+			HEAL_TABLE_OPTIONS.EncounterHistoryBudgetMb * 1024 * 1024, HEAL_TABLE_OPTIONS.EncounterHistoryKeepEvents);
+		GlobalObjects::EVENT_PROCESSOR->SetPeerMemoryBudget(HEAL_TABLE_OPTIONS.PeerMemoryBudgetMb * 1024 * 1024);
+
+		encounterJournalEnabled = HEAL_TABLE_OPTIONS.EncounterJournalEnabled;
+		encounterHistoryCount = HEAL_TABLE_OPTIONS.EncounterHistoryCount;
+
+		if (HEAL_TABLE_OPTIONS.OffloadCombatCallbacks == true)
+		{
+			GlobalObjects::COMBAT_EVENT_QUEUE = std::make_unique<CombatEventQueue>();
+		}
 
 		if (HEAL_TABLE_OPTIONS.AutoUpdateSetting != AutoUpdateSettingEnum::Off)
 		{
@@ -262,6 +283,15 @@ arcdps_exports* mod_init()
 		}
 	}
 
+	// Read without holding the options lock, reading a large journal takes a while. Only as many encounters as the history
+	// keeps are recovered. The journal of the previous session has to be read before the new one replaces it
+	if (encounterJournalEnabled == true)
+	{
+		size_t recovered = GlobalObjects::EVENT_PROCESSOR->RecoverJournal(ENCOUNTER_JOURNAL_PATH, encounterHistoryCount);
+		LogI("Recovered {} encounters from the previous session", recovered);
+		GlobalObjects::EVENT_PROCESSOR->SetJournal(std::make_shared<EncounterJournal>(ENCOUNTER_JOURNAL_PATH));
+	}
+
 	GlobalObjects::EVTC_RPC_CLIENT_THREAD = std::make_unique<std::thread>(evtc_rpc_client::ThreadStartServe, GlobalObjects::EVTC_RPC_CLIENT.get());
 
 	LogI("Startup completed, arcdps_version={} healing_stats_version={} cpr_version={} curl_version={} grpc_version={} grpc_core_version={}",
@@ -272,7 +302,8 @@ arcdps_exports* mod_init()
 /* release mod -- return ignored */
 uintptr_t mod_release()
 {
-	LogD("Shutting down, sequencer={}, processor={}, client={} client_thread={}",
+	LogD("Shutting down, queue={}, sequencer={}, processor={}, client={} client_thread={}",
+		static_cast<void*>(GlobalObjects::COMBAT_EVENT_QUEUE.get()),
 		static_cast<void*>(GlobalObjects::EVENT_SEQUENCER.get()),
 		static_cast<void*>(GlobalObjects::EVENT_PROCESSOR.get()),
 		static_cast<void*>(GlobalObjects::EVTC_RPC_CLIENT.get()),
@@ -288,6 +319,16 @@ uintptr_t mod_release()
 		GlobalObjects::IS_SHUTDOWN = true;
 	}
 
+	// No more combat callbacks can come in at this point, handle whatever is still queued before tearing down
+	if (GlobalObjects::COMBAT_EVENT_QUEUE != nullptr)
+	{
+		GlobalObjects::COMBAT_EVENT_QUEUE->Shutdown();
+		GlobalObjects::COMBAT_EVENT_QUEUE = nullptr;
+	}
+
+	// Stop aggregating before tearing down the event processor and thread pool it uses
+	GlobalObjects::AGGREGATION_WORKER->Shutdown();
+
 	GlobalObjects::EVTC_RPC_CLIENT->Shutdown();
 
 	{
@@ -307,6 +348,8 @@ uintptr_t mod_release()
 	GlobalObjects::EVTC_RPC_CLIENT = nullptr;
 	GlobalObjects::EVENT_PROCESSOR = nullptr;
 	GlobalObjects::EVENT_SEQUENCER = nullptr;
+	GlobalObjects::AGGREGATION_WORKER = nullptr;
+	GlobalObjects::AGGREGATION_THREAD_POOL = nullptr;
 
 	LogI("Shutdown completed");
 	Log_::FlushLogFile();
@@ -372,9 +415,13 @@ uintptr_t mod_combat(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent,
 		return 1;
 	}
 
-	GlobalObjects::EVENT_PROCESSOR->AreaCombat(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
-	GlobalObjects::EVTC_RPC_CLIENT->ProcessAreaEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
-	return 0;
+	if (GlobalObjects::COMBAT_EVENT_QUEUE != nullptr)
+	{
+		GlobalObjects::COMBAT_EVENT_QUEUE->Push(ProcessAreaEvent, pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+		return 0;
+	}
+
+	return ProcessAreaEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
 }
 
 /* combat callback -- may be called asynchronously. return ignored */
@@ -388,6 +435,24 @@ uintptr_t mod_combat_local(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationA
 		return 1;
 	}
 
+	if (GlobalObjects::COMBAT_EVENT_QUEUE != nullptr)
+	{
+		GlobalObjects::COMBAT_EVENT_QUEUE->Push(SequenceLocalEvent, pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+		return 0;
+	}
+
+	return SequenceLocalEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+}
+
+uintptr_t ProcessAreaEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision)
+{
+	GlobalObjects::EVENT_PROCESSOR->AreaCombat(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+	GlobalObjects::EVTC_RPC_CLIENT->ProcessAreaEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+	return 0;
+}
+
+uintptr_t SequenceLocalEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision)
+{
 	GlobalObjects::EVENT_SEQUENCER->ProcessEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
 	return 0;
 }
@@ -412,6 +477,13 @@ void ProcessPeerEvent(cbtevent* pEvent, uint16_t pPeerInstanceId)
 	GlobalObjects::EVENT_PROCESSOR->PeerCombat(pEvent, pPeerInstanceId);
 }
 
+void ProcessPeerEventBatch(cbtevent* pEvents, size_t pEventCount, uint16_t pPeerInstanceId)
+{
+	assert(GlobalObjects::IS_SHUTDOWN == false); // Not atomic but that's fine, this is more of a sanity check
+
+	GlobalObjects::EVENT_PROCESSOR->PeerCombatBatch(std::span<cbtevent>{pEvents, pEventCount}, pPeerInstanceId);
+}
+
 #pragma pack(push, 1)
 struct ArcModifiers
 {
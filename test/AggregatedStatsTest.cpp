@@ -0,0 +1,829 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "AggregatedStats.h"
+#include "AggregatedStatsCollection.h"
+#include "DenseIndexMap.h"
+#include "HealEventTotals.h"
+#include "Log.h"
+#include "PlayerStats.h"
+#include "TestFights.h"
+#include "ThreadPool.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+// 10 minutes of healing a 50 player squad (plus minions) at 100 events per second, with 60 different skills
+HealingStats BuildSquadFight()
+{
+	std::mt19937_64 rng{50};
+
+	HealingStats result;
+	result.Skills = std::make_shared<SkillTable>();
+
+	const size_t agentCount = 75;
+	std::shared_ptr<AgentSnapshot> agents = std::make_shared<AgentSnapshot>();
+	for (size_t i = 1; i <= agentCount; i++)
+	{
+		std::string name = "agent" + std::to_string(i);
+		bool isMinion = (i > 50);
+		uint16_t subgroup = static_cast<uint16_t>(isMinion ? 0 : 1 + (i - 1) / 5);
+		agents->emplace(std::piecewise_construct,
+			std::forward_as_tuple(i * 1000),
+			std::forward_as_tuple(static_cast<uint16_t>(i), name.c_str(), subgroup, isMinion, isMinion == false));
+	}
+	result.Agents = agents;
+
+	const uint64_t start = 100000;
+	const uint64_t duration = 10 * 60 * 1000;
+	result.EnteredCombatTime = start;
+	result.SubGroup = 1;
+	for (uint64_t i = 0; i < duration / 10; i++)
+	{
+		uintptr_t agentId = (1 + rng() % agentCount) * 1000;
+		result.AddEvent(start + i * 10, 1 + rng() % 5000, agentId, static_cast<uint32_t>(rng() % 60), rng() % 5 == 0);
+	}
+
+	result.LastDamageEvent = start + duration - 5000;
+	result.ExitedCombatTime = start + duration;
+	result.CollectionTime = start + duration;
+
+	return result;
+}
+
+// Aggregation the way AggregatedStats did it before running totals: every query scans all events, looks up the agent of
+// each event in the agent map and accumulates into ordered maps. Kept independent of AggregatedStats on purpose, so that
+// it can serve as reference for the results and as baseline for the benchmarks.
+using ReferenceEntry = std::pair<uint64_t, HealTotal>; // <Id, Total>
+
+class ReferenceAggregation
+{
+public:
+	ReferenceAggregation(const HealingStats& pSource, const HealWindowOptions& pOptions)
+		: mSource{pSource}
+		, mOptions{pOptions}
+	{
+	}
+
+	uint64_t GetCombatEnd() const
+	{
+		uint64_t end = 0;
+		switch (mOptions.CombatEndConditionChoice)
+		{
+		case CombatEndCondition::CombatExit:
+			end = mSource.ExitedCombatTime;
+			break;
+		case CombatEndCondition::LastHealEvent:
+			end = (mSource.Events.size() != 0) ? mSource.Events.back().Time : 0;
+			break;
+		case CombatEndCondition::LastDamageEvent:
+			end = mSource.LastDamageEvent;
+			break;
+		default:
+			end = (mSource.Events.size() != 0) ? (std::max)(mSource.LastDamageEvent, mSource.Events.back().Time) : mSource.LastDamageEvent;
+			break;
+		}
+
+		if (end == 0)
+		{
+			end = (mSource.ExitedCombatTime != 0) ? mSource.ExitedCombatTime : mSource.CollectionTime;
+		}
+		return (std::max)(end, mSource.EnteredCombatTime);
+	}
+
+	// Returns true if the agent should be filtered out
+	bool IsFiltered(AgentSnapshot::const_iterator pAgent, const HealWindowOptions& pFilter) const
+	{
+		if (pAgent == mSource.Agents->end() || pAgent->second.Name.size() == 0)
+		{
+			return pFilter.ExcludeUnmapped;
+		}
+
+		const HealedAgent& agent = pAgent->second;
+		return (agent.IsMinion == true && pFilter.ExcludeMinions == true) ||
+			(agent.Subgroup == 0 && mSource.SubGroup != 0 && pFilter.ExcludeOffSquad == true) ||
+			(agent.Subgroup != 0 && mSource.SubGroup != agent.Subgroup && pFilter.ExcludeOffGroup == true) ||
+			(agent.Subgroup == mSource.SubGroup && pFilter.ExcludeGroup == true);
+	}
+
+	std::vector<ReferenceEntry> GetAgents(std::optional<uint32_t> pSkillId) const
+	{
+		std::map<uintptr_t, HealTotal> agents;
+		const uint64_t combatEnd = GetCombatEnd();
+		for (const HealEvent& event : mSource.Events)
+		{
+			if (event.Time > combatEnd || (pSkillId.has_value() == true && event.SkillId != *pSkillId))
+			{
+				continue;
+			}
+			if (IsFiltered(mSource.Agents->find(event.AgentId), mOptions) == true)
+			{
+				continue;
+			}
+
+			agents[event.AgentId].Add(event.Size, event.IsBarrier);
+		}
+		return std::vector<ReferenceEntry>{agents.begin(), agents.end()};
+	}
+
+	// Indirect healing skills are merged into one entry with IndirectHealingSkillId (which can be there a second time,
+	// from a skill with that id)
+	std::vector<ReferenceEntry> GetSkills(std::optional<uintptr_t> pAgentId) const
+	{
+		std::map<uint32_t, HealTotal> skills;
+		const uint64_t combatEnd = GetCombatEnd();
+		for (const HealEvent& event : mSource.Events)
+		{
+			if (event.Time > combatEnd)
+			{
+				continue;
+			}
+			if (pAgentId.has_value() == true)
+			{
+				if (event.AgentId != *pAgentId)
+				{
+					continue;
+				}
+			}
+			else if (IsFiltered(mSource.Agents->find(event.AgentId), mOptions) == true)
+			{
+				continue;
+			}
+
+			skills[event.SkillId].Add(event.Size, event.IsBarrier);
+		}
+
+		std::vector<ReferenceEntry> result;
+		HealTotal indirect;
+		for (const auto& [skillId, total] : skills)
+		{
+			std::string fallbackName = std::to_string(skillId);
+			const char* skillName = mSource.Skills->GetSkillName(skillId);
+			if (mSource.Skills->IsSkillIndirectHealing(skillId, (skillName != nullptr) ? skillName : fallbackName.c_str()) == true)
+			{
+				indirect += total;
+				continue;
+			}
+			result.emplace_back(skillId, total);
+		}
+		if (indirect.Hits != 0)
+		{
+			result.emplace_back(IndirectHealingSkillId, indirect);
+		}
+		return result;
+	}
+
+	// Indexed by GroupFilter
+	std::vector<HealTotal> GetGroupFilterTotals() const
+	{
+		std::vector<HealWindowOptions> filters(static_cast<size_t>(GroupFilter::Max));
+		for (size_t i = 0; i < filters.size(); i++)
+		{
+			const GroupFilter groupFilter = static_cast<GroupFilter>(i);
+			filters[i].ExcludeGroup = false;
+			filters[i].ExcludeOffGroup = (groupFilter == GroupFilter::Group);
+			filters[i].ExcludeOffSquad = (groupFilter == GroupFilter::Group || groupFilter == GroupFilter::Squad);
+			filters[i].ExcludeMinions = (groupFilter != GroupFilter::All);
+			filters[i].ExcludeUnmapped = true;
+		}
+
+		std::vector<HealTotal> result(filters.size());
+		const uint64_t combatEnd = GetCombatEnd();
+		for (const HealEvent& event : mSource.Events)
+		{
+			if (event.Time > combatEnd)
+			{
+				continue;
+			}
+
+			AgentSnapshot::const_iterator agent = mSource.Agents->find(event.AgentId);
+			for (size_t i = 0; i < filters.size(); i++)
+			{
+				if (IsFiltered(agent, filters[i]) == false)
+				{
+					result[i].Add(event.Size, event.IsBarrier);
+				}
+			}
+		}
+		return result;
+	}
+
+private:
+	const HealingStats& mSource;
+	const HealWindowOptions& mOptions;
+};
+
+// Entries are compared regardless of their order
+void ExpectMatchesReference(const AggregatedVector& pActual, std::vector<ReferenceEntry> pExpected)
+{
+	std::vector<ReferenceEntry> actual;
+	for (const AggregatedStatsEntry& entry : pActual.Entries)
+	{
+		actual.emplace_back(entry.Id, HealTotal{entry.Hits, entry.Healing, entry.Barrier});
+	}
+
+	auto compare = [](const ReferenceEntry& pLeft, const ReferenceEntry& pRight)
+	{
+		return std::tie(pLeft.first, pLeft.second.Hits, pLeft.second.Healing, pLeft.second.Barrier) <
+			std::tie(pRight.first, pRight.second.Hits, pRight.second.Healing, pRight.second.Barrier);
+	};
+	std::sort(actual.begin(), actual.end(), compare);
+	std::sort(pExpected.begin(), pExpected.end(), compare);
+	EXPECT_EQ(actual, pExpected);
+
+	uint64_t highestHealing = 0;
+	for (const auto& [id, total] : pExpected)
+	{
+		highestHealing = (std::max)(highestHealing, total.Healing);
+	}
+	EXPECT_EQ(pActual.HighestHealing, highestHealing);
+}
+
+void ExpectMatchesReference(const AggregatedVector& pActual, const std::vector<HealTotal>& pExpected)
+{
+	ASSERT_EQ(pActual.Entries.size(), pExpected.size());
+	for (size_t i = 0; i < pExpected.size(); i++)
+	{
+		EXPECT_EQ((HealTotal{pActual.Entries[i].Hits, pActual.Entries[i].Healing, pActual.Entries[i].Barrier}), pExpected[i]) << i;
+	}
+}
+} // anonymous namespace
+
+TEST(DenseIndexMapTest, IndicesAreDense)
+{
+	DenseIndexMap<uintptr_t> map;
+	EXPECT_EQ(map.Find(0), std::nullopt);
+
+	// Enough keys to grow the table a few times, with keys that only differ in the high bits
+	for (uintptr_t i = 0; i < 1000; i++)
+	{
+		auto [index, inserted] = map.Insert(i << 40);
+		EXPECT_EQ(index, i);
+		EXPECT_EQ(inserted, true);
+	}
+
+	for (uintptr_t i = 0; i < 1000; i++)
+	{
+		auto [index, inserted] = map.Insert(i << 40);
+		EXPECT_EQ(index, i);
+		EXPECT_EQ(inserted, false);
+		EXPECT_EQ(map.Find(i << 40), static_cast<uint32_t>(i));
+		EXPECT_EQ(map.GetKeys()[i], i << 40);
+	}
+	EXPECT_EQ(map.Find(1), std::nullopt);
+	EXPECT_EQ(map.size(), 1000U);
+
+	map.clear();
+	EXPECT_EQ(map.size(), 0U);
+	EXPECT_EQ(map.Find(0), std::nullopt);
+	EXPECT_EQ(map.Insert(5).first, 0U);
+}
+
+TEST(HealEventTotalsTest, GetTotalsUntil)
+{
+	HealEventTotals totals;
+	for (size_t i = 0; i < HealEventTotals::CHECKPOINT_INTERVAL * 3; i++)
+	{
+		totals.Add(1000 + i, 10, i % 3, 1, false);
+	}
+	totals.Add(500, 10, 0, 1, true); // Late event, lower than every checkpoint time
+
+	// Later than every event - the running totals are complete
+	HealEventTotals::Checkpoint checkpoint = totals.GetTotalsUntil(UINT64_MAX);
+	EXPECT_EQ(checkpoint.EventCount, HealEventTotals::CHECKPOINT_INTERVAL * 3 + 1);
+	ASSERT_NE(checkpoint.Totals, nullptr);
+	ASSERT_EQ(checkpoint.Totals->size(), 3U);
+	EXPECT_EQ(checkpoint.Totals->Totals[0], (HealTotal{HealEventTotals::CHECKPOINT_INTERVAL + 1, (HealEventTotals::CHECKPOINT_INTERVAL + 1) * 10, 10}));
+
+	// Only the last event is later than this, so the last checkpoint is used
+	checkpoint = totals.GetTotalsUntil(1000 + HealEventTotals::CHECKPOINT_INTERVAL * 3 - 2);
+	EXPECT_EQ(checkpoint.EventCount, HealEventTotals::CHECKPOINT_INTERVAL * 2);
+	EXPECT_EQ(checkpoint.HighestTime, 1000 + HealEventTotals::CHECKPOINT_INTERVAL * 2 - 1);
+
+	checkpoint = totals.GetTotalsUntil(1000 + HealEventTotals::CHECKPOINT_INTERVAL - 1);
+	EXPECT_EQ(checkpoint.EventCount, HealEventTotals::CHECKPOINT_INTERVAL);
+
+	// Earlier than the first checkpoint
+	checkpoint = totals.GetTotalsUntil(999);
+	EXPECT_EQ(checkpoint.EventCount, 0U);
+	EXPECT_EQ(checkpoint.Totals, nullptr);
+
+	totals.clear();
+	EXPECT_EQ(totals.GetEventCount(), 0U);
+	EXPECT_EQ(totals.GetTotalsUntil(UINT64_MAX).Totals, nullptr);
+}
+
+// A long fight with many distinct <agent, skill> pairs. Without thinning out the checkpoints, every checkpoint would
+// hold a copy of the whole table
+TEST(HealEventTotalsTest, CheckpointMemoryIsBounded)
+{
+	constexpr size_t INTERVALS = 1024;
+
+	HealEventTotals totals;
+	for (size_t i = 0; i < HealEventTotals::CHECKPOINT_INTERVAL * INTERVALS; i++)
+	{
+		totals.Add(1000 + i, 10, 2000 + i % 50, static_cast<uint32_t>(i / 50 % 40), false);
+	}
+
+	const size_t tableSize = totals.GetTotalsUntil(UINT64_MAX).Totals->GetMemoryUsage();
+	const size_t maxCheckpoints = HealEventTotals::RECENT_CHECKPOINTS * (2 + std::bit_width(INTERVALS));
+	EXPECT_LE(totals.GetMemoryUsage(), (maxCheckpoints + 1) * tableSize);
+
+	// Cutoffs further back still start from a checkpoint close to them, relative to how far back they are
+	for (size_t eventsBack : {size_t{1}, size_t{10000}, size_t{100000}, size_t{1000000}, size_t{4000000}})
+	{
+		SCOPED_TRACE(eventsBack);
+		const size_t eventsUntil = HealEventTotals::CHECKPOINT_INTERVAL * INTERVALS - eventsBack;
+		HealEventTotals::Checkpoint checkpoint = totals.GetTotalsUntil(1000 + eventsUntil - 1);
+		EXPECT_LE(checkpoint.EventCount, eventsUntil);
+		EXPECT_LE(eventsUntil - checkpoint.EventCount, HealEventTotals::CHECKPOINT_INTERVAL + eventsBack * 2 / HealEventTotals::RECENT_CHECKPOINTS);
+
+		uint64_t hits = 0;
+		if (checkpoint.Totals != nullptr)
+		{
+			for (const HealTotal& total : checkpoint.Totals->Totals)
+			{
+				hits += total.Hits;
+			}
+		}
+		EXPECT_EQ(hits, checkpoint.EventCount);
+	}
+}
+
+TEST(HealEventTotalsTest, CopiesAreNotAffectedByAdds)
+{
+	HealEventTotals totals;
+	totals.Add(1000, 10, 1, 1, false);
+
+	HealEventTotals copy = totals;
+	totals.Add(1001, 20, 1, 1, false);
+	totals.Add(1002, 30, 2, 1, false);
+
+	ASSERT_EQ(copy.GetEventCount(), 1U);
+	std::shared_ptr<const HealEventTotals::Table> copyTotals = copy.GetTotalsUntil(UINT64_MAX).Totals;
+	ASSERT_EQ(copyTotals->size(), 1U);
+	EXPECT_EQ(copyTotals->Totals[0], (HealTotal{1, 10, 0}));
+
+	std::shared_ptr<const HealEventTotals::Table> newTotals = totals.GetTotalsUntil(UINT64_MAX).Totals;
+	ASSERT_EQ(newTotals->size(), 2U);
+	EXPECT_EQ(newTotals->Totals[0], (HealTotal{2, 30, 0}));
+}
+
+// Aggregating from the running totals, and scanning every event (which is what AggregatedStats does when the totals
+// don't match the events), both have to give the same result as the reference aggregation
+TEST(AggregatedStatsTest, RunningTotalsMatchFullScan)
+{
+	for (uint32_t seed = 0; seed < 4; seed++)
+	{
+		HealingStats fight = BuildFight(seed, HealEventTotals::CHECKPOINT_INTERVAL * 5 + seed * 1000);
+
+		for (uint32_t endCondition = 0; endCondition < static_cast<uint32_t>(CombatEndCondition::Max); endCondition++)
+		{
+			HealWindowOptions options;
+			options.CombatEndConditionChoice = static_cast<CombatEndCondition>(endCondition);
+			options.ExcludeMinions = (seed % 2) == 0;
+			options.ExcludeUnmapped = (seed % 3) == 0;
+
+			const ReferenceAggregation reference{fight, options};
+
+			for (bool fullScan : {false, true})
+			{
+				HealingStats source = fight;
+				if (fullScan == true)
+				{
+					source.Totals.clear();
+				}
+				AggregatedStats stats{std::move(source), options, false};
+
+				SCOPED_TRACE("seed " + std::to_string(seed) + " end condition " + std::to_string(endCondition) + (fullScan == true ? " full scan" : " running totals"));
+
+				ExpectMatchesReference(stats.GetStats(DataSource::Agents), reference.GetAgents(std::nullopt));
+				ExpectMatchesReference(stats.GetStats(DataSource::Skills), reference.GetSkills(std::nullopt));
+				ExpectMatchesReference(stats.GetStats(DataSource::Totals), reference.GetGroupFilterTotals());
+				for (uint32_t skillId = 0; skillId < 30; skillId += 7)
+				{
+					ExpectMatchesReference(stats.GetDetails(DataSource::Skills, skillId), reference.GetAgents(skillId));
+				}
+				for (uintptr_t agentId = 0; agentId <= 40000; agentId += 9000)
+				{
+					ExpectMatchesReference(stats.GetDetails(DataSource::Agents, agentId), reference.GetSkills(agentId));
+				}
+
+				HealTotal total;
+				for (const auto& [skillId, skillTotal] : reference.GetSkills(std::nullopt))
+				{
+					total += skillTotal;
+				}
+				EXPECT_EQ((HealTotal{stats.GetTotal().Hits, stats.GetTotal().Healing, stats.GetTotal().Barrier}), total);
+				EXPECT_FLOAT_EQ(stats.GetCombatTime(), (reference.GetCombatEnd() - fight.EnteredCombatTime) / 1000.0f);
+			}
+		}
+	}
+}
+
+// Events that arrived in time order are cut off at combat end with a binary search instead of checking every event,
+// both paths have to include exactly the events up to combat end
+TEST(AggregatedStatsTest, CombatEndCutoff)
+{
+	for (bool lateEvents : {false, true})
+	{
+		HealingStats fight = BuildFight(3, HealEventTotals::CHECKPOINT_INTERVAL * 3 + 500, lateEvents);
+		ASSERT_EQ(fight.Events.IsSorted(), lateEvents == false);
+		fight.Totals.clear(); // Scan every event instead of starting from a checkpoint
+
+		HealWindowOptions options;
+		options.CombatEndConditionChoice = CombatEndCondition::CombatExit;
+		options.ExcludeMinions = false;
+		options.ExcludeUnmapped = false;
+
+		uint64_t expectedHealing = 0;
+		uint64_t expectedHits = 0;
+		for (const HealEvent& event : fight.Events)
+		{
+			if (event.Time <= fight.ExitedCombatTime)
+			{
+				expectedHealing += event.Size;
+				expectedHits++;
+			}
+		}
+		ASSERT_LT(expectedHits, fight.Events.size());
+
+		AggregatedStats stats{std::move(fight), options, false};
+		SCOPED_TRACE(lateEvents == true ? "late events" : "sorted");
+		EXPECT_EQ(stats.GetTotal().Healing, expectedHealing);
+		EXPECT_EQ(stats.GetTotal().Hits, expectedHits);
+	}
+}
+
+// Stats built on the totals of a previous aggregation of the same (shorter) event log only add the events that were
+// appended since, the result has to be the same as aggregating everything again
+TEST(AggregatedStatsTest, TotalsBaseMatchesFullScan)
+{
+	for (bool lateEvents : {false, true})
+	{
+		for (bool moveCombatEnd : {false, true})
+		{
+			HealingStats fight = BuildFight(7, 3000, lateEvents);
+			fight.Totals.clear(); // Scan every event instead of starting from a checkpoint
+
+			HealWindowOptions options;
+			options.CombatEndConditionChoice = CombatEndCondition::CombatExit;
+			options.ExcludeMinions = false;
+			options.ExcludeUnmapped = false;
+
+			HealingStats previousSource = fight;
+			AggregatedStats previous{std::move(previousSource), options, false};
+			AggregatedStats::TotalsBase base = previous.GetTotalsBase();
+			ASSERT_EQ(base.Events.size(), 3000U);
+
+			// Nothing changed, the totals are shared as they are
+			HealingStats sameSource = fight;
+			AggregatedStats same{std::move(sameSource), options, false, &base};
+			EXPECT_EQ(same.GetTotalsBase().Totals, base.Totals);
+
+			uint64_t time = fight.CollectionTime;
+			for (uint32_t i = 0; i < 500; i++)
+			{
+				time += 3;
+				fight.AddEvent(time - ((lateEvents == true && i % 7 == 0) ? 4000 : 0), 100 + i, (1 + i % 40) * 1000, i % 30, i % 5 == 0);
+			}
+			if (moveCombatEnd == true)
+			{
+				fight.ExitedCombatTime = time - 200;
+			}
+			fight.CollectionTime = time;
+
+			HealingStats deltaSource = fight;
+			AggregatedStats delta{std::move(deltaSource), options, false, &base};
+
+			HealingStats fullScanSource = fight;
+			AggregatedStats fullScan{std::move(fullScanSource), options, false};
+
+			SCOPED_TRACE(std::string{lateEvents == true ? "late events" : "sorted"} + (moveCombatEnd == true ? ", combat end moved" : ""));
+			EXPECT_EQ(delta.GetTotal().GetTie(), fullScan.GetTotal().GetTie());
+			ExpectEqual(delta.GetStats(DataSource::Agents), fullScan.GetStats(DataSource::Agents));
+			ExpectEqual(delta.GetStats(DataSource::Skills), fullScan.GetStats(DataSource::Skills));
+			EXPECT_EQ(delta.GetTotalsBase().EventCount, fullScan.GetTotalsBase().EventCount);
+		}
+	}
+}
+
+// Views cut off at the top entries have to be the first entries of the full view, with bars still relative to the
+// highest entry of the full view
+TEST(AggregatedStatsTest, TopEntriesMatchFullSort)
+{
+	HealingStats fight = BuildFight(9, 20000);
+
+	for (uint32_t sortOrder = 0; sortOrder < static_cast<uint32_t>(SortOrder::Max); sortOrder++)
+	{
+		HealWindowOptions options;
+		options.SortOrderChoice = static_cast<SortOrder>(sortOrder);
+		options.ExcludeMinions = false;
+		options.ExcludeUnmapped = false;
+		options.MaxLinesDisplayed = 5;
+
+		HealingStats fullSource = fight;
+		AggregatedStats full{std::move(fullSource), options, false};
+
+		options.TopEntriesOnly = true;
+		HealingStats topSource = fight;
+		AggregatedStats top{std::move(topSource), options, false};
+
+		SCOPED_TRACE("sort order " + std::to_string(sortOrder));
+		for (DataSource dataSource : {DataSource::Agents, DataSource::Skills})
+		{
+			const AggregatedVector& fullStats = full.GetStats(dataSource);
+			const AggregatedVector& topStats = top.GetStats(dataSource);
+			ASSERT_GT(fullStats.Entries.size(), 5U);
+			ASSERT_EQ(topStats.Entries.size(), 5U);
+			EXPECT_EQ(topStats.HighestHealing, fullStats.HighestHealing);
+			for (size_t i = 0; i < topStats.Entries.size(); i++)
+			{
+				EXPECT_EQ(topStats.Entries[i].Healing, fullStats.Entries[i].Healing) << i;
+				if (options.SortOrderChoice == SortOrder::AscendingAlphabetical || options.SortOrderChoice == SortOrder::DescendingAlphabetical)
+				{
+					EXPECT_EQ(topStats.Entries[i].Name, fullStats.Entries[i].Name) << i;
+				}
+			}
+		}
+
+		// Details views are never cut off
+		EXPECT_EQ(top.GetDetails(DataSource::Agents, 3000).Entries.size(), full.GetDetails(DataSource::Agents, 3000).Entries.size());
+	}
+}
+
+// Rolling healing per second of every entry has to match the events in each window up to combat end
+TEST(AggregatedStatsTest, RollingHealingMatchesEvents)
+{
+	HealingStats fight = BuildFight(11, 20000);
+
+	HealWindowOptions options;
+	options.CombatEndConditionChoice = CombatEndCondition::CombatExit;
+	options.ExcludeMinions = true;
+	options.ExcludeUnmapped = false;
+
+	HealingStats source = fight;
+	AggregatedStats stats{std::move(source), options, false};
+
+	for (size_t i = 0; i < RollingHealing::WINDOW_COUNT; i++)
+	{
+		const double duration = RollingHealing::WINDOWS[i] / 1000.0;
+
+		// Events after combat end are left out, including the ones in the same bucket as combat end
+		std::map<uintptr_t, uint64_t> expectedAgents;
+		for (const HealEvent& event : fight.Events)
+		{
+			if (event.Time <= fight.ExitedCombatTime - RollingHealing::WINDOWS[i] || event.Time > fight.ExitedCombatTime)
+			{
+				continue;
+			}
+
+			expectedAgents[event.AgentId] += event.Size;
+		}
+
+		SCOPED_TRACE("window " + std::to_string(RollingHealing::WINDOWS[i]));
+
+		// The agents view only has the agents that aren't filtered out, which are the ones the total includes
+		const AggregatedVector& agents = stats.GetStats(DataSource::Agents);
+		ASSERT_GT(agents.Entries.size(), 0U);
+		uint64_t expectedTotal = 0;
+		for (const AggregatedStatsEntry& entry : agents.Entries)
+		{
+			EXPECT_DOUBLE_EQ(entry.RollingHealingPerSecond[i], expectedAgents[entry.Id] / duration) << entry.Id;
+			expectedTotal += expectedAgents[entry.Id];
+		}
+		EXPECT_GT(expectedTotal, 0U);
+		EXPECT_DOUBLE_EQ(stats.GetTotal().RollingHealingPerSecond[i], expectedTotal / duration);
+	}
+}
+
+// Details views are slices of the agent x skill matrix, every slice has to match the events of that agent or skill
+TEST(AggregatedStatsTest, DetailsMatchEvents)
+{
+	HealingStats fight = BuildFight(5, 20000);
+	HealingStats source = fight;
+
+	HealWindowOptions options;
+	options.CombatEndConditionChoice = CombatEndCondition::CombatExit;
+	options.ExcludeMinions = false;
+	options.ExcludeUnmapped = false;
+	AggregatedStats stats{std::move(source), options, false};
+
+	std::map<std::pair<uintptr_t, uint32_t>, uint64_t> expected; // <agent id, skill id> => healing
+	for (const HealEvent& event : fight.Events)
+	{
+		if (event.Time <= fight.ExitedCombatTime)
+		{
+			expected[{event.AgentId, event.SkillId}] += event.Size;
+		}
+	}
+
+	for (const auto& [key, healing] : expected)
+	{
+		const auto [agentId, skillId] = key;
+		if (skillId == 7 || skillId == IndirectHealingSkillId)
+		{
+			continue; // Damaging skill is shown as indirect healing in agent details, which has the same id as skill 0
+		}
+
+		const std::vector<AggregatedStatsEntry>& agentDetails = stats.GetDetails(DataSource::Agents, agentId).Entries;
+		auto skill = std::find_if(agentDetails.begin(), agentDetails.end(), [skillId](const AggregatedStatsEntry& pEntry) { return pEntry.Id == skillId; });
+		ASSERT_NE(skill, agentDetails.end()) << agentId << " " << skillId;
+		EXPECT_EQ(skill->Healing, healing) << agentId << " " << skillId;
+
+		const std::vector<AggregatedStatsEntry>& skillDetails = stats.GetDetails(DataSource::Skills, skillId).Entries;
+		auto agent = std::find_if(skillDetails.begin(), skillDetails.end(), [agentId](const AggregatedStatsEntry& pEntry) { return pEntry.Id == agentId; });
+		ASSERT_NE(agent, skillDetails.end()) << agentId << " " << skillId;
+		EXPECT_EQ(agent->Healing, healing) << agentId << " " << skillId;
+	}
+}
+
+// Every view comes from the same aggregation pass, so the totals of the different views have to agree
+TEST(AggregatedStatsTest, ViewsAreConsistent)
+{
+	HealWindowOptions options;
+	options.ExcludeMinions = false;
+	options.ExcludeUnmapped = true;
+
+	AggregatedStats stats{BuildFight(1, 10000), options, false};
+
+	const AggregatedStatsEntry& total = stats.GetTotal();
+	EXPECT_NE(total.Healing, 0U);
+
+	uint64_t agentHealing = 0;
+	for (const AggregatedStatsEntry& agent : stats.GetStats(DataSource::Agents).Entries)
+	{
+		agentHealing += agent.Healing;
+
+		uint64_t agentSkillHealing = 0;
+		for (const AggregatedStatsEntry& skill : stats.GetDetails(DataSource::Agents, agent.Id).Entries)
+		{
+			agentSkillHealing += skill.Healing;
+		}
+		EXPECT_EQ(agentSkillHealing, agent.Healing) << agent.Id;
+	}
+	EXPECT_EQ(agentHealing, total.Healing);
+
+	uint64_t skillHealing = 0;
+	for (const AggregatedStatsEntry& skill : stats.GetStats(DataSource::Skills).Entries)
+	{
+		skillHealing += skill.Healing;
+	}
+	EXPECT_EQ(skillHealing, total.Healing);
+
+	// These options are the same as the "All (Including Summons)" group filter
+	EXPECT_EQ(stats.GetStats(DataSource::Totals).Entries[static_cast<size_t>(GroupFilter::All)].Healing, total.Healing);
+}
+
+// The reference aggregation (one agent lookup and four filter checks per event) compared to the group filter totals of
+// AggregatedStats
+TEST(AggregatedStatsTest, DISABLED_GroupFilterTotalsBenchmark)
+{
+	constexpr size_t ITERATIONS = 20;
+	HealingStats fight = BuildSquadFight();
+
+	for (uint32_t endCondition = 0; endCondition < static_cast<uint32_t>(CombatEndCondition::Max); endCondition++)
+	{
+		HealWindowOptions options;
+		options.CombatEndConditionChoice = static_cast<CombatEndCondition>(endCondition);
+
+		std::chrono::steady_clock::duration referenceTime{0};
+		std::chrono::steady_clock::duration time{0};
+		for (size_t i = 0; i < ITERATIONS; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			std::vector<HealTotal> expected = ReferenceAggregation{fight, options}.GetGroupFilterTotals();
+			referenceTime += std::chrono::steady_clock::now() - start;
+
+			HealingStats source = fight;
+			AggregatedStats stats{std::move(source), options, false};
+
+			start = std::chrono::steady_clock::now();
+			const AggregatedVector& result = stats.GetGroupFilterTotals();
+			time += std::chrono::steady_clock::now() - start;
+
+			ExpectMatchesReference(result, expected);
+		}
+
+		LogI("{} events, end condition {}: reference {:.1f}us, AggregatedStats {:.1f}us per GetGroupFilterTotals",
+			fight.Events.size(), endCondition,
+			std::chrono::duration<double, std::micro>(referenceTime).count() / ITERATIONS,
+			std::chrono::duration<double, std::micro>(time).count() / ITERATIONS);
+	}
+}
+
+// Agent and skill views of the reference aggregation (accumulating into std::map, like aggregation used to do) compared
+// to AggregatedStats, which aggregates into dense index arrays. Running totals are cleared so that AggregatedStats scans
+// every event as well
+TEST(AggregatedStatsTest, DISABLED_DenseIndexBenchmark)
+{
+	constexpr size_t ITERATIONS = 20;
+	HealingStats fight = BuildSquadFight();
+	fight.Totals.clear();
+
+	HealWindowOptions options;
+	options.ExcludeMinions = false;
+
+	for (uint32_t run = 0; run < 3; run++)
+	{
+		std::chrono::steady_clock::duration referenceTime{0};
+		std::chrono::steady_clock::duration time{0};
+
+		for (size_t i = 0; i < ITERATIONS; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			const ReferenceAggregation reference{fight, options};
+			std::vector<ReferenceEntry> expectedAgents = reference.GetAgents(std::nullopt);
+			std::vector<ReferenceEntry> expectedSkills = reference.GetSkills(std::nullopt);
+			referenceTime += std::chrono::steady_clock::now() - start;
+
+			HealingStats source = fight;
+			start = std::chrono::steady_clock::now();
+			AggregatedStats stats{std::move(source), options, false};
+			const AggregatedVector& agents = stats.GetStats(DataSource::Agents);
+			const AggregatedVector& skills = stats.GetStats(DataSource::Skills);
+			time += std::chrono::steady_clock::now() - start;
+
+			ExpectMatchesReference(agents, std::move(expectedAgents));
+			ExpectMatchesReference(skills, std::move(expectedSkills));
+		}
+
+		LogI("{} events: reference {:.1f}us, AggregatedStats {:.1f}us for the agent and skill views", fight.Events.size(),
+			std::chrono::duration<double, std::micro>(referenceTime).count() / ITERATIONS,
+			std::chrono::duration<double, std::micro>(time).count() / ITERATIONS);
+	}
+}
+
+// Peers outgoing aggregates every peer, sequentially and spread over thread pools of different sizes. Running totals
+// are cleared so that every peer scans its events (the worst case, same as when combat end cuts off late events)
+TEST(AggregatedStatsTest, DISABLED_PeerAggregationScalingBenchmark)
+{
+	constexpr size_t ITERATIONS = 5;
+	HealingStats fight = BuildSquadFight();
+	fight.Totals.clear();
+
+	std::vector<std::unique_ptr<ThreadPool>> pools;
+	pools.emplace_back(nullptr); // Sequential
+	for (size_t workerCount : {1, 3, 7})
+	{
+		pools.emplace_back(std::make_unique<ThreadPool>(workerCount));
+	}
+
+	HealWindowOptions options;
+	options.DataSourceChoice = DataSource::PeersOutgoing;
+
+	LogI("{} hardware threads", std::thread::hardware_concurrency());
+	for (size_t peerCount : {1, 10, 25, 50})
+	{
+		std::string line = std::to_string(peerCount) + " peers:";
+		std::optional<uint64_t> expectedHealing;
+		for (const std::unique_ptr<ThreadPool>& pool : pools)
+		{
+			std::chrono::steady_clock::duration time{0};
+			for (size_t i = 0; i < ITERATIONS; i++)
+			{
+				std::map<uintptr_t, std::pair<std::string, HealingStats>> states;
+				for (uintptr_t peer = 1; peer <= peerCount; peer++)
+				{
+					states.try_emplace(peer, "peer" + std::to_string(peer), HealingStats{fight});
+				}
+
+				auto start = std::chrono::steady_clock::now();
+				AggregatedStatsCollection collection{std::move(states), 1, options, false, pool.get()};
+				const AggregatedStatsEntry& total = collection.GetTotal(DataSource::PeersOutgoing);
+				time += std::chrono::steady_clock::now() - start;
+
+				ASSERT_EQ(collection.GetStats(DataSource::PeersOutgoing).Entries.size(), peerCount);
+				if (expectedHealing.has_value() == false)
+				{
+					expectedHealing = total.Healing;
+				}
+				ASSERT_EQ(total.Healing, *expectedHealing);
+			}
+
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), " %zu workers %.2fms", (pool != nullptr) ? pool->GetWorkerCount() : 0,
+				std::chrono::duration<double, std::milli>(time).count() / ITERATIONS);
+			line += buffer;
+		}
+		LogI("{}", line);
+	}
+}
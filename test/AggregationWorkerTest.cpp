@@ -0,0 +1,193 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "AggregationWorker.h"
+#include "EventProcessor.h"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace
+{
+// Waits until the worker published stats for the window that are different from pPrevious
+std::shared_ptr<AggregatedStatsCollection> WaitForPublish(const AggregationWorker& pWorker, uint32_t pWindowIndex, const AggregatedStatsCollection* pPrevious = nullptr)
+{
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (std::chrono::steady_clock::now() < deadline)
+	{
+		std::shared_ptr<AggregatedStatsCollection> stats = pWorker.GetStats(pWindowIndex);
+		if (stats != nullptr && stats.get() != pPrevious)
+		{
+			return stats;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return nullptr;
+}
+} // anonymous namespace
+
+TEST(AggregationWorkerTest, PublishesShownWindows)
+{
+	EventProcessor processor;
+	AggregationWorker worker{processor, nullptr, std::chrono::milliseconds(10)};
+
+	HealWindowOptions options;
+	options.DataSourceChoice = DataSource::Combined;
+	worker.SetWindow(2, &options, false);
+
+	std::shared_ptr<AggregatedStatsCollection> stats = WaitForPublish(worker, 2);
+	ASSERT_NE(stats, nullptr);
+	EXPECT_EQ(stats->GetStats(DataSource::Agents).Entries.size(), 0U);
+	EXPECT_EQ(worker.GetStats(0), nullptr);
+
+	// Hiding the window keeps its stats, so that they can be shown right away when the window is shown again
+	worker.SetWindow(2, nullptr, false);
+	EXPECT_EQ(worker.GetStats(2), stats);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Let the worker notice that the window is hidden
+	EXPECT_EQ(worker.GetStats(2), stats);
+
+	// Showing it again aggregates it again
+	worker.SetWindow(2, &options, false);
+	EXPECT_NE(WaitForPublish(worker, 2, stats.get()), nullptr);
+
+	worker.Shutdown();
+}
+
+TEST(AggregationWorkerTest, OptionsChangeRefreshesRightAway)
+{
+	EventProcessor processor;
+	AggregationWorker worker{processor, nullptr, std::chrono::hours(1)};
+
+	HealWindowOptions options;
+	worker.SetWindow(0, &options, false);
+	std::shared_ptr<AggregatedStatsCollection> stats = WaitForPublish(worker, 0);
+	ASSERT_NE(stats, nullptr);
+
+	// Display only options don't cause a new aggregation
+	options.ShowProgressBars = !options.ShowProgressBars;
+	worker.SetWindow(0, &options, false);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(worker.GetStats(0), stats);
+
+	options.SortOrderChoice = SortOrder::AscendingAlphabetical;
+	worker.SetWindow(0, &options, false);
+	EXPECT_NE(WaitForPublish(worker, 0, stats.get()), nullptr);
+}
+
+// Windows are only aggregated again if the event processor processed something since the last snapshot (nobody is in
+// combat here, so the combat time doesn't move on either)
+TEST(AggregationWorkerTest, SnapshotIsReusedUntilDataChanges)
+{
+	EventProcessor processor;
+	AggregationWorker worker{processor, nullptr, std::chrono::milliseconds(10)};
+
+	HealWindowOptions options;
+	worker.SetWindow(0, &options, false);
+	worker.SetWindow(1, &options, false);
+	std::shared_ptr<AggregatedStatsCollection> stats0 = WaitForPublish(worker, 0);
+	std::shared_ptr<AggregatedStatsCollection> stats1 = WaitForPublish(worker, 1);
+	ASSERT_NE(stats0, nullptr);
+	ASSERT_NE(stats1, nullptr);
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	EXPECT_EQ(worker.GetStats(0), stats0);
+	EXPECT_EQ(worker.GetStats(1), stats1);
+
+	// Agent event that is otherwise ignored, but still counts as processed
+	uint64_t version = processor.GetDataVersion();
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 1;
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	EXPECT_EQ(processor.GetDataVersion(), version + 1);
+
+	EXPECT_NE(WaitForPublish(worker, 0, stats0.get()), nullptr);
+	EXPECT_NE(WaitForPublish(worker, 1, stats1.get()), nullptr);
+}
+
+TEST(AggregationWorkerTest, RefreshIntervalCanBeChanged)
+{
+	EventProcessor processor;
+	AggregationWorker worker{processor, nullptr, std::chrono::hours(1)};
+
+	HealWindowOptions options;
+	worker.SetWindow(0, &options, false);
+	std::shared_ptr<AggregatedStatsCollection> stats = WaitForPublish(worker, 0);
+	ASSERT_NE(stats, nullptr);
+
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 1;
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(worker.GetStats(0), stats);
+
+	worker.SetRefreshInterval(std::chrono::milliseconds(10));
+	EXPECT_NE(WaitForPublish(worker, 0, stats.get()), nullptr);
+}
+
+TEST(AggregationWorkerTest, PastEncounterIsOnlyAggregatedOnce)
+{
+	EventProcessor processor;
+	AggregationWorker worker{processor, nullptr, std::chrono::milliseconds(10)};
+
+	auto [localId, states] = processor.GetState(1000);
+	processor.GetEncounterHistory().Add(localId, std::move(states));
+	const uint64_t encounterId = processor.GetEncounterHistory().GetEncounters().back()->Id;
+
+	HealWindowOptions options;
+	worker.SetWindow(0, &options, false, encounterId);
+	std::shared_ptr<AggregatedStatsCollection> stats = WaitForPublish(worker, 0);
+	ASSERT_NE(stats, nullptr);
+
+	// The worker froze the encounter before aggregating it, it doesn't change anymore even though new events arrive
+	EXPECT_EQ(processor.GetEncounterHistory().GetEncounter(encounterId)->IsFrozen, true);
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 1;
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_EQ(worker.GetStats(0), stats);
+
+	// Switching back to the current encounter aggregates again
+	worker.SetWindow(0, &options, false);
+	EXPECT_NE(WaitForPublish(worker, 0, stats.get()), nullptr);
+}
+
+// The peer memory usage is kept up to date even when no window is shown
+TEST(AggregationWorkerTest, UpdatesPeerMemoryUsage)
+{
+	EventProcessor processor;
+	AggregationWorker worker{processor, nullptr, std::chrono::milliseconds(10)};
+
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 0; // agent registration
+	source_ag.prof = static_cast<Prof>(1); // agent registration
+	source_ag.id = 2001;
+	dest_ag.id = 101;
+	source_ag.name = "peer1";
+	dest_ag.name = "peer1.1234";
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	cbtevent ev{};
+	ev.time = 1000;
+	ev.src_instid = 101;
+	ev.is_statechange = CBTS_ENTERCOMBAT;
+	processor.PeerCombat(&ev, 101);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (processor.GetPeerMemoryUsage().PeerCount == 0 && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_EQ(processor.GetPeerMemoryUsage().PeerCount, 1U);
+	EXPECT_NE(processor.GetPeerMemoryUsage().TotalBytes, 0U);
+}
@@ -0,0 +1,359 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "CombatEventQueue.h"
+#include "Common.h"
+#include "EventSequencer.h"
+#include "Log.h"
+#include "PlayerStats.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+struct DeliveredEvent
+{
+	uint64_t Id;
+	std::thread::id Thread;
+	bool EventPresent;
+	uint64_t Time;
+	std::string SourceName;
+	std::string DestinationName;
+};
+
+std::mutex DeliveredEventsLock;
+std::vector<DeliveredEvent> DeliveredEvents;
+std::atomic_bool BlockCallback = false;
+
+uintptr_t RecordingCallback(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* /*pSkillname*/, uint64_t pId, uint64_t /*pRevision*/)
+{
+	while (BlockCallback.load() == true)
+	{
+		std::this_thread::yield();
+	}
+
+	DeliveredEvent delivered;
+	delivered.Id = pId;
+	delivered.Thread = std::this_thread::get_id();
+	delivered.EventPresent = (pEvent != nullptr);
+	delivered.Time = pEvent != nullptr ? pEvent->time : 0;
+	delivered.SourceName = (pSourceAgent != nullptr && pSourceAgent->name != nullptr) ? pSourceAgent->name : "";
+	delivered.DestinationName = (pDestinationAgent != nullptr && pDestinationAgent->name != nullptr) ? pDestinationAgent->name : "";
+
+	std::lock_guard lock(DeliveredEventsLock);
+	DeliveredEvents.push_back(std::move(delivered));
+	return 0;
+}
+
+void PushId(CombatEventQueue& pQueue, uint64_t pId)
+{
+	cbtevent ev{};
+	ev.time = pId * 10;
+	pQueue.Push(RecordingCallback, &ev, nullptr, nullptr, nullptr, pId, 1);
+}
+
+class CombatEventQueueTest : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		DeliveredEvents.clear();
+		BlockCallback = false;
+	}
+};
+} // anonymous namespace
+
+TEST_F(CombatEventQueueTest, InOrderOnWorkerThread)
+{
+	CombatEventQueue queue;
+	for (uint64_t id = 1; id <= 1000; id++)
+	{
+		PushId(queue, id);
+	}
+	queue.Flush();
+
+	ASSERT_EQ(DeliveredEvents.size(), 1000);
+	for (uint64_t i = 0; i < DeliveredEvents.size(); i++)
+	{
+		EXPECT_EQ(DeliveredEvents[i].Id, i + 1);
+		EXPECT_EQ(DeliveredEvents[i].Time, (i + 1) * 10);
+		EXPECT_NE(DeliveredEvents[i].Thread, std::this_thread::get_id());
+	}
+
+	CombatEventQueue::Statistics stats = queue.GetStatistics();
+	EXPECT_EQ(stats.PushedEvents, 1000);
+	EXPECT_EQ(stats.ProcessedEvents, 1000);
+}
+
+TEST_F(CombatEventQueueTest, CopiesArguments)
+{
+	CombatEventQueue queue;
+
+	char sourceName[32];
+	char destinationName[32];
+	strcpy(sourceName, "source");
+	strcpy(destinationName, "destination");
+
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.name = sourceName;
+	dest_ag.name = destinationName;
+
+	BlockCallback = true;
+	queue.Push(RecordingCallback, nullptr, &source_ag, &dest_ag, nullptr, 1, 1);
+	queue.Push(RecordingCallback, nullptr, nullptr, nullptr, nullptr, 2, 1);
+
+	// The caller's buffers are gone by the time the worker gets to the events
+	strcpy(sourceName, "overwritten");
+	strcpy(destinationName, "overwritten");
+	source_ag.name = nullptr;
+	dest_ag.name = nullptr;
+
+	BlockCallback = false;
+	queue.Flush();
+
+	ASSERT_EQ(DeliveredEvents.size(), 2);
+	EXPECT_EQ(DeliveredEvents[0].EventPresent, false);
+	EXPECT_EQ(DeliveredEvents[0].SourceName, "source");
+	EXPECT_EQ(DeliveredEvents[0].DestinationName, "destination");
+	EXPECT_EQ(DeliveredEvents[1].SourceName, "");
+	EXPECT_EQ(DeliveredEvents[1].DestinationName, "");
+}
+
+TEST_F(CombatEventQueueTest, FullQueueWaits)
+{
+	CombatEventQueue queue{4};
+
+	BlockCallback = true;
+	std::thread producer{[&queue]()
+		{
+			for (uint64_t id = 1; id <= 100; id++)
+			{
+				PushId(queue, id);
+			}
+		}};
+
+	// The worker holds one event and the ring holds 4 more, so the producer has to be waiting now
+	while (queue.GetStatistics().FullQueueWaits == 0)
+	{
+		std::this_thread::yield();
+	}
+	BlockCallback = false;
+	producer.join();
+	queue.Flush();
+
+	ASSERT_EQ(DeliveredEvents.size(), 100);
+	for (uint64_t i = 0; i < DeliveredEvents.size(); i++)
+	{
+		EXPECT_EQ(DeliveredEvents[i].Id, i + 1);
+	}
+	EXPECT_GE(queue.GetStatistics().FullQueueWaits, 1);
+}
+
+TEST_F(CombatEventQueueTest, MultipleProducers)
+{
+	constexpr uint64_t THREAD_COUNT = 8;
+	constexpr uint64_t EVENTS_PER_THREAD = 10000;
+
+	CombatEventQueue queue{256};
+
+	std::vector<std::thread> threads;
+	for (uint64_t thread = 0; thread < THREAD_COUNT; thread++)
+	{
+		threads.emplace_back([&queue, thread]()
+			{
+				for (uint64_t i = 0; i < EVENTS_PER_THREAD; i++)
+				{
+					// Every thread pushes ids congruent to its index, so the order within each thread can be checked
+					PushId(queue, i * THREAD_COUNT + thread + 1);
+				}
+			});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	queue.Flush();
+
+	ASSERT_EQ(DeliveredEvents.size(), THREAD_COUNT * EVENTS_PER_THREAD);
+
+	std::vector<uint64_t> lastIds(THREAD_COUNT, 0);
+	for (const DeliveredEvent& delivered : DeliveredEvents)
+	{
+		uint64_t thread = (delivered.Id - 1) % THREAD_COUNT;
+		EXPECT_GT(delivered.Id, lastIds[thread]);
+		lastIds[thread] = delivered.Id;
+		EXPECT_EQ(delivered.Time, delivered.Id * 10);
+	}
+}
+
+TEST_F(CombatEventQueueTest, ShutdownDrains)
+{
+	CombatEventQueue queue;
+
+	BlockCallback = true;
+	for (uint64_t id = 1; id <= 100; id++)
+	{
+		PushId(queue, id);
+	}
+	BlockCallback = false;
+	queue.Shutdown();
+
+	EXPECT_EQ(DeliveredEvents.size(), 100);
+	EXPECT_EQ(queue.GetStatistics().ProcessedEvents, 100);
+
+	queue.Shutdown(); // Shutting down twice is fine
+}
+
+namespace
+{
+PlayerStats* BENCHMARK_STATS = nullptr;
+
+// Does the per event work that EventProcessor::LocalCombat does for heals. EventProcessor itself needs the game, so it
+// can't be part of the Linux test target
+uintptr_t BenchmarkLocalCombat(cbtevent* pEvent, ag* /*pSourceAgent*/, ag* pDestinationAgent, const char* /*pSkillname*/, uint64_t /*pId*/, uint64_t /*pRevision*/)
+{
+	if (pEvent == nullptr)
+	{
+		return 0;
+	}
+
+	if (pEvent->is_statechange == CBTS_ENTERCOMBAT)
+	{
+		BENCHMARK_STATS->EnteredCombat(pEvent->time, 1);
+	}
+	else if (GetEventType(pEvent, true) == EventType::Healing && pDestinationAgent != nullptr)
+	{
+		BENCHMARK_STATS->HealingEvent(pEvent, pDestinationAgent->id);
+	}
+	return 0;
+}
+
+EventSequencer* BENCHMARK_SEQUENCER = nullptr;
+
+uintptr_t BenchmarkSequenceEvent(cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId, uint64_t pRevision)
+{
+	return BENCHMARK_SEQUENCER->ProcessEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, pRevision);
+}
+
+// Sends a local combat with pEventCount heals through either the direct callback path or the queue, and returns how
+// long each callback took (which is how long arcdps is blocked for)
+std::vector<std::chrono::nanoseconds> RunCallbackLatency(uint64_t pEventCount, bool pOffload)
+{
+	PlayerStats stats;
+	EventSequencer sequencer{BenchmarkLocalCombat};
+	BENCHMARK_STATS = &stats;
+	BENCHMARK_SEQUENCER = &sequencer;
+
+	std::unique_ptr<CombatEventQueue> queue = pOffload == true ? std::make_unique<CombatEventQueue>() : nullptr;
+	auto callback = [&queue](cbtevent* pEvent, ag* pSourceAgent, ag* pDestinationAgent, const char* pSkillname, uint64_t pId)
+	{
+		if (queue != nullptr)
+		{
+			queue->Push(BenchmarkSequenceEvent, pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, 1);
+		}
+		else
+		{
+			BenchmarkSequenceEvent(pEvent, pSourceAgent, pDestinationAgent, pSkillname, pId, 1);
+		}
+	};
+
+	uint64_t id = 1;
+
+	// Register self
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 0;
+	source_ag.prof = static_cast<Prof>(1);
+	source_ag.id = 1000;
+	source_ag.name = "local";
+	dest_ag.id = 100;
+	dest_ag.name = "local.1234";
+	dest_ag.self = true;
+	callback(nullptr, &source_ag, &dest_ag, nullptr, id++);
+
+	source_ag = {};
+	dest_ag = {};
+	source_ag.id = 1000;
+	source_ag.name = "local";
+	source_ag.self = true;
+	dest_ag.id = 1001;
+	dest_ag.name = "target";
+
+	cbtevent ev{};
+	ev.time = 1;
+	ev.src_agent = 1000;
+	ev.src_instid = 100;
+	ev.is_statechange = CBTS_ENTERCOMBAT;
+	callback(&ev, &source_ag, &dest_ag, nullptr, id++);
+
+	std::vector<std::chrono::nanoseconds> latencies;
+	latencies.reserve(pEventCount);
+	for (uint64_t i = 0; i < pEventCount; i++)
+	{
+		ev = {};
+		ev.time = 2 + i;
+		ev.src_agent = 1000;
+		ev.dst_agent = 1001;
+		ev.src_instid = 100;
+		ev.dst_instid = 101;
+		ev.skillid = 1 + (i % 16);
+		ev.value = 100 + (i % 1000);
+
+		auto start = std::chrono::steady_clock::now();
+		callback(&ev, &source_ag, &dest_ag, "skill", id++);
+		latencies.push_back(std::chrono::steady_clock::now() - start);
+	}
+
+	if (queue != nullptr)
+	{
+		queue->Shutdown();
+	}
+	EXPECT_EQ(sequencer.QueueIsEmpty(), true);
+
+	EXPECT_EQ(stats.GetState().Events.size(), pEventCount);
+
+	BENCHMARK_STATS = nullptr;
+	BENCHMARK_SEQUENCER = nullptr;
+	return latencies;
+}
+
+void LogPercentiles(const char* pName, std::vector<std::chrono::nanoseconds>& pLatencies)
+{
+	std::sort(pLatencies.begin(), pLatencies.end());
+	auto percentile = [&pLatencies](double pPercentile)
+	{
+		return pLatencies[static_cast<size_t>(pPercentile * (pLatencies.size() - 1))].count();
+	};
+
+	LogI("{}: p50={}ns p99={}ns p99.9={}ns max={}ns", pName, percentile(0.5), percentile(0.99), percentile(0.999), pLatencies.back().count());
+}
+} // anonymous namespace
+
+// Run with --gtest_also_run_disabled_tests, the percentiles end up in the log
+TEST(CombatEventQueueBenchmark, DISABLED_CallbackLatency)
+{
+	constexpr uint64_t EVENT_COUNT = 1000000;
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		std::vector<std::chrono::nanoseconds> direct = RunCallbackLatency(EVENT_COUNT, false);
+		LogPercentiles("direct", direct);
+
+		std::vector<std::chrono::nanoseconds> offloaded = RunCallbackLatency(EVENT_COUNT, true);
+		LogPercentiles("offloaded", offloaded);
+	}
+}
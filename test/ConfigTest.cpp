@@ -53,6 +53,12 @@ TEST(ConfigTest, Serialize_Deserialize)
 	options.EvtcLoggingEnabled = rand_t<bool>();
 	rand_string(options.EvtcRpcEndpoint);
 	options.EvtcRpcEnabled = rand_t<bool>();
+	options.RefreshIntervalMs = rand_t<size_t>();
+	options.EncounterHistoryCount = rand_t<size_t>();
+	options.EncounterHistoryBudgetMb = rand_t<size_t>();
+	options.EncounterHistoryKeepEvents = rand_t<bool>();
+	options.EncounterJournalEnabled = rand_t<bool>();
+	options.PeerMemoryBudgetMb = rand_t<size_t>();
 
 	for (HealWindowContext& window : options.Windows)
 	{
@@ -89,6 +95,7 @@ TEST(ConfigTest, Serialize_Deserialize)
 		window.AutoResize = rand_t<bool>();
 		window.MinLinesDisplayed = rand_t<size_t>();
 		window.MaxLinesDisplayed = rand_t<size_t>();
+		window.TopEntriesOnly = rand_t<bool>();
 		window.FixedWindowWidth = rand_t<size_t>();
 	}
 
@@ -106,6 +113,12 @@ TEST(ConfigTest, Serialize_Deserialize)
 	ASSERT_EQ(options.EvtcLoggingEnabled, options2.EvtcLoggingEnabled);
 	ASSERT_EQ(strcmp(options.EvtcRpcEndpoint, options2.EvtcRpcEndpoint), 0);
 	ASSERT_EQ(options.EvtcRpcEnabled, options2.EvtcRpcEnabled);
+	ASSERT_EQ(options.RefreshIntervalMs, options2.RefreshIntervalMs);
+	ASSERT_EQ(options.EncounterHistoryCount, options2.EncounterHistoryCount);
+	ASSERT_EQ(options.EncounterHistoryBudgetMb, options2.EncounterHistoryBudgetMb);
+	ASSERT_EQ(options.EncounterHistoryKeepEvents, options2.EncounterHistoryKeepEvents);
+	ASSERT_EQ(options.EncounterJournalEnabled, options2.EncounterJournalEnabled);
+	ASSERT_EQ(options.PeerMemoryBudgetMb, options2.PeerMemoryBudgetMb);
 
 	for (size_t i = 0; i < options2.Windows.size(); i++)
 	{
@@ -145,6 +158,7 @@ TEST(ConfigTest, Serialize_Deserialize)
 		ASSERT_EQ(windowLeft.AutoResize, windowRight.AutoResize);
 		ASSERT_EQ(windowLeft.MinLinesDisplayed, windowRight.MinLinesDisplayed);
 		ASSERT_EQ(windowLeft.MaxLinesDisplayed, windowRight.MaxLinesDisplayed);
+		ASSERT_EQ(windowLeft.TopEntriesOnly, windowRight.TopEntriesOnly);
 		ASSERT_EQ(windowLeft.FixedWindowWidth, windowRight.FixedWindowWidth);
 	}
 }
@@ -0,0 +1,133 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "AggregatedStats.h"
+#include "EncounterHistory.h"
+#include "TestFights.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace
+{
+std::map<uintptr_t, std::pair<std::string, HealingStats>> BuildEncounter(uint32_t pSeed, size_t pEventCount)
+{
+	std::map<uintptr_t, std::pair<std::string, HealingStats>> result;
+	result.try_emplace(1000, "local", BuildFight(pSeed, pEventCount));
+	result.try_emplace(2000, "peer", BuildFight(pSeed + 1, pEventCount));
+	return result;
+}
+} // anonymous namespace
+
+// Frozen stats have to aggregate to exactly the same result as the live stats they were frozen from, for every combat
+// end condition and whether or not the events were kept
+TEST(EncounterHistoryTest, FrozenStatsMatchLiveStats)
+{
+	const HealingStats fight = BuildFight(1, HealEventTotals::CHECKPOINT_INTERVAL * 3);
+
+	for (bool keepEvents : {false, true})
+	{
+		const HealingStats frozen = EncounterHistory::Freeze(fight, keepEvents);
+		ASSERT_NE(frozen.Frozen, nullptr);
+		EXPECT_EQ(frozen.Events.size(), keepEvents == true ? fight.Events.size() : 0U);
+		EXPECT_EQ(frozen.Totals.GetEventCount(), 0U);
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(CombatEndCondition::Max); i++)
+		{
+			SCOPED_TRACE("keepEvents " + std::to_string(keepEvents) + ", combat end condition " + std::to_string(i));
+
+			HealWindowOptions options;
+			options.CombatEndConditionChoice = static_cast<CombatEndCondition>(i);
+			options.ExcludeMinions = false;
+
+			AggregatedStats live{HealingStats{fight}, options, false};
+			AggregatedStats fromFrozen{HealingStats{frozen}, options, false};
+
+			EXPECT_EQ(fromFrozen.GetCombatTime(), live.GetCombatTime());
+			EXPECT_EQ(fromFrozen.GetTotal().GetTie(), live.GetTotal().GetTie());
+			ExpectEqual(fromFrozen.GetStats(DataSource::Agents), live.GetStats(DataSource::Agents));
+			ExpectEqual(fromFrozen.GetStats(DataSource::Skills), live.GetStats(DataSource::Skills));
+			ExpectEqual(fromFrozen.GetGroupFilterTotals(), live.GetGroupFilterTotals());
+		}
+	}
+}
+
+TEST(EncounterHistoryTest, FreezingReplacesEncounter)
+{
+	EncounterHistory history;
+	history.Add(1000, BuildEncounter(2, 5000));
+
+	std::vector<std::shared_ptr<const EncounterHistory::Encounter>> encounters = history.GetEncounters();
+	ASSERT_EQ(encounters.size(), 1U);
+	std::shared_ptr<const EncounterHistory::Encounter> pending = encounters[0];
+	EXPECT_EQ(pending->IsFrozen, false);
+	EXPECT_EQ(pending->LocalId, 1000U);
+	EXPECT_EQ(pending->EnteredCombatTime, 100000U);
+	EXPECT_NE(pending->ExitedCombatTime, 0U);
+	EXPECT_EQ(pending->EndTime, pending->ExitedCombatTime);
+	EXPECT_EQ(history.GetMemoryUsage(), pending->MemoryUsage);
+
+	history.FreezePending();
+
+	std::shared_ptr<const EncounterHistory::Encounter> frozen = history.GetEncounter(pending->Id);
+	ASSERT_NE(frozen, nullptr);
+	EXPECT_EQ(frozen->IsFrozen, true);
+	EXPECT_EQ(frozen->EndTime, pending->EndTime);
+	EXPECT_EQ(frozen->States.size(), 2U);
+	EXPECT_EQ(frozen->States.at(1000).second.Events.size(), 0U);
+	EXPECT_LT(frozen->MemoryUsage, pending->MemoryUsage); // Events are dropped
+	EXPECT_EQ(history.GetMemoryUsage(), frozen->MemoryUsage);
+
+	// The encounter that was returned before freezing is left as it was
+	EXPECT_EQ(pending->IsFrozen, false);
+	EXPECT_EQ(pending->States.at(1000).second.Events.size(), 5000U);
+
+	// An encounter that was still going on when it was recovered from a journal ends at its collection time
+	std::map<uintptr_t, std::pair<std::string, HealingStats>> unfinished = BuildEncounter(3, 100);
+	unfinished.at(1000).second.ExitedCombatTime = 0;
+	const uint64_t collectionTime = unfinished.at(1000).second.CollectionTime;
+	history.Add(1000, std::move(unfinished));
+	EXPECT_EQ(history.GetEncounters().back()->ExitedCombatTime, 0U);
+	EXPECT_EQ(history.GetEncounters().back()->EndTime, collectionTime);
+}
+
+TEST(EncounterHistoryTest, EvictsOldestEncounters)
+{
+	EncounterHistory history;
+	history.SetLimits(3, SIZE_MAX, false);
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		history.Add(1000, BuildEncounter(i * 2, 1000));
+	}
+
+	std::vector<std::shared_ptr<const EncounterHistory::Encounter>> encounters = history.GetEncounters();
+	ASSERT_EQ(encounters.size(), 3U);
+	EXPECT_EQ(encounters[0]->Id, 3U);
+	EXPECT_EQ(encounters[2]->Id, 5U);
+	EXPECT_EQ(history.GetEncounter(2), nullptr);
+
+	// Budget that only fits one of the frozen encounters
+	history.FreezePending();
+	const size_t frozenSize = history.GetEncounter(5)->MemoryUsage;
+	history.SetLimits(3, frozenSize + frozenSize / 2, false);
+	encounters = history.GetEncounters();
+	ASSERT_EQ(encounters.size(), 1U);
+	EXPECT_EQ(encounters[0]->Id, 5U);
+	EXPECT_EQ(history.GetMemoryUsage(), frozenSize);
+
+	// The newest encounter is kept even if it doesn't fit
+	history.SetLimits(3, 1, false);
+	EXPECT_EQ(history.GetEncounters().size(), 1U);
+
+	history.SetLimits(0, SIZE_MAX, false);
+	EXPECT_EQ(history.GetEncounters().size(), 0U);
+	EXPECT_EQ(history.GetMemoryUsage(), 0U);
+	history.Add(1000, BuildEncounter(1, 1000));
+	EXPECT_EQ(history.GetEncounters().size(), 0U);
+}
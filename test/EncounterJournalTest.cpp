@@ -0,0 +1,325 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "EncounterJournal.h"
+#include "PlayerStats.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+std::string GetJournalPath(const char* pName)
+{
+	return (std::filesystem::temp_directory_path() / pName).string();
+}
+
+void AddHeals(PlayerStats& pStats, std::mt19937_64& pRng, uint64_t& pTime, size_t pCount)
+{
+	for (size_t i = 0; i < pCount; i++)
+	{
+		pTime += pRng() % 5;
+
+		cbtevent event{};
+		event.time = pTime;
+		event.value = static_cast<int32_t>(1 + pRng() % 5000);
+		event.skillid = static_cast<uint32_t>(pRng() % 30);
+		if (pRng() % 5 == 0)
+		{
+			pStats.BarrierEvent(&event, 1000 + pRng() % 10);
+		}
+		else
+		{
+			pStats.HealingEvent(&event, 1000 + pRng() % 10);
+		}
+	}
+}
+} // anonymous namespace
+
+// The journal is read while the writer is still open, like after a crash
+TEST(EncounterJournalTest, ReplayMatchesPlayerStats)
+{
+	const std::string path = GetJournalPath("EncounterJournalTest_Replay.bin");
+	std::shared_ptr<EncounterJournal> journal = std::make_shared<EncounterJournal>(path.c_str());
+	ASSERT_TRUE(journal->IsOpen());
+
+	std::mt19937_64 rng{1};
+	uint64_t time = 100000;
+
+	const std::string longName = "Some Character Name That Needs Several Records";
+	journal->Self(1000);
+	journal->Agent(1000, HealedAgent{1, longName.c_str(), 2, false, true});
+	journal->Agent(2000, HealedAgent{2, "Peer", 3, false, true});
+
+	PlayerStats local;
+	PlayerStats peer;
+	local.SetJournal(journal, EncounterJournal::LOCAL_PLAYER_ID);
+	peer.SetJournal(journal, 2000);
+
+	local.EnteredCombat(time, 2);
+	peer.EnteredCombat(time, 3);
+	AddHeals(local, rng, time, 5000);
+	AddHeals(peer, rng, time, 3000);
+	local.ExitedCombat(time + 10, time - 100);
+	peer.ExitedCombat(time + 10);
+	const HealingStatsSlim firstLocal = local.GetState();
+	const HealingStatsSlim firstPeer = peer.GetState();
+
+	// Second encounter, still in combat when the journal is read. The peer is reset like EventProcessor does it
+	time += 1000;
+	local.EnteredCombat(time, 2);
+	EXPECT_TRUE(peer.ResetIfNotInCombat());
+	AddHeals(local, rng, time, 2000);
+	const HealingStatsSlim secondLocal = local.GetState();
+
+	std::vector<EncounterJournal::Encounter> encounters = EncounterJournal::Read(path.c_str(), SIZE_MAX);
+	ASSERT_EQ(encounters.size(), 2U);
+
+	EXPECT_EQ(encounters[0].LocalId, 1000U);
+	ASSERT_EQ(encounters[0].States.size(), 2U);
+	const auto& [localName, localState] = encounters[0].States.at(1000);
+	EXPECT_EQ(localName, longName);
+	EXPECT_EQ(localState.EnteredCombatTime, firstLocal.EnteredCombatTime);
+	EXPECT_EQ(localState.ExitedCombatTime, firstLocal.ExitedCombatTime);
+	EXPECT_EQ(localState.LastDamageEvent, firstLocal.LastDamageEvent);
+	EXPECT_EQ(localState.SubGroup, 2U);
+	EXPECT_TRUE(localState.Events == firstLocal.Events);
+	EXPECT_EQ(encounters[0].Agents->at(1000).Subgroup, 2U);
+
+	const auto& [peerName, peerState] = encounters[0].States.at(2000);
+	EXPECT_EQ(peerName, "Peer");
+	EXPECT_EQ(peerState.ExitedCombatTime, firstPeer.ExitedCombatTime);
+	EXPECT_TRUE(peerState.Events == firstPeer.Events);
+
+	ASSERT_EQ(encounters[1].States.size(), 1U);
+	const HealingStatsSlim& unfinished = encounters[1].States.at(1000).second;
+	EXPECT_EQ(unfinished.EnteredCombatTime, secondLocal.EnteredCombatTime);
+	EXPECT_EQ(unfinished.ExitedCombatTime, 0U);
+	EXPECT_EQ(encounters[1].CollectionTime, secondLocal.Events.back().Time);
+	EXPECT_TRUE(unfinished.Events == secondLocal.Events);
+
+	journal.reset();
+	local.SetJournal(nullptr, 0);
+	peer.SetJournal(nullptr, 0);
+	std::filesystem::remove(path);
+}
+
+// Only the last encounters are replayed in full. The peer stays in combat the whole time, so its events of the returned
+// encounters start before the first of them
+TEST(EncounterJournalTest, OnlyLastEncountersAreReplayed)
+{
+	const std::string path = GetJournalPath("EncounterJournalTest_Limit.bin");
+	std::shared_ptr<EncounterJournal> journal = std::make_shared<EncounterJournal>(path.c_str());
+	journal->Self(1000);
+
+	PlayerStats local;
+	PlayerStats peer;
+	local.SetJournal(journal, EncounterJournal::LOCAL_PLAYER_ID);
+	peer.SetJournal(journal, 2000);
+
+	std::mt19937_64 rng{4};
+	uint64_t time = 100000;
+	peer.EnteredCombat(time, 3);
+
+	std::vector<HealingStatsSlim> localStates;
+	std::vector<HealingStatsSlim> peerStates;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		time += 1000;
+		local.EnteredCombat(time, 2);
+		AddHeals(local, rng, time, 500);
+		AddHeals(peer, rng, time, 300);
+		if (i < 3)
+		{
+			local.ExitedCombat(time + 10, time);
+		}
+
+		localStates.emplace_back(local.GetState());
+		peerStates.emplace_back(peer.GetState());
+	}
+
+	for (size_t maxEncounters : {1, 2, 4, 10})
+	{
+		std::vector<EncounterJournal::Encounter> encounters = EncounterJournal::Read(path.c_str(), maxEncounters);
+		ASSERT_EQ(encounters.size(), (std::min)(maxEncounters, size_t{4}));
+
+		for (size_t i = 0; i < encounters.size(); i++)
+		{
+			const size_t expected = 4 - encounters.size() + i;
+			SCOPED_TRACE("limit " + std::to_string(maxEncounters) + " encounter " + std::to_string(expected));
+
+			const HealingStatsSlim& localState = encounters[i].States.at(1000).second;
+			EXPECT_EQ(localState.EnteredCombatTime, localStates[expected].EnteredCombatTime);
+			EXPECT_EQ(localState.ExitedCombatTime, localStates[expected].ExitedCombatTime);
+			EXPECT_TRUE(localState.Events == localStates[expected].Events);
+
+			const HealingStatsSlim& peerState = encounters[i].States.at(2000).second;
+			EXPECT_EQ(peerState.EnteredCombatTime, peerStates[expected].EnteredCombatTime);
+			EXPECT_TRUE(peerState.Events == peerStates[expected].Events);
+		}
+	}
+
+	EXPECT_EQ(EncounterJournal::Read(path.c_str(), 0).size(), 0U);
+
+	journal.reset();
+	local.SetJournal(nullptr, 0);
+	peer.SetJournal(nullptr, 0);
+	std::filesystem::remove(path);
+}
+
+TEST(EncounterJournalTest, CorruptRecordEndsJournal)
+{
+	const std::string path = GetJournalPath("EncounterJournalTest_Corrupt.bin");
+	{
+		std::shared_ptr<EncounterJournal> journal = std::make_shared<EncounterJournal>(path.c_str());
+		PlayerStats local;
+		local.SetJournal(journal, EncounterJournal::LOCAL_PLAYER_ID);
+
+		std::mt19937_64 rng{2};
+		uint64_t time = 100000;
+		local.EnteredCombat(time, 1);
+		AddHeals(local, rng, time, 100);
+		EXPECT_EQ(journal->GetRecordCount(), 101U);
+	}
+
+	// Flip a byte in the heal event at index 60 (the first record is EnteredCombat)
+	FILE* file = fopen(path.c_str(), "r+b");
+	ASSERT_NE(file, nullptr);
+	const long offset = 64 + 61 * sizeof(JournalRecord) + 20;
+	ASSERT_EQ(fseek(file, offset, SEEK_SET), 0);
+	int value = fgetc(file);
+	ASSERT_EQ(fseek(file, offset, SEEK_SET), 0);
+	fputc(value ^ 0x10, file);
+	fclose(file);
+
+	std::vector<EncounterJournal::Encounter> encounters = EncounterJournal::Read(path.c_str(), SIZE_MAX);
+	ASSERT_EQ(encounters.size(), 1U);
+	EXPECT_EQ(encounters[0].States.begin()->second.second.Events.size(), 60U);
+
+	std::filesystem::remove(path);
+}
+
+TEST(EncounterJournalTest, GrowsUntilMaximumSize)
+{
+	const std::string path = GetJournalPath("EncounterJournalTest_Grow.bin");
+	const size_t maxSize = EncounterJournal::GROW_SIZE * 3;
+	const size_t maxRecords = (maxSize - 64) / sizeof(JournalRecord);
+
+	std::shared_ptr<EncounterJournal> journal = std::make_shared<EncounterJournal>(path.c_str(), maxSize);
+	PlayerStats local;
+	local.SetJournal(journal, EncounterJournal::LOCAL_PLAYER_ID);
+
+	std::mt19937_64 rng{3};
+	uint64_t time = 100000;
+	local.EnteredCombat(time, 1);
+	AddHeals(local, rng, time, maxRecords + 1000);
+	EXPECT_EQ(journal->GetRecordCount(), maxRecords);
+
+	std::vector<EncounterJournal::Encounter> encounters = EncounterJournal::Read(path.c_str(), SIZE_MAX);
+	ASSERT_EQ(encounters.size(), 1U);
+	const HealEventLog& events = encounters[0].States.begin()->second.second.Events;
+	ASSERT_EQ(events.size(), maxRecords - 1);
+
+	const HealingStatsSlim state = local.GetState();
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		ASSERT_EQ(events[i].Time, state.Events[i].Time) << i;
+		ASSERT_EQ(events[i].Size, state.Events[i].Size) << i;
+		ASSERT_EQ(events[i].AgentId, state.Events[i].AgentId) << i;
+	}
+
+	// Closing cuts the file off after the last record
+	local.SetJournal(nullptr, 0);
+	journal.reset();
+	EXPECT_EQ(std::filesystem::file_size(path), 64 + maxRecords * sizeof(JournalRecord));
+	EXPECT_EQ(EncounterJournal::Read(path.c_str(), SIZE_MAX).size(), 1U);
+
+	std::filesystem::remove(path);
+}
+
+// The local player and the peers write from their own threads while the file grows under them. Every batch of heal
+// events is written in one go, so the records of the players are interleaved but each player's events replay in order
+TEST(EncounterJournalTest, ConcurrentWritersReplayInOrder)
+{
+	const std::string path = GetJournalPath("EncounterJournalTest_Concurrent.bin");
+	std::shared_ptr<EncounterJournal> journal = std::make_shared<EncounterJournal>(path.c_str());
+	ASSERT_TRUE(journal->IsOpen());
+
+	constexpr size_t PLAYER_COUNT = 4;
+	constexpr size_t EVENTS_PER_PLAYER = 30000; // Grows the file a few times
+	journal->Self(1000);
+
+	std::vector<PlayerStats> players(PLAYER_COUNT);
+	for (size_t i = 0; i < PLAYER_COUNT; i++)
+	{
+		players[i].SetJournal(journal, (i == 0) ? EncounterJournal::LOCAL_PLAYER_ID : 1000 + i);
+		players[i].EnteredCombat(100000, 1);
+	}
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < PLAYER_COUNT; i++)
+	{
+		threads.emplace_back([&player = players[i], i]()
+			{
+				std::mt19937_64 rng{10 + i};
+				uint64_t time = 100000;
+				std::vector<cbtevent> events;
+				std::vector<std::pair<cbtevent*, uintptr_t>> batch;
+				for (size_t added = 0; added < EVENTS_PER_PLAYER; added += events.size())
+				{
+					events.resize((std::min)(static_cast<size_t>(1 + rng() % 64), EVENTS_PER_PLAYER - added));
+					batch.clear();
+					for (cbtevent& event : events)
+					{
+						time += rng() % 5;
+						event = cbtevent{};
+						event.time = time;
+						event.value = static_cast<int32_t>(1 + rng() % 5000);
+						event.skillid = static_cast<uint32_t>(rng() % 30);
+						event.is_shields = (rng() % 5 == 0) ? 1 : 0;
+						batch.emplace_back(&event, 1000 + rng() % 10);
+					}
+					player.HealingEvents(batch);
+				}
+				player.ExitedCombat(time + 10);
+			});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(journal->GetRecordCount(), 1 + PLAYER_COUNT * (EVENTS_PER_PLAYER + 2));
+
+	std::vector<EncounterJournal::Encounter> encounters = EncounterJournal::Read(path.c_str(), SIZE_MAX);
+	ASSERT_EQ(encounters.size(), 1U);
+	ASSERT_EQ(encounters[0].States.size(), PLAYER_COUNT);
+	for (size_t i = 0; i < PLAYER_COUNT; i++)
+	{
+		const HealingStatsSlim state = players[i].GetState();
+		const HealingStatsSlim& replayed = encounters[0].States.at(1000 + i).second;
+		EXPECT_EQ(replayed.ExitedCombatTime, state.ExitedCombatTime) << i;
+		EXPECT_EQ(replayed.Events.size(), EVENTS_PER_PLAYER) << i;
+		EXPECT_TRUE(replayed.Events == state.Events) << i;
+	}
+
+	for (PlayerStats& player : players)
+	{
+		player.SetJournal(nullptr, 0);
+	}
+	journal.reset();
+	std::filesystem::remove(path);
+}
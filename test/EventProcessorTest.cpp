@@ -7,10 +7,15 @@
 #pragma warning(pop)
 
 #include "AddonVersion.h"
+#include "EncounterHistory.h"
+#include "EncounterJournal.h"
 #include "EventProcessor.h"
 #include "Exports.h"
 #include "Utilities.h"
 
+#include <filesystem>
+#include <vector>
+
 TEST(EventProcessorTest, ImplicitSelfCombatExitOnSelfDeregister)
 {
 	EventProcessor processor;
@@ -218,6 +223,276 @@ TEST(EventProcessorTest, ResetPeerOnSelfCombatEnter)
 	EXPECT_EQ(peer2_state2->second.second.ExitedCombatTime, 0U);
 }
 
+TEST(EventProcessorTest, PreviousEncounterIsKeptWhenSelfEntersCombat)
+{
+	EventProcessor processor;
+
+	// Register "local.1234"
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 0; // agent registration
+	source_ag.prof = static_cast<Prof>(1); // agent registration
+	source_ag.id = 2000;
+	dest_ag.id = 100;
+	source_ag.name = "local";
+	dest_ag.name = "local.1234";
+	dest_ag.self = true;
+	processor.LocalCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	// Enter combat, nothing to keep yet
+	cbtevent ev{};
+	ev.src_agent = 2000;
+	ev.src_instid = 100;
+	ev.is_statechange = CBTS_ENTERCOMBAT;
+	ev.time = timeGetTime() - 10;
+	source_ag.self = true;
+	processor.LocalCombat(&ev, &source_ag, &dest_ag, nullptr, 0, 0);
+	EXPECT_EQ(processor.GetEncounterHistory().GetEncounters().size(), 0U);
+
+	ev.is_statechange = CBTS_EXITCOMBAT;
+	ev.time += 5;
+	processor.LocalCombat(&ev, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	// Entering combat again clears the state, the finished encounter is kept in the history
+	ev.is_statechange = CBTS_ENTERCOMBAT;
+	ev.time += 1;
+	processor.LocalCombat(&ev, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	std::vector<std::shared_ptr<const EncounterHistory::Encounter>> encounters = processor.GetEncounterHistory().GetEncounters();
+	ASSERT_EQ(encounters.size(), 1U);
+	EXPECT_EQ(encounters[0]->LocalId, 2000U);
+	EXPECT_EQ(encounters[0]->EnteredCombatTime, ev.time - 6);
+	EXPECT_EQ(encounters[0]->ExitedCombatTime, ev.time - 1);
+	ASSERT_NE(encounters[0]->States.find(2000), encounters[0]->States.end());
+
+	auto state = processor.GetState();
+	auto local_state = state.second.find(2000);
+	ASSERT_NE(local_state, state.second.end());
+	EXPECT_EQ(local_state->second.second.EnteredCombatTime, ev.time);
+}
+
+TEST(EventProcessorTest, RecoveredJournalIsAddedToHistory)
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "EventProcessorTest_Journal.bin").string();
+
+	EventProcessor processor;
+	processor.SetEvtcLoggingEnabled(false);
+	processor.SetJournal(std::make_shared<EncounterJournal>(path.c_str()));
+
+	// Register "local.1234"
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 0; // agent registration
+	source_ag.prof = static_cast<Prof>(1); // agent registration
+	source_ag.id = 2000;
+	dest_ag.id = 100;
+	source_ag.name = "local";
+	dest_ag.name = "local.1234";
+	dest_ag.self = true;
+	processor.LocalCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	cbtevent ev{};
+	ev.src_agent = 2000;
+	ev.src_instid = 100;
+	ev.is_statechange = CBTS_ENTERCOMBAT;
+	ev.time = timeGetTime() - 10;
+	source_ag.self = true;
+	processor.LocalCombat(&ev, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	// Heal "peer1", which registers it as well
+	ag heal_dest_ag{};
+	heal_dest_ag.id = 2001;
+	heal_dest_ag.name = "peer1";
+	ev.is_statechange = 0;
+	ev.dst_agent = 2001;
+	ev.dst_instid = 101;
+	ev.value = 100;
+	ev.time += 1;
+	processor.mSelfInstanceId = 100;
+	processor.LocalCombat(&ev, &source_ag, &heal_dest_ag, nullptr, 0, 0);
+
+	ev.is_statechange = CBTS_EXITCOMBAT;
+	ev.time += 1;
+	processor.LocalCombat(&ev, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	// The journal is still open, like it would be after a crash
+	EventProcessor recovered;
+	ASSERT_EQ(recovered.RecoverJournal(path.c_str(), 5), 1U);
+
+	std::vector<std::shared_ptr<const EncounterHistory::Encounter>> encounters = recovered.GetEncounterHistory().GetEncounters();
+	ASSERT_EQ(encounters.size(), 1U);
+	EXPECT_EQ(encounters[0]->LocalId, 2000U);
+	EXPECT_EQ(encounters[0]->EnteredCombatTime, ev.time - 2);
+	EXPECT_EQ(encounters[0]->ExitedCombatTime, ev.time);
+
+	auto local_state = encounters[0]->States.find(2000);
+	ASSERT_NE(local_state, encounters[0]->States.end());
+	EXPECT_EQ(local_state->second.first, "local");
+	ASSERT_EQ(local_state->second.second.Events.size(), 1U);
+	EXPECT_EQ(local_state->second.second.Events[0].Size, 100U);
+	EXPECT_EQ(local_state->second.second.Agents->at(2001).Name, "peer1");
+
+	processor.SetJournal(nullptr);
+	std::filesystem::remove(path);
+}
+
+TEST(EventProcessorTest, InactivePeersAreEvictedOverBudget)
+{
+	EventProcessor processor;
+
+	// Register "peer1.1234" to "peer4.1234"
+	const char* names[][2] = {{"peer1", "peer1.1234"}, {"peer2", "peer2.1234"}, {"peer3", "peer3.1234"}, {"peer4", "peer4.1234"}};
+	for (uint16_t i = 0; i < 4; i++)
+	{
+		ag source_ag{};
+		ag dest_ag{};
+		source_ag.elite = 0; // agent registration
+		source_ag.prof = static_cast<Prof>(1); // agent registration
+		source_ag.id = 2001 + i;
+		dest_ag.id = 101 + i;
+		source_ag.name = names[i][0];
+		dest_ag.name = names[i][1];
+		processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	}
+
+	// peer1 and peer2 heal and leave combat (peer1 first), peer3 stays in combat
+	uint64_t time = timeGetTime() - 10000;
+	for (uint16_t i = 0; i < 3; i++)
+	{
+		cbtevent ev{};
+		ev.time = time++;
+		ev.src_instid = 101 + i;
+		ev.is_statechange = CBTS_ENTERCOMBAT;
+		processor.PeerCombat(&ev, 101 + i);
+
+		for (uint32_t j = 0; j < 100; j++)
+		{
+			cbtevent heal{};
+			heal.time = time++;
+			heal.src_instid = 101 + i;
+			heal.dst_instid = 101 + i;
+			heal.skillid = 1 + j % 3;
+			heal.value = 100;
+			processor.PeerCombat(&heal, 101 + i);
+		}
+
+		if (i < 2)
+		{
+			ev.time = time++;
+			ev.is_statechange = CBTS_EXITCOMBAT;
+			processor.PeerCombat(&ev, 101 + i);
+		}
+	}
+
+	// Nothing is counted until the usage is updated
+	EXPECT_EQ(processor.GetPeerMemoryUsage().PeerCount, 0U);
+	processor.UpdatePeerMemoryUsage();
+	PeerMemoryUsage usage = processor.GetPeerMemoryUsage();
+	EXPECT_EQ(usage.PeerCount, 3U);
+	EXPECT_NE(usage.EventLogBytes, 0U);
+	EXPECT_GT(usage.TotalBytes, usage.EventLogBytes);
+	EXPECT_EQ(usage.EvictedPeerCount, 0U);
+
+	// Just over budget, only the peer that has been inactive the longest is evicted
+	processor.SetPeerMemoryBudget(usage.TotalBytes - 1);
+	EXPECT_EQ(processor.mPeerStates.count(2001), 0U);
+	EXPECT_EQ(processor.mPeerStates.count(2002), 1U);
+	EXPECT_EQ(processor.mPeerStates.count(2003), 1U);
+	EXPECT_EQ(processor.GetPeerMemoryUsage().EvictedPeerCount, 0U);
+	processor.UpdatePeerMemoryUsage();
+	EXPECT_EQ(processor.GetPeerMemoryUsage().EvictedPeerCount, 1U);
+
+	// Peers that are in combat are never evicted, no matter how far over budget
+	processor.SetPeerMemoryBudget(1);
+	EXPECT_EQ(processor.mPeerStates.count(2002), 0U);
+	EXPECT_EQ(processor.mPeerStates.count(2003), 1U);
+
+	// A new peer doesn't get evicted right after being added either
+	cbtevent ev{};
+	ev.time = time++;
+	ev.src_instid = 104;
+	ev.is_statechange = CBTS_ENTERCOMBAT;
+	processor.PeerCombat(&ev, 104);
+
+	processor.UpdatePeerMemoryUsage();
+	usage = processor.GetPeerMemoryUsage();
+	EXPECT_EQ(usage.PeerCount, 2U);
+	EXPECT_EQ(usage.EvictedPeerCount, 2U);
+	EXPECT_EQ(processor.mPeerStates.count(2004), 1U);
+
+	auto state = processor.GetState();
+	EXPECT_EQ(state.second.count(2001), 0U);
+	ASSERT_EQ(state.second.count(2003), 1U);
+	EXPECT_EQ(state.second.at(2003).second.Events.size(), 100U);
+}
+
+// Event times of peers come from their own clocks. The peer that was received from first is evicted first, even when
+// its clock is far ahead of the others
+TEST(EventProcessorTest, PeersWithSkewedClocksAreEvictedInReceiveOrder)
+{
+	EventProcessor processor;
+
+	// Register "peer1.1234" to "peer3.1234"
+	const char* names[][2] = {{"peer1", "peer1.1234"}, {"peer2", "peer2.1234"}, {"peer3", "peer3.1234"}};
+	for (uint16_t i = 0; i < 3; i++)
+	{
+		ag source_ag{};
+		ag dest_ag{};
+		source_ag.elite = 0; // agent registration
+		source_ag.prof = static_cast<Prof>(1); // agent registration
+		source_ag.id = 2001 + i;
+		dest_ag.id = 101 + i;
+		source_ag.name = names[i][0];
+		dest_ag.name = names[i][1];
+		processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	}
+
+	// Received in peer order, peer1's clock is an hour ahead and peer2's an hour behind
+	const int64_t clockOffsets[] = {3600 * 1000, -3600 * 1000, 0};
+	for (uint16_t i = 0; i < 3; i++)
+	{
+		uint64_t time = static_cast<uint64_t>(10 * 3600 * 1000 + clockOffsets[i]);
+		std::vector<cbtevent> events;
+
+		cbtevent ev{};
+		ev.time = time++;
+		ev.src_instid = 101 + i;
+		ev.is_statechange = CBTS_ENTERCOMBAT;
+		events.push_back(ev);
+
+		for (uint32_t j = 0; j < 100; j++)
+		{
+			cbtevent heal{};
+			heal.time = time++;
+			heal.src_instid = 101 + i;
+			heal.dst_instid = 101 + i;
+			heal.skillid = 1 + j % 3;
+			heal.value = 100;
+			events.push_back(heal);
+		}
+
+		ev.time = time++;
+		ev.is_statechange = CBTS_EXITCOMBAT;
+		events.push_back(ev);
+		processor.PeerCombatBatch(events, 101 + i);
+	}
+
+	processor.UpdatePeerMemoryUsage();
+	PeerMemoryUsage usage = processor.GetPeerMemoryUsage();
+	ASSERT_EQ(usage.PeerCount, 3U);
+
+	processor.SetPeerMemoryBudget(usage.TotalBytes - 1);
+	EXPECT_EQ(processor.mPeerStates.count(2001), 0U);
+	EXPECT_EQ(processor.mPeerStates.count(2002), 1U);
+	EXPECT_EQ(processor.mPeerStates.count(2003), 1U);
+
+	processor.UpdatePeerMemoryUsage();
+	usage = processor.GetPeerMemoryUsage();
+	processor.SetPeerMemoryBudget(usage.TotalBytes - 1);
+	EXPECT_EQ(processor.mPeerStates.count(2002), 0U);
+	EXPECT_EQ(processor.mPeerStates.count(2003), 1U);
+}
+
 static std::unique_ptr<cbtevent> LAST_VERSION_EVENT;
 static void e9_ExpectVersionEvent(cbtevent* pEvent, uint32_t pSignature)
 {
@@ -369,4 +644,162 @@ TEST(EventProcessorTest, LogCombatEvent)
 
 	GlobalObjects::ARC_E10 = nullptr;
 	EXPECTED_COMBAT_EVENT = nullptr;
-}
\ No newline at end of file
+}
+
+TEST(EventProcessorTest, PeerCombatBatchMatchesPeerCombat)
+{
+	EventProcessor batchProcessor;
+	EventProcessor singleProcessor;
+
+	for (EventProcessor* processor : {&batchProcessor, &singleProcessor})
+	{
+		// Register "peer1.1234" and a healed agent
+		ag source_ag{};
+		ag dest_ag{};
+		source_ag.elite = 0; // agent registration
+		source_ag.prof = static_cast<Prof>(1); // agent registration
+		source_ag.id = 2001;
+		dest_ag.id = 101;
+		source_ag.name = "peer1";
+		dest_ag.name = "peer1.1234";
+		processor->AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+
+		source_ag.id = 2002;
+		dest_ag.id = 102;
+		source_ag.name = "peer2";
+		dest_ag.name = "peer2.1234";
+		processor->AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	}
+
+	uint64_t time = timeGetTime() - 100;
+	std::vector<cbtevent> events;
+	events.reserve(128); // References to the events are kept below
+
+	// Healing before combat enter should be dropped
+	cbtevent& healBeforeCombat = events.emplace_back();
+	healBeforeCombat.time = time++;
+	healBeforeCombat.src_instid = 101;
+	healBeforeCombat.dst_instid = 102;
+	healBeforeCombat.skillid = 1;
+	healBeforeCombat.value = 10;
+
+	cbtevent& enterCombat = events.emplace_back();
+	enterCombat.time = time++;
+	enterCombat.src_instid = 101;
+	enterCombat.is_statechange = CBTS_ENTERCOMBAT;
+
+	// More events than fit in the pending event buffer of PeerCombatBatch at once
+	for (uint32_t i = 0; i < 80; i++)
+	{
+		cbtevent& ev = events.emplace_back();
+		ev.time = time++;
+		ev.src_instid = 101;
+		ev.dst_instid = (i % 2 == 0) ? 101 : 102;
+		ev.skillid = 1 + (i % 3);
+		ev.value = 100 + i;
+	}
+
+	// Unknown destination should be dropped
+	cbtevent& unknownDestination = events.emplace_back();
+	unknownDestination.time = time++;
+	unknownDestination.src_instid = 101;
+	unknownDestination.dst_instid = 999;
+	unknownDestination.skillid = 1;
+	unknownDestination.value = 1000;
+
+	cbtevent& exitCombat = events.emplace_back();
+	exitCombat.time = time++;
+	exitCombat.src_instid = 101;
+	exitCombat.is_statechange = CBTS_EXITCOMBAT;
+
+	std::vector<cbtevent> singleEvents = events;
+	for (cbtevent& ev : singleEvents)
+	{
+		singleProcessor.PeerCombat(&ev, 101);
+	}
+	batchProcessor.PeerCombatBatch(events, 101);
+
+	auto batchState = batchProcessor.GetState(2000);
+	auto singleState = singleProcessor.GetState(2000);
+
+	auto batchPeer = batchState.second.find(2001);
+	auto singlePeer = singleState.second.find(2001);
+	ASSERT_NE(batchPeer, batchState.second.end());
+	ASSERT_NE(singlePeer, singleState.second.end());
+
+	const HealingStats& batchStats = batchPeer->second.second;
+	const HealingStats& singleStats = singlePeer->second.second;
+	EXPECT_EQ(batchStats.EnteredCombatTime, enterCombat.time);
+	EXPECT_EQ(batchStats.ExitedCombatTime, exitCombat.time);
+	EXPECT_EQ(batchStats.EnteredCombatTime, singleStats.EnteredCombatTime);
+	EXPECT_EQ(batchStats.ExitedCombatTime, singleStats.ExitedCombatTime);
+
+	ASSERT_EQ(batchStats.Events.size(), 80U);
+	EXPECT_EQ(batchStats.Events, singleStats.Events);
+}
+
+TEST(EventProcessorTest, GetStateSharesAgentSnapshot)
+{
+	EventProcessor processor;
+
+	// Register two peers
+	ag source_ag{};
+	ag dest_ag{};
+	source_ag.elite = 0; // agent registration
+	source_ag.prof = static_cast<Prof>(1); // agent registration
+	source_ag.id = 2001;
+	dest_ag.id = 101;
+	source_ag.name = "peer1";
+	dest_ag.name = "peer1.1234";
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	source_ag.id = 2002;
+	dest_ag.id = 102;
+	source_ag.name = "peer2";
+	dest_ag.name = "peer2.1234";
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+
+	for (uint16_t instanceId : {101, 102})
+	{
+		cbtevent enterCombat{};
+		enterCombat.time = timeGetTime();
+		enterCombat.src_instid = instanceId;
+		enterCombat.is_statechange = CBTS_ENTERCOMBAT;
+		processor.PeerCombat(&enterCombat, instanceId);
+	}
+
+	uint64_t generation = processor.mAgentTable.GetGeneration();
+	auto [localId, states] = processor.GetState(2000);
+	ASSERT_EQ(states.size(), 3U);
+
+	std::shared_ptr<const AgentSnapshot> agents = states[2000].second.Agents;
+	ASSERT_NE(agents, nullptr);
+	EXPECT_EQ(agents->size(), 2U);
+	EXPECT_EQ(states[2001].second.Agents, agents);
+	EXPECT_EQ(states[2002].second.Agents, agents);
+	EXPECT_EQ(states[2001].first, "peer1");
+	EXPECT_EQ(states[2002].first, "peer2");
+
+	// Nothing changed, so the next call reuses the snapshot
+	auto [localId2, states2] = processor.GetState(2000);
+	EXPECT_EQ(states2[2000].second.Agents, agents);
+	EXPECT_EQ(processor.mAgentTable.GetGeneration(), generation);
+
+	// Re-registering the same agent doesn't change anything either
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	EXPECT_EQ(processor.mAgentTable.GetGeneration(), generation);
+	EXPECT_EQ(processor.GetState(2000).second[2000].second.Agents, agents);
+
+	// A new agent results in a new snapshot, the old one is left untouched
+	source_ag.id = 2003;
+	dest_ag.id = 103;
+	source_ag.name = "peer3";
+	dest_ag.name = "peer3.1234";
+	processor.AreaCombat(nullptr, &source_ag, &dest_ag, nullptr, 0, 0);
+	EXPECT_EQ(processor.mAgentTable.GetGeneration(), generation + 1);
+
+	auto [localId3, states3] = processor.GetState(2000);
+	EXPECT_NE(states3[2000].second.Agents, agents);
+	EXPECT_EQ(states3[2000].second.Agents->size(), 3U);
+	EXPECT_EQ(agents->size(), 2U);
+}
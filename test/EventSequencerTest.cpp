@@ -0,0 +1,466 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "EventSequencer.h"
+#include "Log.h"
+
+#include "spdlog/stopwatch.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+std::vector<uint64_t> DeliveredIds;
+
+uintptr_t RecordingCallback(cbtevent* pEvent, ag* /*pSourceAgent*/, ag* /*pDestinationAgent*/, const char* /*pSkillname*/, uint64_t pId, uint64_t /*pRevision*/)
+{
+	DeliveredIds.push_back(pId);
+
+	// The event contents should be carried along with the id
+	if (pEvent != nullptr)
+	{
+		EXPECT_EQ(pEvent->time, pId * 10);
+	}
+	return 0;
+}
+
+// Reorders ids [1, pCount] the same way CombatMock::ExecuteFromXevtc fuzzes events - the next event sent is picked at
+// random from up to pMaxFuzzWidth events after the first one that hasn't been sent yet
+std::vector<uint64_t> FuzzIds(uint64_t pCount, uint32_t pMaxFuzzWidth, uint32_t pSeed)
+{
+	std::mt19937 random{pSeed};
+
+	std::vector<uint64_t> remaining;
+	remaining.reserve(pCount);
+	for (uint64_t i = 1; i <= pCount; i++)
+	{
+		remaining.push_back(i);
+	}
+
+	std::vector<uint64_t> result;
+	result.reserve(pCount);
+
+	// The first event is always sent in order so that the sequencer starts from the right id
+	result.push_back(remaining.front());
+	remaining.erase(remaining.begin());
+
+	size_t start = 0;
+	std::vector<bool> sent(remaining.size(), false);
+	while (result.size() < pCount)
+	{
+		while (sent[start] == true)
+		{
+			start++;
+		}
+
+		size_t fuzzSize = random() % (pMaxFuzzWidth + 1);
+		size_t index = std::min(start + fuzzSize, remaining.size() - 1);
+		while (sent[index] == true)
+		{
+			index--;
+		}
+
+		sent[index] = true;
+		result.push_back(remaining[index]);
+	}
+
+	return result;
+}
+
+void SendIds(EventSequencer& pSequencer, const std::vector<uint64_t>& pIds)
+{
+	for (uint64_t id : pIds)
+	{
+		cbtevent ev{};
+		ev.time = id * 10;
+		pSequencer.ProcessEvent(&ev, nullptr, nullptr, nullptr, id, 1);
+	}
+}
+
+void ExpectInOrder(uint64_t pCount)
+{
+	ASSERT_EQ(DeliveredIds.size(), pCount);
+	for (uint64_t i = 0; i < pCount; i++)
+	{
+		ASSERT_EQ(DeliveredIds[i], i + 1);
+	}
+}
+
+class EventSequencerFuzzFixture : public ::testing::TestWithParam<uint32_t>
+{
+protected:
+	void SetUp() override
+	{
+		DeliveredIds.clear();
+	}
+};
+} // anonymous namespace
+
+TEST(EventSequencerTest, InOrder)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	std::vector<uint64_t> ids;
+	for (uint64_t i = 1; i <= 1000; i++)
+	{
+		ids.push_back(i);
+	}
+	SendIds(sequencer, ids);
+
+	ExpectInOrder(1000);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+}
+
+TEST(EventSequencerTest, Reversed)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	// Send 1 first to establish the starting point, then everything else backwards so that the whole window is used
+	std::vector<uint64_t> ids{1};
+	for (uint64_t i = 256 + 1; i > 1; i--)
+	{
+		ids.push_back(i);
+	}
+	SendIds(sequencer, ids);
+
+	ExpectInOrder(256 + 1);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+}
+
+TEST(EventSequencerTest, NullArgumentsAndAgents)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	ag source{};
+	source.id = 5;
+	source.name = "source";
+
+	sequencer.ProcessEvent(nullptr, &source, nullptr, nullptr, 1, 1);
+	sequencer.ProcessEvent(nullptr, nullptr, &source, nullptr, 3, 1);
+	sequencer.ProcessEvent(nullptr, &source, &source, nullptr, 2, 1);
+
+	ExpectInOrder(3);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+}
+
+TEST(EventSequencerTest, Overflow)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	// Event 2 is stalled while everything after it arrives, which is far more than fits in the reorder window
+	std::vector<uint64_t> ids{1};
+	for (uint64_t i = 3; i <= 2000; i++)
+	{
+		ids.push_back(i);
+	}
+	SendIds(sequencer, ids);
+
+	EXPECT_EQ(DeliveredIds.size(), 1U);
+	EXPECT_FALSE(sequencer.QueueIsEmpty());
+
+	SendIds(sequencer, std::vector<uint64_t>{2});
+
+	ExpectInOrder(2000);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+
+	EventSequencer::Statistics statistics = sequencer.GetStatistics();
+	EXPECT_EQ(statistics.HighestQueueSize, 2000U - 2U);
+	EXPECT_EQ(statistics.OverflowedEvents, 2000U - 2U - 255U); // ids 3 to 257 fit in the window
+	EXPECT_EQ(statistics.OutOfOrderDeliveries, 0U);
+	EXPECT_EQ(statistics.DelayedDeliveries, 2000U - 2U);
+
+	// Depth goes 1, 2, ..., 1998 while queueing, so every bucket up to 512-1023 is full and 1024-2047 is partially filled
+	for (size_t i = 0; i < EventSequencer::QUEUE_DEPTH_BUCKET_COUNT; i++)
+	{
+		uint64_t expected = 0;
+		if (i <= 9)
+		{
+			expected = 1ULL << i;
+		}
+		else if (i == 10)
+		{
+			expected = 1998 - 1023;
+		}
+		EXPECT_EQ(statistics.QueueDepthHistogram[i], expected) << i;
+	}
+}
+
+TEST(EventSequencerTest, OverflowFull)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	// Ids up to 1 + 256 fit in the ring and the next 64k in the overflow segment, the last 10 events don't fit anywhere
+	constexpr static uint64_t LAST_ID = 1 + 256 + 64 * 1024 + 10;
+	std::vector<uint64_t> ids{1};
+	for (uint64_t i = 3; i <= LAST_ID; i++)
+	{
+		ids.push_back(i);
+	}
+	SendIds(sequencer, ids);
+
+	ASSERT_EQ(DeliveredIds.size(), 1U + 10U);
+	for (uint64_t i = 0; i < 10; i++)
+	{
+		EXPECT_EQ(DeliveredIds[1 + i], LAST_ID - 9 + i);
+	}
+
+	// Everything else is still delivered in order once the stalled event arrives
+	SendIds(sequencer, std::vector<uint64_t>{2});
+	ASSERT_EQ(DeliveredIds.size(), LAST_ID);
+	for (uint64_t i = 11; i < LAST_ID; i++)
+	{
+		ASSERT_EQ(DeliveredIds[i], i - 9);
+	}
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+	EXPECT_EQ(sequencer.GetStatistics().OutOfOrderDeliveries, 10U);
+	EXPECT_EQ(sequencer.GetStatistics().OverflowFullEvents, 10U);
+
+	// And the sequencer keeps working afterwards
+	SendIds(sequencer, std::vector<uint64_t>{LAST_ID + 2, LAST_ID + 1});
+	EXPECT_EQ(DeliveredIds.back(), LAST_ID + 2);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+}
+
+TEST(EventSequencerTest, Duplicates)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	// 1 is a duplicate of the current highest id, 3 is a duplicate of a queued event
+	SendIds(sequencer, std::vector<uint64_t>{1, 1, 3, 3, 2});
+
+	EXPECT_EQ(DeliveredIds, (std::vector<uint64_t>{1, 1, 3, 2, 3}));
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+
+	EventSequencer::Statistics statistics = sequencer.GetStatistics();
+	EXPECT_EQ(statistics.OutOfOrderDeliveries, 2U);
+	EXPECT_EQ(statistics.DuplicateEvents, 2U);
+	EXPECT_EQ(statistics.LowerThanHighestEvents, 0U);
+	EXPECT_EQ(statistics.OverflowFullEvents, 0U);
+}
+
+TEST(EventSequencerTest, DuplicateOfOverflowedEvent)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	// 300 and 400 don't fit in the window yet and go to the overflow segment
+	SendIds(sequencer, std::vector<uint64_t>{1, 300, 400});
+
+	// Once the window has moved far enough, a duplicate of 300 is queued in the ring and delivered from there
+	std::vector<uint64_t> ids;
+	for (uint64_t i = 2; i <= 50; i++)
+	{
+		ids.push_back(i);
+	}
+	ids.push_back(300);
+	for (uint64_t i = 51; i <= 399; i++)
+	{
+		if (i != 300)
+		{
+			ids.push_back(i);
+		}
+	}
+	SendIds(sequencer, ids);
+
+	// The overflowed copy of 300 must not keep 400 from being delivered
+	std::vector<uint64_t> expected;
+	for (uint64_t i = 1; i <= 300; i++)
+	{
+		expected.push_back(i);
+	}
+	expected.push_back(300);
+	for (uint64_t i = 301; i <= 400; i++)
+	{
+		expected.push_back(i);
+	}
+	EXPECT_EQ(DeliveredIds, expected);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+	EXPECT_EQ(sequencer.GetStatistics().DuplicateEvents, 1U);
+}
+
+TEST(EventSequencerTest, LowerThanHighest)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	SendIds(sequencer, std::vector<uint64_t>{5, 6, 4});
+
+	EXPECT_EQ(DeliveredIds, (std::vector<uint64_t>{5, 6, 4}));
+	EventSequencer::Statistics statistics = sequencer.GetStatistics();
+	EXPECT_EQ(statistics.OutOfOrderDeliveries, 1U);
+	EXPECT_EQ(statistics.LowerThanHighestEvents, 1U);
+}
+
+TEST(EventSequencerTest, DwellTime)
+{
+	DeliveredIds.clear();
+	EventSequencer sequencer{RecordingCallback};
+
+	SendIds(sequencer, std::vector<uint64_t>{1, 3, 4});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	SendIds(sequencer, std::vector<uint64_t>{2});
+
+	ExpectInOrder(4);
+
+	EventSequencer::Statistics statistics = sequencer.GetStatistics();
+	EXPECT_EQ(statistics.DelayedDeliveries, 2U);
+	EXPECT_GE(statistics.HighestDwellTime, std::chrono::milliseconds(40)); // Leave some room for timeGetTime() resolution
+	EXPECT_GE(statistics.TotalDwellTime, std::chrono::milliseconds(80));
+	EXPECT_EQ(statistics.QueueDepthHistogram[0], 1U); // 3 queued with depth 1
+	EXPECT_EQ(statistics.QueueDepthHistogram[1], 1U); // 4 queued with depth 2
+}
+
+TEST(EventSequencerTest, QueuedAgentNames)
+{
+	EventSequencer sequencer{[](cbtevent*, ag* pSourceAgent, ag* pDestinationAgent, const char*, uint64_t pId, uint64_t) -> uintptr_t
+	{
+		EXPECT_STREQ(pSourceAgent->name, (pId % 2 == 0) ? "even" : "odd");
+		EXPECT_EQ(pDestinationAgent->name, nullptr);
+		return 0;
+	}};
+
+	// The sequencer has to keep its own copy of the names, arcdps reuses the memory after the callback returns
+	char buffer[32];
+	ag source{};
+	ag destination{};
+	source.name = buffer;
+	destination.name = nullptr;
+
+	strcpy(buffer, "odd");
+	sequencer.ProcessEvent(nullptr, &source, &destination, nullptr, 1, 1);
+	for (uint64_t i = 100; i > 2; i--)
+	{
+		strcpy(buffer, (i % 2 == 0) ? "even" : "odd");
+		sequencer.ProcessEvent(nullptr, &source, &destination, nullptr, i, 1);
+	}
+	strcpy(buffer, "even");
+	sequencer.ProcessEvent(nullptr, &source, &destination, nullptr, 2, 1);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+}
+
+TEST(AgentNameTableTest, Intern)
+{
+	AgentNameTable table;
+
+	char buffer1[32] = "Zarwae";
+	char buffer2[32] = "Zarwae";
+
+	const char* name1 = table.Intern(buffer1);
+	EXPECT_NE(name1, buffer1);
+	EXPECT_STREQ(name1, "Zarwae");
+
+	// Same content, different pointer
+	EXPECT_EQ(table.Intern(buffer2), name1);
+	EXPECT_EQ(table.Intern(buffer1), name1);
+
+	// Same pointer, different content
+	strcpy(buffer1, "Other name");
+	const char* name2 = table.Intern(buffer1);
+	EXPECT_NE(name2, name1);
+	EXPECT_STREQ(name2, "Other name");
+	EXPECT_STREQ(name1, "Zarwae");
+
+	EXPECT_EQ(table.Intern(""), table.Intern(""));
+	EXPECT_EQ(table.GetNameCount(), 3U);
+}
+
+TEST_P(EventSequencerFuzzFixture, SingleThreaded)
+{
+	EventSequencer sequencer{RecordingCallback};
+
+	constexpr static uint64_t EVENT_COUNT = 100'000;
+	SendIds(sequencer, FuzzIds(EVENT_COUNT, GetParam(), 1234));
+
+	ExpectInOrder(EVENT_COUNT);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+}
+
+TEST_P(EventSequencerFuzzFixture, MultiThreaded)
+{
+	EventSequencer sequencer{RecordingCallback};
+
+	// Kept below the overflow segment size, a thread can get descheduled while all the other threads process the rest of
+	// the events
+	constexpr static uint64_t EVENT_COUNT = 50'000;
+	constexpr static size_t THREAD_COUNT = 16;
+	std::vector<uint64_t> ids = FuzzIds(EVENT_COUNT, GetParam(), 1234);
+
+	// The first event has to be processed before anything else so the sequencer knows where to start
+	SendIds(sequencer, std::vector<uint64_t>{ids.front()});
+
+	std::atomic_size_t nextIndex = 1;
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < THREAD_COUNT; i++)
+	{
+		threads.emplace_back([&sequencer, &ids, &nextIndex]()
+		{
+			while (true)
+			{
+				size_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+				if (index >= ids.size())
+				{
+					return;
+				}
+
+				cbtevent ev{};
+				ev.time = ids[index] * 10;
+				sequencer.ProcessEvent(&ev, nullptr, nullptr, nullptr, ids[index], 1);
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	ExpectInOrder(EVENT_COUNT);
+	EXPECT_TRUE(sequencer.QueueIsEmpty());
+	EXPECT_EQ(sequencer.GetStatistics().OutOfOrderDeliveries, 0U);
+}
+
+TEST_P(EventSequencerFuzzFixture, DISABLED_Benchmark)
+{
+	constexpr static uint64_t EVENT_COUNT = 10'000'000;
+	constexpr static uint32_t ITERATIONS = 5;
+
+	std::vector<uint64_t> ids = FuzzIds(EVENT_COUNT, GetParam(), 1234);
+	DeliveredIds.reserve(EVENT_COUNT);
+
+	for (uint32_t i = 0; i < ITERATIONS; i++)
+	{
+		DeliveredIds.clear();
+		EventSequencer sequencer{RecordingCallback};
+
+		spdlog::stopwatch stopwatch;
+		SendIds(sequencer, ids);
+		double elapsed = stopwatch.elapsed().count();
+
+		LogI("Fuzz width {} - {} events in {:.3f}s ({:.1f}ns per event)", GetParam(), EVENT_COUNT, elapsed, elapsed * 1'000'000'000.0 / EVENT_COUNT);
+
+		ExpectInOrder(EVENT_COUNT);
+	}
+}
+
+// Same fuzz widths as XevtcLogTestFixture
+INSTANTIATE_TEST_SUITE_P(
+	Fuzz,
+	EventSequencerFuzzFixture,
+	::testing::Values(16, 64));
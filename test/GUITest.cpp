@@ -7,6 +7,7 @@
 #pragma warning(pop)
 
 #include "GUI.h"
+#include "Utilities.h"
 
 TEST(GUITest, LoopDetection)
 {
@@ -47,3 +48,13 @@ TEST(GUITest, LoopDetection)
 		}
 	}
 }
+
+TEST(GUITest, ReplaceFormattedTwoDigitKeys)
+{
+	std::array<std::optional<std::variant<uint64_t, double>>, 10> values{
+		uint64_t{1}, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, std::nullopt, 2.5, uint64_t{10}};
+
+	char buffer[128];
+	ReplaceFormatted(buffer, sizeof(buffer), "{1} {9} {10} {2} {11} {0} {100}", values);
+	EXPECT_STREQ(buffer, "1 2.5 10 {2} {11} {0} {100}");
+}
@@ -0,0 +1,316 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "HealEventLog.h"
+#include "Log.h"
+#include "PlayerStats.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+void AppendEvents(HealEventLog& pLog, uint64_t pFirst, uint64_t pCount)
+{
+	for (uint64_t i = pFirst; i < pFirst + pCount; i++)
+	{
+		pLog.emplace_back(i, i * 2, i % 50, static_cast<uint32_t>(i % 7), i % 3 == 0);
+	}
+}
+
+void ExpectEvents(const HealEventLog& pLog, uint64_t pFirst, uint64_t pCount)
+{
+	ASSERT_EQ(pLog.size(), pCount);
+
+	uint64_t i = pFirst;
+	for (const HealEvent& event : pLog)
+	{
+		ASSERT_EQ(event, HealEvent(i, i * 2, i % 50, static_cast<uint32_t>(i % 7), i % 3 == 0)) << i;
+		i++;
+	}
+	EXPECT_EQ(i, pFirst + pCount);
+}
+} // anonymous namespace
+
+TEST(HealEventLogTest, Append)
+{
+	HealEventLog log;
+	EXPECT_TRUE(log.empty());
+	EXPECT_EQ(log.begin(), log.end());
+
+	constexpr uint64_t COUNT = HealEventLog::CHUNK_SIZE * 3 + 17;
+	AppendEvents(log, 0, COUNT);
+
+	ExpectEvents(log, 0, COUNT);
+	EXPECT_EQ(log.back().Time, COUNT - 1);
+	EXPECT_EQ(log[HealEventLog::CHUNK_SIZE].Time, HealEventLog::CHUNK_SIZE);
+}
+
+TEST(HealEventLogTest, CopiesAreNotAffectedByAppends)
+{
+	HealEventLog log;
+	AppendEvents(log, 0, HealEventLog::CHUNK_SIZE + 10);
+
+	HealEventLog copy = log;
+	const uint32_t* firstSizes = copy.GetChunk(0).Sizes;
+
+	AppendEvents(log, HealEventLog::CHUNK_SIZE + 10, HealEventLog::CHUNK_SIZE * 2);
+
+	ExpectEvents(copy, 0, HealEventLog::CHUNK_SIZE + 10);
+	ExpectEvents(log, 0, HealEventLog::CHUNK_SIZE * 3 + 10);
+
+	// Events aren't moved when appending
+	EXPECT_EQ(log.GetChunk(0).Sizes, firstSizes);
+}
+
+TEST(HealEventLogTest, DivergingCopies)
+{
+	HealEventLog log;
+	AppendEvents(log, 0, 100);
+	HealEventLog copy = log;
+
+	// Both logs continue from the same partially filled chunk. The first one to append gets to use it, the other one
+	// has to copy it
+	AppendEvents(log, 100, 10);
+	AppendEvents(copy, 1000, 10);
+
+	ASSERT_EQ(log.size(), 110U);
+	ASSERT_EQ(copy.size(), 110U);
+	for (uint64_t i = 0; i < 100; i++)
+	{
+		EXPECT_EQ(log[i], copy[i]);
+	}
+	EXPECT_EQ(log[100].Time, 100U);
+	EXPECT_EQ(copy[100].Time, 1000U);
+	EXPECT_NE(log, copy);
+}
+
+TEST(HealEventLogTest, ClearKeepsCopies)
+{
+	HealEventLog log;
+	AppendEvents(log, 0, 100);
+	HealEventLog copy = log;
+
+	log.clear();
+	EXPECT_TRUE(log.empty());
+	AppendEvents(log, 500, 10);
+
+	ExpectEvents(copy, 0, 100);
+	ExpectEvents(log, 500, 10);
+}
+
+TEST(HealEventLogTest, ConcurrentSnapshots)
+{
+	// Same pattern as PlayerStats - appends and snapshots are serialized by a lock, but reading the snapshots isn't
+	std::mutex lock;
+	HealEventLog log;
+	std::atomic_bool done = false;
+
+	std::thread writer{[&]()
+		{
+			for (uint64_t i = 0; i < HealEventLog::CHUNK_SIZE * 4; i++)
+			{
+				std::lock_guard guard(lock);
+				AppendEvents(log, i, 1);
+			}
+			done = true;
+		}};
+
+	while (done == false)
+	{
+		HealEventLog snapshot;
+		{
+			std::lock_guard guard(lock);
+			snapshot = log;
+		}
+		ExpectEvents(snapshot, 0, snapshot.size());
+	}
+	writer.join();
+
+	ExpectEvents(log, 0, HealEventLog::CHUNK_SIZE * 4);
+}
+
+TEST(HealEventLogTest, Columns)
+{
+	HealEventLog log;
+	log.emplace_back(1000, 500, 0x1234567890, 9, false);
+	log.emplace_back(995, 200, 0x2000, 10, true); // Slightly earlier than the first event
+	log.emplace_back(2000, 300, 0x1234567890, 11, false);
+
+	EXPECT_EQ(log.GetBaseTime(), 1000U);
+	ASSERT_EQ(log.GetChunkCount(), 1U);
+	ASSERT_EQ(log.GetAgentCount(), 2U);
+	EXPECT_EQ(log.GetAgentId(0), 0x1234567890U);
+	EXPECT_EQ(log.GetAgentId(1), 0x2000U);
+
+	HealEventLog::ColumnChunk chunk = log.GetChunk(0);
+	ASSERT_EQ(chunk.Count, 3U);
+	EXPECT_EQ(chunk.TimeOffsets[0], 0);
+	EXPECT_EQ(chunk.TimeOffsets[1], -5);
+	EXPECT_EQ(chunk.TimeOffsets[2], 1000);
+	EXPECT_EQ(chunk.Sizes[1], 200U);
+	EXPECT_EQ(chunk.SkillIds[2], 11U);
+	EXPECT_EQ(chunk.AgentIndices[0], 0U);
+	EXPECT_EQ(chunk.AgentIndices[1], 1U);
+	EXPECT_EQ(chunk.AgentIndices[2], 0U);
+	EXPECT_EQ(chunk.Flags[0], 0U);
+	EXPECT_EQ(chunk.Flags[1], HealEventLog::EventFlags_IsBarrier);
+
+	EXPECT_EQ(log[1], HealEvent(995, 200, 0x2000, 10, true));
+	EXPECT_EQ(log.begin()->AgentId, 0x1234567890U);
+
+	// Agents added after taking a copy don't show up in the copy
+	HealEventLog copy = log;
+	log.emplace_back(3000, 1, 0x3000, 1, false);
+	EXPECT_EQ(log.GetAgentCount(), 3U);
+	EXPECT_EQ(copy.GetAgentCount(), 2U);
+}
+
+TEST(HealEventLogTest, RandomAccessIterator)
+{
+	HealEventLog log;
+	constexpr uint64_t COUNT = HealEventLog::CHUNK_SIZE * 2;
+	AppendEvents(log, 0, COUNT);
+
+	EXPECT_EQ(log.end() - log.begin(), static_cast<ptrdiff_t>(COUNT));
+	EXPECT_EQ((log.begin() + HealEventLog::CHUNK_SIZE)->Time, HealEventLog::CHUNK_SIZE);
+	EXPECT_EQ(log.begin()[HealEventLog::CHUNK_SIZE - 1].Time, HealEventLog::CHUNK_SIZE - 1);
+	EXPECT_EQ((log.end() - 1)->Time, COUNT - 1);
+	EXPECT_LT(log.begin(), log.end());
+
+	// Walk backwards across the chunk boundary
+	auto iter = log.end();
+	for (uint64_t i = COUNT; i > 0; i--)
+	{
+		--iter;
+		ASSERT_EQ(iter->Time, i - 1);
+	}
+	EXPECT_EQ(iter, log.begin());
+
+	// Times are increasing, so binary search works
+	auto found = std::lower_bound(log.begin(), log.end(), 5000, [](const HealEvent& pEvent, uint64_t pTime)
+		{
+			return pEvent.Time < pTime;
+		});
+	ASSERT_NE(found, log.end());
+	EXPECT_EQ(found->Time, 5000U);
+}
+
+TEST(HealEventLogTest, Sorted)
+{
+	HealEventLog log;
+	EXPECT_TRUE(log.IsSorted());
+
+	// Equal times are still sorted
+	for (uint64_t i = 0; i < HealEventLog::CHUNK_SIZE * 2; i++)
+	{
+		log.emplace_back(100 + i / 2, 1, 1, 1, false);
+	}
+	EXPECT_TRUE(log.IsSorted());
+	EXPECT_EQ(log.UpperBound(0, 99), 0U);
+	EXPECT_EQ(log.UpperBound(0, 100), 2U);
+	EXPECT_EQ(log.UpperBound(0, 100 + HealEventLog::CHUNK_SIZE / 2), HealEventLog::CHUNK_SIZE + 2);
+	EXPECT_EQ(log.UpperBound(HealEventLog::CHUNK_SIZE + 10, 100), HealEventLog::CHUNK_SIZE + 10);
+	EXPECT_EQ(log.UpperBound(0, 100000), log.size());
+
+	HealEventLog copy = log;
+	log.emplace_back(50, 1, 1, 1, false);
+	EXPECT_FALSE(log.IsSorted());
+	EXPECT_TRUE(copy.IsSorted());
+
+	log.emplace_back(100000, 1, 1, 1, false);
+	EXPECT_FALSE(log.IsSorted());
+
+	log.clear();
+	EXPECT_TRUE(log.IsSorted());
+}
+
+TEST(HealEventLogTest, StartsWith)
+{
+	HealEventLog log;
+	HealEventLog empty = log;
+	for (uint64_t i = 0; i < HealEventLog::CHUNK_SIZE + 10; i++)
+	{
+		log.emplace_back(100 + i, 1, 1, 1, false);
+	}
+	EXPECT_TRUE(log.StartsWith(empty));
+	EXPECT_TRUE(log.StartsWith(log));
+
+	HealEventLog prefix = log;
+	log.emplace_back(100000, 1, 1, 1, false);
+	EXPECT_TRUE(log.StartsWith(prefix));
+	EXPECT_FALSE(prefix.StartsWith(log));
+
+	// Same events in different storage
+	HealEventLog rebuilt;
+	for (const HealEvent& event : prefix)
+	{
+		rebuilt.emplace_back(event.Time, event.Size, event.AgentId, event.SkillId, event.IsBarrier);
+	}
+	EXPECT_FALSE(log.StartsWith(rebuilt));
+
+	log.clear();
+	EXPECT_FALSE(log.StartsWith(prefix));
+}
+
+namespace
+{
+struct AppendResult
+{
+	double TotalSeconds;
+	double WorstAppendMicroseconds;
+};
+
+template <typename Container>
+AppendResult BenchmarkAppend(uint64_t pEventCount, uint64_t pSnapshotInterval)
+{
+	Container container;
+	std::optional<Container> snapshot; // Keeps a copy around like GetState does, as long as the GUI is using it
+
+	double worst = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < pEventCount; i++)
+	{
+		auto appendStart = std::chrono::steady_clock::now();
+		container.emplace_back(i, i * 2, i % 50, static_cast<uint32_t>(i % 7), i % 3 == 0);
+		if (i % pSnapshotInterval == 0)
+		{
+			snapshot.emplace(container);
+		}
+		worst = (std::max)(worst, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - appendStart).count());
+	}
+
+	double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	EXPECT_EQ(container.size(), pEventCount);
+	return AppendResult{total, worst};
+}
+} // anonymous namespace
+
+TEST(HealEventLogTest, DISABLED_AppendBenchmark)
+{
+	constexpr uint64_t EVENT_COUNT = 1'000'000;
+
+	// Snapshot interval roughly matches one GetState per second at about 1000 events per second
+	for (uint64_t snapshotInterval : std::array<uint64_t, 2>{EVENT_COUNT + 1, 1000})
+	{
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			AppendResult vector = BenchmarkAppend<std::vector<HealEvent>>(EVENT_COUNT, snapshotInterval);
+			AppendResult log = BenchmarkAppend<HealEventLog>(EVENT_COUNT, snapshotInterval);
+
+			LogI("snapshot every {}: std::vector {:.3f}s (worst append {:.1f}us), HealEventLog {:.3f}s (worst append {:.1f}us)",
+				snapshotInterval, vector.TotalSeconds, vector.WorstAppendMicroseconds, log.TotalSeconds, log.WorstAppendMicroseconds);
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "RollingHealing.h"
+
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+struct Event
+{
+	uint64_t Time;
+	uint64_t Size;
+	uintptr_t AgentId;
+	uint32_t SkillId;
+};
+
+std::map<std::pair<uintptr_t, uint32_t>, uint64_t> GetWindow(const RollingHealing& pRolling, uint64_t pEnd, uint64_t pWindow)
+{
+	std::map<std::pair<uintptr_t, uint32_t>, uint64_t> result;
+	pRolling.ForEachTotal(pEnd, pWindow, [&result](uintptr_t pAgentId, uint32_t pSkillId, const HealTotal& pTotal)
+		{
+			result[{pAgentId, pSkillId}] += pTotal.Healing;
+		});
+	return result;
+}
+} // anonymous namespace
+
+// Every window has to contain exactly the events inside it, including events that arrived late
+TEST(RollingHealingTest, WindowsMatchEvents)
+{
+	std::mt19937_64 rng{1};
+
+	RollingHealing rolling;
+	std::vector<Event> events;
+	uint64_t time = 100000;
+	for (size_t i = 0; i < 20000; i++)
+	{
+		time += rng() % 10;
+		uint64_t eventTime = (rng() % 10 == 0) ? time - rng() % 3000 : time;
+		Event& event = events.emplace_back(Event{eventTime, 1 + rng() % 5000, 1 + rng() % 10, static_cast<uint32_t>(rng() % 5)});
+		rolling.Add(event.Time, event.Size, event.AgentId, event.SkillId, false);
+	}
+
+	for (uint64_t window : RollingHealing::WINDOWS)
+	{
+		std::map<std::pair<uintptr_t, uint32_t>, uint64_t> expected;
+		for (const Event& event : events)
+		{
+			if (event.Time > time - window)
+			{
+				expected[{event.AgentId, event.SkillId}] += event.Size;
+			}
+		}
+
+		EXPECT_EQ(GetWindow(rolling, time, window), expected) << window;
+	}
+}
+
+// The buckets at the edges of a window are only partially inside it, only their events inside the window count. The
+// end of the window is the end of combat, so heals after it are left out
+TEST(RollingHealingTest, EdgeBucketsAreClipped)
+{
+	RollingHealing rolling;
+	rolling.Add(10100, 1, 1, 1, false);
+	rolling.Add(10400, 2, 1, 1, false);
+	rolling.Add(12000, 4, 2, 1, true);
+	rolling.Add(15200, 8, 1, 1, false);
+	rolling.Add(15250, 16, 1, 1, false);
+	rolling.Add(15300, 32, 1, 2, false); // After the end of the window, in the same bucket
+
+	EXPECT_EQ(GetWindow(rolling, 15250, 5000), (std::map<std::pair<uintptr_t, uint32_t>, uint64_t>{{{1, 1}, 2 + 8 + 16}, {{2, 1}, 4}}));
+
+	// Windows ending right before a bucket starts cover whole buckets
+	EXPECT_EQ(GetWindow(rolling, 14999, 5000), (std::map<std::pair<uintptr_t, uint32_t>, uint64_t>{{{1, 1}, 1 + 2}, {{2, 1}, 4}}));
+
+	// Barrier is passed through for events in edge buckets as well
+	HealTotal total;
+	rolling.ForEachTotal(12000, 1, [&total](uintptr_t, uint32_t, const HealTotal& pTotal)
+		{
+			total += pTotal;
+		});
+	EXPECT_EQ(total, (HealTotal{1, 4, 4}));
+}
+
+TEST(RollingHealingTest, OldEventsAreDropped)
+{
+	RollingHealing rolling;
+	rolling.Add(1000, 10, 1, 1, false);
+	EXPECT_EQ(GetWindow(rolling, 1000, 5000).size(), 1U);
+
+	// The bucket of the first event is reused for a later round of the ring, the event is gone
+	const uint64_t later = 1000 + RollingHealing::BUCKET_COUNT * RollingHealing::BUCKET_WIDTH;
+	rolling.Add(later, 20, 2, 1, false);
+	EXPECT_EQ(GetWindow(rolling, later, 30000), (std::map<std::pair<uintptr_t, uint32_t>, uint64_t>{{{2, 1}, 20}}));
+
+	// Too old for the ring
+	rolling.Add(1200, 30, 3, 1, false);
+	EXPECT_EQ(GetWindow(rolling, later, 30000).size(), 1U);
+
+	// Nothing in the window
+	EXPECT_EQ(GetWindow(rolling, later + 40000, 5000).size(), 0U);
+
+	rolling.clear();
+	EXPECT_EQ(GetWindow(rolling, later, 30000).size(), 0U);
+}
+
+TEST(RollingHealingTest, CopiesAreNotAffectedByAdds)
+{
+	RollingHealing rolling;
+	rolling.Add(1000, 10, 1, 1, false);
+
+	RollingHealing copy = rolling;
+	rolling.Add(1100, 20, 1, 1, false);
+	rolling.Add(1200, 30, 2, 1, true);
+
+	EXPECT_EQ(GetWindow(copy, 1200, 5000), (std::map<std::pair<uintptr_t, uint32_t>, uint64_t>{{{1, 1}, 10}}));
+	EXPECT_EQ(GetWindow(rolling, 1200, 5000), (std::map<std::pair<uintptr_t, uint32_t>, uint64_t>{{{1, 1}, 30}, {{2, 1}, 30}}));
+}
@@ -0,0 +1,72 @@
+#pragma once
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "AggregatedStats.h"
+#include "EventProcessor.h"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+
+// Fixtures shared by the tests that aggregate fights (AggregatedStatsTest, EncounterHistoryTest)
+
+// Builds a fight with pEventCount events. Event times are mostly increasing but some events arrive late, and the combat
+// end conditions all cut off some events at the end.
+inline HealingStats BuildFight(uint32_t pSeed, size_t pEventCount, bool pLateEvents = true)
+{
+	std::mt19937_64 rng{pSeed};
+
+	HealingStats result;
+	result.Skills = std::make_shared<SkillTable>();
+	result.Skills->RegisterDamagingSkill(7, "Damaging Skill"); // Healing from it is indirect healing
+
+	const size_t agentCount = 40;
+	std::shared_ptr<AgentSnapshot> agents = std::make_shared<AgentSnapshot>();
+	for (size_t i = 1; i <= agentCount; i++)
+	{
+		if (i % 9 == 0)
+		{
+			continue; // Unmapped agent
+		}
+
+		std::string name = "agent" + std::to_string(i);
+		agents->emplace(std::piecewise_construct,
+			std::forward_as_tuple(i * 1000),
+			std::forward_as_tuple(static_cast<uint16_t>(i), name.c_str(), static_cast<uint16_t>(i % 6), i % 4 == 0, i % 3 != 0));
+	}
+	result.Agents = agents;
+
+	uint64_t time = 100000;
+	result.EnteredCombatTime = time;
+	result.SubGroup = 2;
+	for (size_t i = 0; i < pEventCount; i++)
+	{
+		time += rng() % 5;
+		uint64_t eventTime = (pLateEvents == true && rng() % 10 == 0) ? time - rng() % 2000 : time;
+		uintptr_t agentId = (rng() % 50 == 0) ? 0 : (1 + rng() % agentCount) * 1000;
+		result.AddEvent(eventTime, 1 + rng() % 5000, agentId, static_cast<uint32_t>(rng() % 30), rng() % 5 == 0);
+	}
+
+	result.LastDamageEvent = time - 2500;
+	result.ExitedCombatTime = time - 1500;
+	result.CollectionTime = time;
+
+	return result;
+}
+
+inline void ExpectEqual(const AggregatedVector& pLeft, const AggregatedVector& pRight)
+{
+	ASSERT_EQ(pLeft.Entries.size(), pRight.Entries.size());
+	EXPECT_EQ(pLeft.HighestHealing, pRight.HighestHealing);
+	for (size_t i = 0; i < pLeft.Entries.size(); i++)
+	{
+		EXPECT_EQ(pLeft.Entries[i].GetTie(), pRight.Entries[i].GetTie()) << i;
+	}
+}
@@ -0,0 +1,111 @@
+#pragma warning(push, 0)
+#pragma warning(disable : 4005)
+#pragma warning(disable : 4389)
+#pragma warning(disable : 26439)
+#pragma warning(disable : 26495)
+#include <gtest/gtest.h>
+#pragma warning(pop)
+
+#include "ThreadPool.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(ThreadPoolTest, EveryIndexRunsOnce)
+{
+	ThreadPool pool{3};
+	EXPECT_EQ(pool.GetWorkerCount(), 3U);
+
+	for (size_t count : {0, 1, 2, 3, 4, 5, 17, 1000})
+	{
+		std::unique_ptr<std::atomic_uint32_t[]> calls = std::make_unique<std::atomic_uint32_t[]>(count);
+		pool.ParallelFor(count, [&calls](size_t pIndex)
+			{
+				calls[pIndex].fetch_add(1, std::memory_order_relaxed);
+			});
+
+		for (size_t i = 0; i < count; i++)
+		{
+			ASSERT_EQ(calls[i].load(), 1U) << "count " << count << " index " << i;
+		}
+	}
+}
+
+TEST(ThreadPoolTest, NoWorkers)
+{
+	ThreadPool pool{0};
+
+	std::vector<size_t> calls;
+	pool.ParallelFor(5, [&calls](size_t pIndex)
+		{
+			calls.emplace_back(pIndex);
+		});
+
+	EXPECT_EQ(calls, (std::vector<size_t>{0, 1, 2, 3, 4}));
+}
+
+// A participant that finishes its own share early steals from the others, so slow work at the front of a share doesn't
+// leave the rest of that share waiting behind it
+TEST(ThreadPoolTest, IdleParticipantsSteal)
+{
+	ThreadPool pool{1};
+
+	// Index 0 is the first index of the caller's share and index 10 the first of the worker's share. Whichever of them
+	// starts first is slow
+	std::array<std::thread::id, 20> threads;
+	std::atomic_int32_t slowIndex = -1;
+	pool.ParallelFor(threads.size(), [&](size_t pIndex)
+		{
+			threads[pIndex] = std::this_thread::get_id();
+
+			int32_t expected = -1;
+			if ((pIndex == 0 || pIndex == 10) && slowIndex.compare_exchange_strong(expected, static_cast<int32_t>(pIndex)) == true)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+		});
+
+	ASSERT_NE(slowIndex.load(), -1);
+	const size_t shareBegin = static_cast<size_t>(slowIndex.load());
+	size_t stolen = 0;
+	for (size_t i = shareBegin + 1; i < shareBegin + 10; i++)
+	{
+		if (threads[i] != threads[shareBegin])
+		{
+			stolen++;
+		}
+	}
+	EXPECT_GT(stolen, 0U);
+}
+
+TEST(ThreadPoolTest, ConcurrentCallers)
+{
+	ThreadPool pool{2};
+
+	std::atomic_uint64_t sum = 0;
+	std::vector<std::thread> callers;
+	for (size_t i = 0; i < 4; i++)
+	{
+		callers.emplace_back([&pool, &sum]()
+			{
+				for (size_t j = 0; j < 50; j++)
+				{
+					pool.ParallelFor(100, [&sum](size_t pIndex)
+						{
+							sum.fetch_add(pIndex, std::memory_order_relaxed);
+						});
+				}
+			});
+	}
+
+	for (std::thread& caller : callers)
+	{
+		caller.join();
+	}
+
+	EXPECT_EQ(sum.load(), 4U * 50U * (99U * 100U / 2));
+}
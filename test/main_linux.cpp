@@ -0,0 +1,21 @@
+// Entry point of the Linux test target in xmake.lua. Only the tests that don't depend on the game or Windows are part of
+// that target, main.cpp is the entry point of the full test project
+#include "Log.h"
+
+#include <gtest/gtest.h>
+
+int main(int pArgumentCount, char** pArgumentVector)
+{
+	Log_::Init(true, "logs/unit_tests_linux.txt");
+	Log_::SetLevel(spdlog::level::trace);
+	Log_::LockLogger();
+
+	::testing::InitGoogleTest(&pArgumentCount, pArgumentVector);
+
+	int result = RUN_ALL_TESTS();
+
+	Log_::LOGGER = nullptr;
+	spdlog::shutdown();
+
+	return result;
+}
@@ -253,3 +253,62 @@ target("evtc_rpc_server")
 	add_cxxflags("-Wno-format") -- unsigned long long vs unsigned long issues (linux is stupid...)
 	add_cxxflags("-Wno-gnu-zero-variadic-macro-arguments", "-Wno-format-pedantic")
 	add_ldflags("-fuse-ld=lld")
+
+-- Tests that build without the game and Windows (the full test project is test/test.vcxproj). Run with
+-- "xmake build unit_tests_linux && xmake run unit_tests_linux"
+target("unit_tests_linux")
+	set_kind("binary")
+	set_warnings("all")
+	set_languages("c++20")
+	set_toolset("cxx", "clang++")
+	set_toolset("ld", "clang++")
+
+	if is_mode("debug") then
+		add_options("debug")
+		add_defines("_DEBUG")
+
+	elseif is_mode("asan") then
+		set_optimize("none")
+		add_defines("_DEBUG")
+		add_cxxflags("-fsanitize=address")
+		add_ldflags("-fsanitize=address")
+
+	elseif is_mode("release") then
+		set_optimize("fastest")
+		add_defines("NDEBUG")
+
+	end
+
+	add_defines("LINUX")
+
+	add_syslinks("pthread")
+
+	add_includedirs("modules/arcdps_extension", "src", "vcpkg_installed/x64-linux/x64-linux/include")
+	add_linkdirs("vcpkg_installed/x64-linux/x64-linux/lib")
+	add_links("gtest", "spdlog", "fmt")
+
+	add_files(
+		"src/AgentTable.cpp",
+		"src/CombatEventQueue.cpp",
+		"src/EncounterJournal.cpp",
+		"src/EventSequencer.cpp",
+		"src/HealEventLog.cpp",
+		"src/HealEventTotals.cpp",
+		"src/Log.cpp",
+		"src/MappedFile.cpp",
+		"src/PlayerStats.cpp",
+		"src/RollingHealing.cpp")
+	add_files(
+		"test/CombatEventQueueTest.cpp",
+		"test/EncounterJournalTest.cpp",
+		"test/EventSequencerTest.cpp",
+		"test/HealEventLogTest.cpp",
+		"test/RollingHealingTest.cpp",
+		"test/main_linux.cpp")
+
+	add_cxxflags("-ggdb3")
+	add_cxxflags("-Wextra", "-pedantic")
+	add_cxxflags("-Wno-format") -- unsigned long long vs unsigned long issues
+	add_cxxflags("-Wno-gnu-zero-variadic-macro-arguments", "-Wno-format-pedantic")
+	add_cxxflags("-Wno-unknown-pragmas") -- msvc warning pragmas
+	add_ldflags("-fuse-ld=lld")